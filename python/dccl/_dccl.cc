@@ -238,6 +238,34 @@ static PyObject *Codec_decode(Codec *self, PyObject *args) {
     return pyMsg;
 }
 
+static PyObject *Codec_decode_front(Codec *self, PyObject *args) {
+    const char *bytes;
+    Py_ssize_t size = 0;
+    int header_only = 0;
+
+    // Parse inputs and convert to string
+    if (!PyArg_ParseTuple(args, "s#|i", &bytes, &size, &header_only))
+        return NULL;
+    std::string bytestr(bytes, size);
+
+    // Do DCCL Decoding of the first message, and get a gp::Message and the bytes it used
+    gp::Message *msg;
+    std::size_t bytes_used = 0;
+    try {
+        msg = self->codec->decode_front<gp::Message*>(bytestr, &bytes_used, header_only != 0);
+    } catch (dccl::Exception &e) {
+        PyErr_SetString(DcclException, e.what());
+        return NULL;
+    }
+
+    // Convert the gp::Message to a Python Protobuf Message
+    PyObject* pyMsg = cpp_pbmsg_to_py_pbmsg(msg);
+    delete msg;
+    if (!pyMsg)
+        return NULL;
+    return Py_BuildValue("(Nn)", pyMsg, static_cast<Py_ssize_t>(bytes_used));
+}
+
 static PyObject *Codec_load(Codec *self, PyObject *args) {
     // Get the type name as a string
     const char *type_name_ch = NULL;
@@ -356,6 +384,8 @@ static PyMethodDef Codec_methods[] = {
      "encode(message[, header_only])\n\nReturn a DCCL-encoded string for message."},
     {"decode", (PyCFunction)Codec_decode, METH_VARARGS,
      "decode(bytes[, header_only])\n\nReturn a protobuf message decoded from bytes."},
+    {"decode_front", (PyCFunction)Codec_decode_front, METH_VARARGS,
+     "decode_front(bytes[, header_only])\n\nReturn a tuple of the protobuf message decoded from the front of bytes and the number of bytes it used."},
     {"load", (PyCFunction)Codec_load, METH_VARARGS,
      "load(type_name)\n\nEnsure that type_name is registered for use with DCCL."},
     {"load_library", (PyCFunction)Codec_load_library, METH_VARARGS,
@@ -65,6 +65,15 @@ extern "C"
         FieldCodecManager::add<ArithmeticFieldCodec<bool> >("dccl.arithmetic");
         FieldCodecManager::add<ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*> >("dccl.arithmetic");
 
+        FieldCodecManager::add<ArithmeticFieldCodec<int32, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<int64, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<uint32, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<uint64, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<double, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<float, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<bool, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::add<ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+
     }
     void dccl3_unload(dccl::Codec* dccl)
     {
@@ -93,6 +102,15 @@ extern "C"
         FieldCodecManager::remove<ArithmeticFieldCodec<float> >("dccl.arithmetic");
         FieldCodecManager::remove<ArithmeticFieldCodec<bool> >("dccl.arithmetic");
         FieldCodecManager::remove<ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*> >("dccl.arithmetic");
+
+        FieldCodecManager::remove<ArithmeticFieldCodec<int32, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<int64, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<uint32, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<uint64, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<double, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<float, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<bool, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
+        FieldCodecManager::remove<ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*, ArithmeticRangeFieldCodecBase> >("dccl.arithmetic.range");
         
     }
 }
@@ -144,33 +162,18 @@ dccl::arith::Model::value_type dccl::arith::Model::symbol_to_value(symbol_type s
 
 std::pair<dccl::arith::Model::freq_type, dccl::arith::Model::freq_type> dccl::arith::Model::symbol_to_cumulative_freq(symbol_type symbol, ModelState state) const
 {
-    const boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
-        encoder_cumulative_freqs_ :
-        decoder_cumulative_freqs_;
+    const CumulativeFrequencies& c_freqs = cumulative_freqs(state);
 
-    boost::bimap<symbol_type, freq_type>::left_map::const_iterator c_freq_it =
-        c_freqs.left.find(symbol);
     std::pair<freq_type, freq_type> c_freq_range;
-    c_freq_range.second = c_freq_it->second;
-    if(c_freq_it == c_freqs.left.begin())
-    {
-        c_freq_range.first  = 0;
-    }
-    else
-    {
-        c_freq_it--;
-        c_freq_range.first = c_freq_it->second;
-    }
+    c_freq_range.first = (symbol == MIN_SYMBOL) ? 0 : c_freqs.cumulative(symbol - 1);
+    c_freq_range.second = c_freq_range.first + c_freqs.frequency(symbol);
     return c_freq_range;
                           
 }
 
 std::pair<dccl::arith::Model::symbol_type, dccl::arith::Model::symbol_type> dccl::arith::Model::cumulative_freq_to_symbol(std::pair<freq_type, freq_type> c_freq_pair,  ModelState state) const
 {
-
-    const boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
-        encoder_cumulative_freqs_ :
-        decoder_cumulative_freqs_;
+    const CumulativeFrequencies& c_freqs = cumulative_freqs(state);
     
     std::pair<symbol_type, symbol_type> symbol_pair;
     
@@ -181,17 +184,15 @@ std::pair<dccl::arith::Model::symbol_type, dccl::arith::Model::symbol_type> dccl
     // symbol: 2   freq: 10   c_freq: 35 [25 ... 35)
     // searching for c_freq of 30 should return symbol 2     
     // searching for c_freq of 10 should return symbol 1
-    symbol_pair.first = c_freqs.right.upper_bound(c_freq_pair.first)->second;
-    
+    // (a zero frequency symbol is never returned as it shares its cumulative frequency with the symbol before it)
+    symbol_pair.first = c_freqs.upper_bound(c_freq_pair.first);
     
-    if(symbol_pair.first == c_freqs.left.rbegin()->first)
+    if(symbol_pair.first == max_symbol())
         symbol_pair.second = symbol_pair.first; // last symbol can't be ambiguous on the low end
-    else if(c_freqs.left.find(symbol_pair.first)->second > c_freq_pair.second)
+    else if(c_freqs.cumulative(symbol_pair.first) > c_freq_pair.second)
         symbol_pair.second = symbol_pair.first; // unambiguously this symbol
     else
         symbol_pair.second = symbol_pair.first + 1;
-
-
     
     return symbol_pair;
 }
@@ -202,7 +203,7 @@ void dccl::arith::Model::update_model(symbol_type symbol, ModelState state)
     if(!user_model_.is_adaptive())
         return;
 
-    boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
+    CumulativeFrequencies& c_freqs = (state == ENCODER) ?
         encoder_cumulative_freqs_ :
         decoder_cumulative_freqs_;
 
@@ -211,34 +212,77 @@ void dccl::arith::Model::update_model(symbol_type symbol, ModelState state)
         dlog << "Model was: " << std::endl;
         for(symbol_type i = MIN_SYMBOL, n = max_symbol(); i <= n; ++i)
         {
-            boost::bimap<symbol_type, freq_type>::left_iterator it =
-                c_freqs.left.find(i);
-            if(it != c_freqs.left.end())
-                dlog << "Symbol: " << it->first << ", c_freq: " << it->second << std::endl;
+            if(i == MIN_SYMBOL || c_freqs.frequency(i) != 0)
+                dlog << "Symbol: " << i << ", c_freq: " << c_freqs.cumulative(i) << std::endl;
         }
     }
     
-                
-    for(symbol_type i = max_symbol(), n = symbol; i >= n; --i)
-    {
-        boost::bimap<symbol_type, freq_type>::left_iterator it =
-            c_freqs.left.find(i);
-        if(it != c_freqs.left.end())
-            c_freqs.left.replace_data(it, it->second + 1);
-    }
+    c_freqs.increment(symbol);
 
     if(dlog.is(DEBUG3))
     {
         dlog << "Model is now: " << std::endl;
         for(symbol_type i = MIN_SYMBOL, n = max_symbol(); i <= n; ++i)
         {
-            boost::bimap<symbol_type, freq_type>::left_iterator it =
-                c_freqs.left.find(i);
-            if(it != c_freqs.left.end())
-                dlog << "Symbol: " << it->first << ", c_freq: " << it->second << std::endl;
+            if(i == MIN_SYMBOL || c_freqs.frequency(i) != 0)
+                dlog << "Symbol: " << i << ", c_freq: " << c_freqs.cumulative(i) << std::endl;
         }
     }
     
     dlog.is(DEBUG3) && dlog << "total freq: " << total_freq(state) << std::endl;
                 
 }
+
+void dccl::arith::Model::CumulativeFrequencies::assign(const std::vector<freq_type>& freqs)
+{
+    freqs_ = freqs;
+    total_ = 0;
+    tree_.assign(freqs_.size() + 1, 0);
+    
+    // O(n) construction: each node pushes its partial sum up to its parent
+    for(std::vector<freq_type>::size_type i = 1, n = tree_.size(); i < n; ++i)
+    {
+        tree_[i] += freqs_[i - 1];
+        total_ += freqs_[i - 1];
+        std::vector<freq_type>::size_type parent = i + (i & -i);
+        if(parent < n)
+            tree_[parent] += tree_[i];
+    }
+}
+
+dccl::arith::Model::freq_type dccl::arith::Model::CumulativeFrequencies::cumulative(symbol_type symbol) const
+{
+    freq_type sum = 0;
+    for(symbol_type i = symbol - MIN_SYMBOL + 1; i > 0; i -= (i & -i))
+        sum += tree_[i];
+    return sum;
+}
+
+dccl::arith::Model::symbol_type dccl::arith::Model::CumulativeFrequencies::upper_bound(freq_type c_freq) const
+{
+    // binary descent through the tree for the last position with cumulative frequency <= c_freq
+    symbol_type n = freqs_.size();
+    symbol_type step = 1;
+    while(step * 2 <= n)
+        step *= 2;
+
+    symbol_type pos = 0;
+    for(; step > 0; step /= 2)
+    {
+        if(pos + step <= n && tree_[pos + step] <= c_freq)
+        {
+            pos += step;
+            c_freq -= tree_[pos];
+        }
+    }
+    // pos is a count of symbols, so is also the (zero based) index of the next one
+    return pos + MIN_SYMBOL;
+}
+
+void dccl::arith::Model::CumulativeFrequencies::increment(symbol_type symbol)
+{
+    ++freqs_[symbol - MIN_SYMBOL];
+    ++total_;
+    for(symbol_type i = symbol - MIN_SYMBOL + 1, n = freqs_.size(); i <= n; i += (i & -i))
+        ++tree_[i];
+}
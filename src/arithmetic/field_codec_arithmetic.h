@@ -27,8 +27,8 @@
 
 #include <limits>
 #include <algorithm>
+#include <vector>
 
-#include <boost/bimap.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include "dccl/field_codec_typed.h"
@@ -39,6 +39,7 @@
 #include "dccl/logger.h"
 
 #include "dccl/binary.h"
+#include "dccl/bit_cursor.h"
 
 extern "C"
 {
@@ -84,8 +85,8 @@ namespace dccl
             
             symbol_type value_to_symbol(value_type value) const;
             value_type symbol_to_value(symbol_type symbol) const;
-            symbol_type total_symbols() // EOF and OUT_OF_RANGE plus all user defined
-            { return encoder_cumulative_freqs_.size();  }
+            symbol_type total_symbols() // EOF and OUT_OF_RANGE (if nonzero frequency) plus all user defined
+            { return encoder_cumulative_freqs_.size() - (encoder_cumulative_freqs_.frequency(OUT_OF_RANGE_SYMBOL) == 0 ? 1 : 0); }
 
             const protobuf::ArithmeticModel& user_model() const 
             { return user_model_; }
@@ -94,12 +95,7 @@ namespace dccl
             
             freq_type total_freq(ModelState state) const
             {
-                
-                const boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
-                    encoder_cumulative_freqs_ :
-                    decoder_cumulative_freqs_;
-
-                return c_freqs.left.at(max_symbol());
+                return cumulative_freqs(state).total();
             }
 
             void update_model(symbol_type symbol, ModelState state);
@@ -110,9 +106,36 @@ namespace dccl
 
             friend class ModelManager;
           private:
+            /// \brief Frequency table over the symbols [MIN_SYMBOL, max_symbol()], stored as a Fenwick (binary indexed) tree
+            ///
+            /// Lookups of cumulative frequency (and the inverse) and adaptive updates are all O(log n) with no per-node allocation.
+            class CumulativeFrequencies
+            {
+              public:
+                void assign(const std::vector<freq_type>& freqs);
+
+                symbol_type size() const { return freqs_.size(); }
+                freq_type total() const { return total_; }
+                freq_type frequency(symbol_type symbol) const { return freqs_[symbol - MIN_SYMBOL]; }
+
+                /// sum of the frequencies of all symbols in [MIN_SYMBOL, symbol]
+                freq_type cumulative(symbol_type symbol) const;
+                /// lowest symbol whose cumulative frequency is greater than c_freq
+                symbol_type upper_bound(freq_type c_freq) const;
+                void increment(symbol_type symbol);
+                
+              private:
+                std::vector<freq_type> freqs_;
+                std::vector<freq_type> tree_; // 1-based
+                freq_type total_;
+            };
+
+            const CumulativeFrequencies& cumulative_freqs(ModelState state) const
+            { return (state == ENCODER) ? encoder_cumulative_freqs_ : decoder_cumulative_freqs_; }
+            
             protobuf::ArithmeticModel user_model_;
-            boost::bimap<symbol_type, freq_type> encoder_cumulative_freqs_;
-            boost::bimap<symbol_type, freq_type> decoder_cumulative_freqs_;
+            CumulativeFrequencies encoder_cumulative_freqs_;
+            CumulativeFrequencies decoder_cumulative_freqs_;
         };
 
         class ModelManager
@@ -136,7 +159,7 @@ namespace dccl
                                     "Missing fields: " + model->user_model_.InitializationErrorString()));
                 }
 
-                Model::freq_type cumulative_freq = 0;
+                std::vector<Model::freq_type> freqs;
                 for(Model::symbol_type symbol = Model::MIN_SYMBOL, n = model->user_model_.frequency_size(); symbol < n; ++symbol)
                 {
                     Model::freq_type freq;
@@ -153,10 +176,9 @@ namespace dccl
                                         model->user_model_.DebugString() +
                                         "All frequencies must be nonzero."));
                     }                      
-                    cumulative_freq += freq;
-                    model->encoder_cumulative_freqs_.left.insert(std::make_pair(symbol, cumulative_freq));
-                    
+                    freqs.push_back(freq);
                 }
+                model->encoder_cumulative_freqs_.assign(freqs);
 
                 // must have separate models for adaptive encoding.
                 model->decoder_cumulative_freqs_ = model->encoder_cumulative_freqs_;
@@ -235,40 +257,7 @@ namespace dccl
                   
                   for(unsigned value_index = 0, n = max_repeat(); value_index < n; ++value_index)
                   {
-                      Model::symbol_type symbol = Model::EOF_SYMBOL;
-
-                      if(wire_value.size() > value_index)
-                      {
-                          Model::value_type value = wire_value[value_index];
-                          dlog.is(DEBUG3) &&
-                              dlog << "(ArithmeticFieldCodec) value is : " << value << std::endl;
-                          
-                          symbol = model.value_to_symbol(value);
-                      }
-
-                      // if out-of-range is given no frequency, end encoding
-                      if(symbol == Model::OUT_OF_RANGE_SYMBOL &&
-                         model.user_model().out_of_range_frequency() == 0)
-                      {
-                          
-                          dlog.is(DEBUG2) &&
-                              dlog << "(ArithmeticFieldCodec) out of range symbol, but no frequency given; ending encoding" << std::endl;
-                      
-                          symbol = Model::EOF_SYMBOL;                      
-                      }
-
-                      // if EOF_SYMBOL is given no frequency, use most probable symbol and give a warning
-                      if(symbol == Model::EOF_SYMBOL &&
-                         model.user_model().eof_frequency() == 0)
-                      {
-                          dlog.is(DEBUG2) &&
-                              dlog << "(ArithmeticFieldCodec) end of file, but no frequency given; filling with most probable symbol" << std::endl;
-                          symbol = *std::max_element(model.user_model().frequency().begin(), model.user_model().frequency().end());
-                      }
-
-                      
-                      dlog.is(DEBUG3) &&
-                          dlog << "(ArithmeticFieldCodec) symbol is : " << symbol << std::endl;
+                      Model::symbol_type symbol = wire_value_to_symbol(model, wire_value, value_index);
 
                       dlog.is(DEBUG3) &&
                           dlog << "(ArithmeticFieldCodec) current interval: [" << (double)low / TOP_VALUE  << ","
@@ -382,6 +371,52 @@ namespace dccl
               }
 
               
+              /// \brief Returns the symbol to encode at `value_index` (EOF past the end of `wire_value`), substituting for symbols the model gives no frequency
+              Model::symbol_type wire_value_to_symbol(const Model& model,
+                                                      const std::vector<Model::value_type>& wire_value,
+                                                      unsigned value_index)
+              {
+                  using dccl::dlog;
+                  using namespace dccl::logger;
+
+                  Model::symbol_type symbol = Model::EOF_SYMBOL;
+
+                  if(wire_value.size() > value_index)
+                  {
+                      Model::value_type value = wire_value[value_index];
+                      dlog.is(DEBUG3) &&
+                          dlog << "(ArithmeticFieldCodec) value is : " << value << std::endl;
+                      
+                      symbol = model.value_to_symbol(value);
+                  }
+
+                  // if out-of-range is given no frequency, end encoding
+                  if(symbol == Model::OUT_OF_RANGE_SYMBOL &&
+                     model.user_model().out_of_range_frequency() == 0)
+                  {
+                      
+                      dlog.is(DEBUG2) &&
+                          dlog << "(ArithmeticFieldCodec) out of range symbol, but no frequency given; ending encoding" << std::endl;
+                  
+                      symbol = Model::EOF_SYMBOL;                      
+                  }
+
+                  // if EOF_SYMBOL is given no frequency, use most probable symbol and give a warning
+                  if(symbol == Model::EOF_SYMBOL &&
+                     model.user_model().eof_frequency() == 0)
+                  {
+                      dlog.is(DEBUG2) &&
+                          dlog << "(ArithmeticFieldCodec) end of file, but no frequency given; filling with most probable symbol" << std::endl;
+                      symbol = *std::max_element(model.user_model().frequency().begin(), model.user_model().frequency().end());
+                  }
+
+                  
+                  dlog.is(DEBUG3) &&
+                      dlog << "(ArithmeticFieldCodec) symbol is : " << symbol << std::endl;
+
+                  return symbol;
+              }
+              
               void bit_plus_follow(Bitset* bits, int* bits_to_follow, bool bit)
               {
                   bits->push_back(bit);
@@ -503,6 +538,9 @@ namespace dccl
                   return encode_repeated(wire_values, false).size();
               }
             
+              // the sizes depend on the model (which may be replaced by ModelManager::set_model or adapt as symbols are coded)
+              bool schema_only_size()
+              { return false; }
 
               // this maximum size will be upper bounded by: ceil(log_2(1/P)) + 1 where P is the
               // probability of this least probable set of symbols
@@ -661,8 +699,239 @@ namespace dccl
         template<typename FieldType> const uint64 ArithmeticFieldCodecBase<FieldType>::HALF;
         template<typename FieldType> const uint64 ArithmeticFieldCodecBase<FieldType>::THIRD_QTR;
         
-        template<typename FieldType>   
-            class ArithmeticFieldCodec : public ArithmeticFieldCodecBase<FieldType>
+        /// \brief Byte oriented range coder variant of ArithmeticFieldCodecBase ("dccl.arithmetic.range").
+        ///
+        /// Uses the same models (ModelManager) as "dccl.arithmetic" but renormalizes a byte at a time using a 64-bit low / range pair (with carry propagation), so that the bit I/O is done in whole words rather than bit by bit. The encoding is a length prefix (number of bytes, sized by max_size_repeated()) followed by the range coded bytes (trailing zero bytes are implied). This is not wire compatible with "dccl.arithmetic", and is typically a few bits larger than it.
+        template<typename FieldType = Model::value_type>   
+            class ArithmeticRangeFieldCodecBase : public ArithmeticFieldCodecBase<FieldType>
+            {   
+              public:
+              typedef ArithmeticFieldCodecBase<FieldType> Base;
+              
+              static const uint64 RANGE_BOTTOM = static_cast<uint64>(1) << 56; // renormalize when range falls below this
+              static const int RANGE_SHIFT = 56; // shift from `low` to its most significant byte
+              
+              Bitset encode_repeated(const std::vector<Model::value_type>& wire_value)
+              {
+                  return encode_repeated(wire_value, true);
+              }
+              
+              Bitset encode_repeated(const std::vector<Model::value_type>& wire_value,
+                                     bool update_model)
+              {
+                  using dccl::dlog;
+                  using namespace dccl::logger;
+                  
+                  Model& model = Base::current_model();
+
+                  // sized before coding as adaptive models change as symbols are coded
+                  const unsigned length_bits = length_prefix_size(model);
+                  
+                  uint64 low = 0;
+                  uint64 range = std::numeric_limits<uint64>::max();
+                  std::vector<unsigned char> bytes;
+
+                  for(unsigned value_index = 0, n = Base::max_repeat(); value_index < n; ++value_index)
+                  {
+                      Model::symbol_type symbol = Base::wire_value_to_symbol(model, wire_value, value_index);
+
+                      std::pair<Model::freq_type, Model::freq_type> c_freq_range =
+                          model.symbol_to_cumulative_freq(symbol, Model::ENCODER);
+                      
+                      uint64 r = range / model.total_freq(Model::ENCODER);
+                      uint64 new_low = low + r*c_freq_range.first;
+                      if(new_low < low)
+                          propagate_carry(&bytes);
+                      low = new_low;
+                      range = r*(c_freq_range.second - c_freq_range.first);
+
+                      if(update_model)
+                          model.update_model(symbol, Model::ENCODER);
+
+                      while(range < RANGE_BOTTOM)
+                      {
+                          bytes.push_back(static_cast<unsigned char>(low >> RANGE_SHIFT));
+                          low <<= 8;
+                          range <<= 8;
+                      }
+
+                      // nothing more to do, we're encoding all the data and an EOF
+                      if(value_index == wire_value.size())
+                          break;
+                  }
+
+                  // the decoder pads with zeros, so output the shortest value in [low, low + range): `low`
+                  // rounded up to the next multiple of RANGE_BOTTOM (< low + range, since range >= RANGE_BOTTOM)
+                  if(low != 0)
+                  {
+                      uint64 final_low = low + (RANGE_BOTTOM - 1);
+                      if(final_low < low)
+                          propagate_carry(&bytes);
+                      final_low >>= RANGE_SHIFT;
+                      if(final_low != 0)
+                          bytes.push_back(static_cast<unsigned char>(final_low));
+                  }
+                  
+                  while(!bytes.empty() && bytes.back() == 0)
+                      bytes.pop_back();
+
+                  if(bytes.size() >= (static_cast<uint64>(1) << length_bits))
+                      throw(Exception("(ArithmeticRangeFieldCodec) encoded size exceeds maximum (" + boost::lexical_cast<std::string>(bytes.size()) + " bytes)"));
+                  
+                  Bitset bits;
+                  BitWriter writer(&bits);
+                  writer.write(bytes.size(), length_bits);
+                  for(std::vector<unsigned char>::size_type i = 0, n = bytes.size(); i < n; i += sizeof(uint64))
+                  {
+                      const unsigned k = std::min<std::vector<unsigned char>::size_type>(n - i, sizeof(uint64));
+                      uint64 word = 0;
+                      for(unsigned j = 0; j < k; ++j)
+                          word |= static_cast<uint64>(bytes[i + j]) << (j*8);
+                      writer.write(word, k*8);
+                  }
+                  
+                  dlog.is(DEBUG3) && dlog << "(ArithmeticRangeFieldCodec) encoded " << bytes.size() << " bytes" << std::endl;
+
+                  if(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).debug_assert())
+                      Model::last_bits_map[FieldCodecBase::this_descriptor()->full_name()][FieldCodecBase::this_field()->name()] = bits;
+                  
+                  return bits;
+              }
+
+              std::vector<Model::value_type> decode_repeated(Bitset* bits)
+              {
+                  using dccl::dlog;
+                  using namespace dccl::logger;
+                  
+                  std::vector<Model::value_type> values;
+
+                  Model& model = Base::current_model();
+                  
+                  const unsigned length_bits = length_prefix_size(model);
+                  if(bits->size() < length_bits)
+                      bits->get_more_bits(length_bits - bits->size());
+                  
+                  const unsigned num_bytes = bits->to<uint64>();
+                  bits->get_more_bits(num_bytes*8);
+
+                  const std::string byte_string = bits->to_byte_string();
+                  BitReader reader(byte_string.data(), byte_string.data() + byte_string.size(), bits->size());
+                  reader.skip(length_bits);
+
+                  // value of the code less `low`
+                  uint64 code = 0;
+                  for(int i = 0; i < static_cast<int>(sizeof(uint64)); ++i)
+                      code = (code << 8) | next_byte(&reader);
+                  uint64 range = std::numeric_limits<uint64>::max();
+                  
+                  for(unsigned value_index = 0, n = Base::max_repeat(); value_index < n; ++value_index)
+                  {
+                      Model::freq_type total = model.total_freq(Model::DECODER);
+                      uint64 r = range / total;
+                      // only exceeded by a corrupt message
+                      Model::freq_type cumulative_freq = std::min<uint64>(code / r, total - 1);
+
+                      Model::symbol_type symbol = model.cumulative_freq_to_symbol(std::make_pair(cumulative_freq, cumulative_freq), Model::DECODER).first;
+                      
+                      dlog.is(DEBUG3) && dlog << "(ArithmeticRangeFieldCodec) symbol is: " << symbol << std::endl;
+
+                      std::pair<Model::freq_type, Model::freq_type> c_freq_range =
+                          model.symbol_to_cumulative_freq(symbol, Model::DECODER);
+
+                      code -= r*c_freq_range.first;
+                      range = r*(c_freq_range.second - c_freq_range.first);
+
+                      model.update_model(symbol, Model::DECODER);
+                      
+                      if(symbol == Model::EOF_SYMBOL)
+                          break;
+
+                      values.push_back(model.symbol_to_value(symbol));
+
+                      while(range < RANGE_BOTTOM)
+                      {
+                          code = (code << 8) | next_byte(&reader);
+                          range <<= 8;
+                      }
+                  }
+
+                  if(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).debug_assert())
+                  {
+                      Bitset in = Model::last_bits_map[FieldCodecBase::this_descriptor()->full_name()][FieldCodecBase::this_field()->name()];
+                      assert(in == *bits);
+                  }
+                  
+                  return values;
+              }
+
+              unsigned size_repeated(const std::vector<Model::value_type>& wire_values)
+              {
+                  return encode_repeated(wire_values, false).size();
+              }
+
+              unsigned max_size_repeated()
+              {
+                  Model& model = Base::current_model();
+                  return length_prefix_size(model) + max_bytes(model)*8;
+              }
+              
+              unsigned min_size_repeated()
+              {
+                  Model& model = Base::current_model();
+                  
+                  if(model.user_model().is_adaptive())
+                      return 0; // length prefix size changes as the model adapts
+                  
+                  return length_prefix_size(model);
+              }
+              
+              private:
+              void propagate_carry(std::vector<unsigned char>* bytes)
+              {
+                  for(std::vector<unsigned char>::reverse_iterator it = bytes->rbegin(), end = bytes->rend(); it != end; ++it)
+                  {
+                      if(++(*it) != 0)
+                          break;
+                  }
+              }
+
+              unsigned char next_byte(BitReader* reader)
+              {
+                  return reader->remaining() ? static_cast<unsigned char>(reader->read(8)) : 0;
+              }
+              
+              // upper bound on the number of range coded bytes for the current state of `model`
+              unsigned max_bytes(const Model& model)
+              {
+                  using dccl::log2;
+
+                  Model::freq_type lowest_frequency = *std::min_element(model.user_model().frequency().begin(), model.user_model().frequency().end());
+                  if(model.user_model().out_of_range_frequency() != 0)
+                      lowest_frequency = std::min(lowest_frequency, model.user_model().out_of_range_frequency());
+                  if(model.user_model().eof_frequency() != 0)
+                      lowest_frequency = std::min(lowest_frequency, model.user_model().eof_frequency());
+
+                  // allow for the total growing as an adaptive model updates during this encoding
+                  double total = model.total_freq(Model::ENCODER);
+                  if(model.user_model().is_adaptive())
+                      total += Base::max_repeat() + 1;
+                  
+                  // every symbol (and EOF) is the least probable, plus the final byte and rounding
+                  double max_information = (Base::max_repeat() + 1)*(log2(total) - log2(lowest_frequency));
+                  return static_cast<unsigned>(std::ceil(max_information / 8)) + 2;
+              }
+
+              unsigned length_prefix_size(const Model& model)
+              {
+                  return dccl::ceil_log2(max_bytes(model) + 1);
+              }
+            };
+
+        template<typename FieldType> const uint64 ArithmeticRangeFieldCodecBase<FieldType>::RANGE_BOTTOM; 
+        template<typename FieldType> const int ArithmeticRangeFieldCodecBase<FieldType>::RANGE_SHIFT;
+        
+        template<typename FieldType, template<typename> class CodecBase = ArithmeticFieldCodecBase>
+            class ArithmeticFieldCodec : public CodecBase<FieldType>
         {
             Model::value_type pre_encode(const FieldType& field_value)
             { return static_cast<Model::value_type>(field_value); }
@@ -672,8 +941,8 @@ namespace dccl
         };
 
         
-        template <>
-            class ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*> : public ArithmeticFieldCodecBase<const google::protobuf::EnumValueDescriptor*>
+        template <template<typename> class CodecBase>
+            class ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*, CodecBase> : public CodecBase<const google::protobuf::EnumValueDescriptor*>
         {
           public:
             Model::value_type pre_encode(const google::protobuf::EnumValueDescriptor* const& field_value)
@@ -681,7 +950,7 @@ namespace dccl
             
             const google::protobuf::EnumValueDescriptor* post_decode(const Model::value_type& wire_value)
             {
-                const google::protobuf::EnumDescriptor* e = FieldCodecBase::this_field()->enum_type();
+                const google::protobuf::EnumDescriptor* e = this->this_field()->enum_type();
                 const google::protobuf::EnumValueDescriptor* return_value = e->FindValueByNumber((int)wire_value);
                 
                 if(return_value)
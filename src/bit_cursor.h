@@ -0,0 +1,280 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLBITCURSOR20261017H
+#define DCCLBITCURSOR20261017H
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "bitset.h"
+#include "common.h"
+#include "exception.h"
+
+namespace dccl
+{
+/// \brief Sequential (cursor based) reader of bits from a contiguous byte buffer.
+///
+/// Bits are read starting with the least significant bit of the first byte, which is the same ordering used by Bitset::from_byte_string(). The buffer is not copied and must outlive the reader.
+class BitReader
+{
+  public:
+    typedef Bitset::size_type size_type;
+
+    /// \brief Construct a reader over the bytes [begin, end)
+    BitReader(const char* begin, const char* end)
+        : data_(reinterpret_cast<const unsigned char*>(begin)),
+          size_((end - begin) * BITS_IN_BYTE),
+          pos_(0)
+    {
+    }
+
+    /// \brief Construct a reader over the bytes [begin, end), only exposing the first `num_bits` bits
+    BitReader(const char* begin, const char* end, size_type num_bits)
+        : data_(reinterpret_cast<const unsigned char*>(begin)),
+          size_(std::min<size_type>(num_bits, (end - begin) * BITS_IN_BYTE)),
+          pos_(0)
+    {
+    }
+
+    /// \brief Total number of bits in the underlying buffer
+    size_type size() const { return size_; }
+    /// \brief Current position (in bits from the start of the buffer)
+    size_type position() const { return pos_; }
+    /// \brief Number of bits that have not yet been read
+    size_type remaining() const { return size_ - pos_; }
+
+    /// \brief Move the cursor to an absolute bit position
+    void seek(size_type pos)
+    {
+        require(pos, 0);
+        pos_ = pos;
+    }
+
+    /// \brief Advance the cursor without reading
+    void skip(size_type num_bits)
+    {
+        require(pos_, num_bits);
+        pos_ += num_bits;
+    }
+
+    /// \brief Returns the next `num_bits` (<= 64) bits without advancing the cursor. The first bit read becomes the least significant bit of the result.
+    uint64 peek(unsigned num_bits) const
+    {
+        require(pos_, num_bits);
+        return bits_at(pos_, num_bits);
+    }
+
+    /// \brief Reads `num_bits` (<= 64) bits and advances the cursor. The first bit read becomes the least significant bit of the result.
+    uint64 read(unsigned num_bits)
+    {
+        uint64 value = peek(num_bits);
+        pos_ += num_bits;
+        return value;
+    }
+
+    /// \brief Reads `count` values of `num_bits` (<= 64) bits each and advances the cursor. This is equivalent to calling read(num_bits) `count` times but, where possible, each value is taken from a single 64 bit load.
+    void read_packed(uint64* values, size_type count, unsigned num_bits)
+    {
+        require(pos_, count * num_bits);
+        if (!num_bits)
+        {
+            std::fill(values, values + count, 0);
+            return;
+        }
+
+        const size_type num_bytes = (size_ + BITS_IN_BYTE - 1) / BITS_IN_BYTE;
+        const uint64 mask = num_bits < 64 ? ((static_cast<uint64>(1) << num_bits) - 1) : ~uint64(0);
+        for (size_type i = 0; i < count; ++i, pos_ += num_bits)
+        {
+            const size_type byte = pos_ / BITS_IN_BYTE;
+            const unsigned shift = pos_ % BITS_IN_BYTE;
+            if (shift + num_bits <= 64 && byte + 8 <= num_bytes)
+                values[i] = (load_le64(data_ + byte) >> shift) & mask;
+            else
+                values[i] = bits_at(pos_, num_bits);
+        }
+    }
+
+    /// \brief Replaces the contents of `bits` with the next `num_bits` bits without advancing the cursor
+    void peek(Bitset* bits, size_type num_bits) const
+    {
+        require(pos_, num_bits);
+        bits->clear();
+        for (size_type i = 0; i < num_bits; i += Bitset::WORD_BITS)
+        {
+            const unsigned n = std::min<size_type>(num_bits - i, Bitset::WORD_BITS);
+            bits->append_bits(bits_at(pos_ + i, n), n);
+        }
+    }
+
+    /// \brief Replaces the contents of `bits` with the next `num_bits` bits and advances the cursor
+    void read(Bitset* bits, size_type num_bits)
+    {
+        peek(bits, num_bits);
+        pos_ += num_bits;
+    }
+
+  private:
+    void require(size_type pos, size_type num_bits) const
+    {
+        if (pos > size_ || num_bits > size_ - pos)
+            throw(Exception("Cannot read bits - no more bits to give up! Check that all field "
+                            "codecs are always producing (encode) and consuming (decode) the "
+                            "exact same number of bits."));
+    }
+
+    // the 8 bytes starting at p as a little-endian integer (compilers turn this into a single load)
+    static uint64 load_le64(const unsigned char* p)
+    {
+        return static_cast<uint64>(p[0]) | static_cast<uint64>(p[1]) << 8 |
+               static_cast<uint64>(p[2]) << 16 | static_cast<uint64>(p[3]) << 24 |
+               static_cast<uint64>(p[4]) << 32 | static_cast<uint64>(p[5]) << 40 |
+               static_cast<uint64>(p[6]) << 48 | static_cast<uint64>(p[7]) << 56;
+    }
+
+    // reads num_bits (<= 64) starting at bit pos, assumes the range has been checked
+    uint64 bits_at(size_type pos, unsigned num_bits) const
+    {
+        if (!num_bits)
+            return 0;
+
+        const unsigned char* byte = data_ + pos / BITS_IN_BYTE;
+        const unsigned shift = pos % BITS_IN_BYTE;
+
+        uint64 value = 0;
+        unsigned filled = 0;
+        // first (partial) byte
+        value = static_cast<uint64>(*byte++) >> shift;
+        filled = BITS_IN_BYTE - shift;
+        while (filled < num_bits)
+        {
+            value |= static_cast<uint64>(*byte++) << filled;
+            filled += BITS_IN_BYTE;
+        }
+
+        return num_bits < 64 ? (value & ((static_cast<uint64>(1) << num_bits) - 1)) : value;
+    }
+
+    const unsigned char* data_;
+    size_type size_;
+    size_type pos_;
+};
+
+/// \brief Sequential (cursor based) writer that appends bits to the most significant end of a Bitset.
+///
+/// The Bitset is used as a growable packed buffer; nothing is written until the bits are explicitly added.
+class BitWriter
+{
+  public:
+    typedef Bitset::size_type size_type;
+
+    /// \brief Construct a writer that appends to `bits` (which must outlive the writer)
+    explicit BitWriter(Bitset* bits)
+        : bits_(bits), max_size_(std::numeric_limits<size_type>::max())
+    {
+    }
+
+    /// \brief Construct a writer that appends to `bits` and throws BitLimitException as soon as a write takes its size past `max_size` bits
+    BitWriter(Bitset* bits, size_type max_size) : bits_(bits), max_size_(max_size) { check(); }
+
+    /// \brief Number of bits in the underlying Bitset
+    size_type size() const { return bits_->size(); }
+
+    /// \brief Maximum number of bits in the underlying Bitset
+    size_type max_size() const { return max_size_; }
+
+    /// \brief Appends the `num_bits` (<= 64) least significant bits of `value`
+    void write(uint64 value, unsigned num_bits)
+    {
+        bits_->append_bits(value, num_bits);
+        check();
+    }
+
+    /// \brief Appends the `num_bits` (<= 64) least significant bits of each of the `count` values (see Bitset::append_packed())
+    void write_packed(const uint64* values, size_type count, unsigned num_bits)
+    {
+        bits_->append_packed(values, count, num_bits);
+        check();
+    }
+
+    /// \brief Appends all the bits of `bits`
+    void write(const Bitset& bits)
+    {
+        bits_->append(bits);
+        check();
+    }
+
+    /// \brief Appends `num_bits` false (0) bits
+    void write_zeros(size_type num_bits)
+    {
+        bits_->resize(bits_->size() + num_bits);
+        check();
+    }
+
+    /// \brief Throws BitLimitException if the underlying Bitset is larger than max_size() (for example, after it has been appended to directly through bits())
+    void check() const
+    {
+        if (bits_->size() > max_size_)
+            throw(BitLimitException());
+    }
+
+    /// \brief The Bitset being written to
+    Bitset* bits() { return bits_; }
+    const Bitset& bits() const { return *bits_; }
+
+  private:
+    Bitset* bits_;
+    size_type max_size_;
+};
+
+/// \brief Exposes the unread bits of a BitReader as a Bitset so that they can be used as the parent of a Bitset based decoder (i.e. one that uses Bitset::get_more_bits()). Bits are only read from the reader as the decoder asks for them, and any that were read but not taken are returned to the reader when this object is destroyed.
+class BitReaderPool : private BitSource
+{
+  public:
+    explicit BitReaderPool(BitReader* reader) : reader_(reader) { pool_.set_source(this); }
+    ~BitReaderPool() { reader_->seek(reader_->position() - pool_.size()); }
+
+    Bitset* bits() { return &pool_; }
+
+  private:
+    BitReaderPool(const BitReaderPool&);
+    BitReaderPool& operator=(const BitReaderPool&);
+
+    void append_to(Bitset* bits, std::size_t num_bits)
+    {
+        // a shortfall is reported by the Bitset, as it would be for any other parent
+        num_bits = std::min<std::size_t>(num_bits, reader_->remaining());
+        for (std::size_t i = 0; i < num_bits; i += Bitset::WORD_BITS)
+        {
+            const unsigned n = std::min<std::size_t>(num_bits - i, Bitset::WORD_BITS);
+            bits->append_bits(reader_->read(n), n);
+        }
+    }
+
+    BitReader* reader_;
+    Bitset pool_;
+};
+
+} // namespace dccl
+
+#endif
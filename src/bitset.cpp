@@ -35,19 +35,24 @@ dccl::Bitset dccl::Bitset::relinquish_bits(size_type num_bits,
             Bitset parent_bits = parent_->relinquish_bits(num_parent_bits, false);
             append(parent_bits);
         }
+        else if(source_)
+        {
+            source_->append_to(this, num_parent_bits);
+        }
     }
 
     Bitset out;
     if(!final_child)
     {
-        for(size_type i = 0; i < num_bits; ++i)
+        if(this->size() < num_bits)
+            throw(dccl::Exception("Cannot relinquish_bits - no more bits to give up! Check that all field codecs are always producing (encode) and consuming (decode) the exact same number of bits."));
+
+        for(size_type i = 0; i < num_bits; i += WORD_BITS)
         {
-            if(this->empty())
-                throw(dccl::Exception("Cannot relinquish_bits - no more bits to give up! Check that all field codecs are always producing (encode) and consuming (decode) the exact same number of bits."));
-            
-            out.push_back(this->front());
-            this->pop_front();
+            const unsigned n = std::min<size_type>(num_bits - i, WORD_BITS);
+            out.append_bits(this->read_bits(i, n), n);
         }
+        erase_front(num_bits);
     }
     return out;
 }
@@ -22,27 +22,127 @@
 #ifndef DCCLBITSET20120424H
 #define DCCLBITSET20120424H
 
-#include <deque>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <limits>
+#include <ostream>
+#include <stdexcept>
 #include <string>
-#include <cstring>
+#include <vector>
 
 #include "exception.h"
 
 namespace dccl
 {
-    /// \brief A variable size container of bits (subclassed from std::deque<bool>) with an optional hierarchy. Similar to set::bitset but can be resized at runtime and has the ability to have parent Bitsets that can give bits to their children.
+    class Bitset;
+
+    /// \brief Supplies bits on demand to a Bitset at the top of a hierarchy (i.e. one with no parent), for example the bits of a BitReader that have not yet been read (see BitReaderPool).
+    class BitSource
+    {
+      public:
+        virtual ~BitSource() { }
+
+        /// \brief Append up to `num_bits` more bits to the big end of `bits` (fewer if that many are not available)
+        virtual void append_to(Bitset* bits, std::size_t num_bits) = 0;
+    };
+
+    /// \brief A variable size container of bits (packed into 64-bit words) with an optional hierarchy. Similar to set::bitset but can be resized at runtime and has the ability to have parent Bitsets that can give bits to their children.
     /// 
-    /// This is the class used within DCCL hold the encoded message as it is created. The front() of the deque represents the least significant bit (lsb) and the back() is the most significant bit (msb). DCCL messages are encoded and decoded starting with the  lsb and ending at the msb. The hierarchy is used to represent parent bit pools from which the child can pull more bits from to decode. The top level Bitset represents the entire encoded message, whereas the children are the message fields. 
-    class Bitset : public std::deque<bool>
+    /// This is the class used within DCCL hold the encoded message as it is created. The front() of the Bitset represents the least significant bit (lsb) and the back() is the most significant bit (msb). DCCL messages are encoded and decoded starting with the  lsb and ending at the msb. The hierarchy is used to represent parent bit pools from which the child can pull more bits from to decode. The top level Bitset represents the entire encoded message, whereas the children are the message fields.
+    ///
+    /// The interface mirrors the subset of std::deque<bool> that DCCL has historically exposed (iterators, operator[], push/pop at either end, resize) so that existing field codecs continue to work unchanged, but bulk operations (shifts, append, get_more_bits, to(), from() and the byte conversions) operate a word at a time.
+    class Bitset
     {
       public:
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef bool value_type;
+        typedef bool const_reference;
+        typedef std::uint64_t word_type;
+
+        enum { WORD_BITS = 64 };
+
+        /// \brief Proxy reference to a single bit (as std::vector<bool>::reference)
+        class reference
+        {
+          public:
+            reference(word_type* word, word_type mask) : word_(word), mask_(mask) { }
+            operator bool() const { return (*word_ & mask_) != 0; }
+            reference& operator=(bool val)
+            {
+                if(val) *word_ |= mask_;
+                else *word_ &= ~mask_;
+                return *this;
+            }
+            reference& operator=(const reference& rhs) { return *this = static_cast<bool>(rhs); }
+            bool operator~() const { return !static_cast<bool>(*this); }
+            reference& flip() { *word_ ^= mask_; return *this; }
+          private:
+            word_type* word_;
+            word_type mask_;
+        };
+
+        /// \brief Random access iterator over the bits (lsb first)
+        template<typename BitsetPtr, typename Reference>
+            class basic_iterator
+        {
+          public:
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef bool value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef Reference reference;
+
+            basic_iterator() : bits_(0), i_(0) { }
+            basic_iterator(BitsetPtr bits, size_type i) : bits_(bits), i_(i) { }
+            // allow iterator -> const_iterator
+            template<typename OtherPtr, typename OtherRef>
+                basic_iterator(const basic_iterator<OtherPtr, OtherRef>& other) : bits_(other.bits_), i_(other.i_) { }
+
+            reference operator*() const { return (*bits_)[i_]; }
+            reference operator[](difference_type n) const { return (*bits_)[i_ + n]; }
+
+            basic_iterator& operator++() { ++i_; return *this; }
+            basic_iterator operator++(int) { basic_iterator t(*this); ++i_; return t; }
+            basic_iterator& operator--() { --i_; return *this; }
+            basic_iterator operator--(int) { basic_iterator t(*this); --i_; return t; }
+            basic_iterator& operator+=(difference_type n) { i_ += n; return *this; }
+            basic_iterator& operator-=(difference_type n) { i_ -= n; return *this; }
+            basic_iterator operator+(difference_type n) const { return basic_iterator(bits_, i_ + n); }
+            basic_iterator operator-(difference_type n) const { return basic_iterator(bits_, i_ - n); }
+            friend basic_iterator operator+(difference_type n, const basic_iterator& it) { return it + n; }
+            difference_type operator-(const basic_iterator& rhs) const
+            { return static_cast<difference_type>(i_) - static_cast<difference_type>(rhs.i_); }
+
+            bool operator==(const basic_iterator& rhs) const { return i_ == rhs.i_; }
+            bool operator!=(const basic_iterator& rhs) const { return i_ != rhs.i_; }
+            bool operator<(const basic_iterator& rhs) const { return i_ < rhs.i_; }
+            bool operator>(const basic_iterator& rhs) const { return i_ > rhs.i_; }
+            bool operator<=(const basic_iterator& rhs) const { return i_ <= rhs.i_; }
+            bool operator>=(const basic_iterator& rhs) const { return i_ >= rhs.i_; }
+
+          private:
+            template<typename, typename> friend class basic_iterator;
+            BitsetPtr bits_;
+            size_type i_;
+        };
+
+        typedef basic_iterator<Bitset*, reference> iterator;
+        typedef basic_iterator<const Bitset*, bool> const_iterator;
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
         /// \brief Construct an empty Bitset.
         ///
         /// \param parent Pointer to a bitset that should be consider this Bitset's parent for calls to get_more_bits()
         explicit Bitset(Bitset* parent = 0)
-            : parent_(parent)
+            : offset_(0),
+            size_(0),
+            parent_(parent),
+            source_(0)
         { }
 
         /// \brief Construct a Bitset of a certain initial size and value.
@@ -51,8 +151,10 @@ namespace dccl
         /// \param value Initial value of the bits in this Bitset
         /// \param parent Pointer to a bitset that should be consider this Bitset's parent for calls to get_more_bits()
         explicit Bitset(size_type num_bits, unsigned long value = 0, Bitset* parent = 0)
-            : std::deque<bool>(num_bits, false),
-            parent_(parent)
+            : offset_(0),
+            size_(0),
+            parent_(parent),
+            source_(0)
             { from(value, num_bits); }
         
         ~Bitset() { } 
@@ -65,6 +167,106 @@ namespace dccl
         /// \throw Exception The parent (and up the hierarchy, if applicable) do not have num_bits to give up.
         void get_more_bits(size_type num_bits);
 
+        /// \brief Set a source to take bits from when this Bitset (which must have no parent) is asked for more bits than it has
+        void set_source(BitSource* source) { source_ = source; }
+
+        /// \name Container interface
+        //@{
+        size_type size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        void clear() { words_.clear(); offset_ = 0; size_ = 0; }
+
+        /// \brief Resize the Bitset, filling any new (most significant) bits with `value`
+        void resize(size_type num_bits, bool value = false)
+        {
+            if(num_bits < size_)
+            {
+                clear_range(num_bits, size_ - num_bits);
+                size_ = num_bits;
+                words_.resize(words_for(offset_ + size_));
+            }
+            else if(num_bits > size_)
+            {
+                const word_type fill = value ? ~word_type(0) : word_type(0);
+                size_type remaining = num_bits - size_;
+                while(remaining)
+                {
+                    unsigned n = std::min<size_type>(remaining, WORD_BITS);
+                    append_bits(fill, n);
+                    remaining -= n;
+                }
+            }
+        }
+
+        bool operator[](size_type n) const
+        {
+            const size_type pos = offset_ + n;
+            return (words_[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1;
+        }
+
+        reference operator[](size_type n)
+        {
+            const size_type pos = offset_ + n;
+            return reference(&words_[pos / WORD_BITS], word_type(1) << (pos % WORD_BITS));
+        }
+
+        bool at(size_type n) const
+        {
+            if(n >= size_) throw std::out_of_range("dccl::Bitset::at");
+            return (*this)[n];
+        }
+
+        reference at(size_type n)
+        {
+            if(n >= size_) throw std::out_of_range("dccl::Bitset::at");
+            return (*this)[n];
+        }
+
+        reference front() { return (*this)[0]; }
+        bool front() const { return (*this)[0]; }
+        reference back() { return (*this)[size_ - 1]; }
+        bool back() const { return (*this)[size_ - 1]; }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, size_); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, size_); }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        /// \brief Add a bit to the big (most significant) end
+        void push_back(bool bit)
+        { append_bits(bit ? 1 : 0, 1); }
+
+        /// \brief Remove a bit from the big (most significant) end
+        void pop_back()
+        { resize(size_ - 1); }
+
+        /// \brief Add a bit to the little (least significant) end
+        void push_front(bool bit)
+        {
+            reserve_front(1);
+            --offset_;
+            ++size_;
+            (*this)[0] = bit;
+        }
+
+        /// \brief Remove a bit from the little (least significant) end
+        void pop_front()
+        { erase_front(1); }
+
+        void swap(Bitset& other)
+        {
+            words_.swap(other.words_);
+            std::swap(offset_, other.offset_);
+            std::swap(size_, other.size_);
+            std::swap(parent_, other.parent_);
+            std::swap(source_, other.source_);
+        }
+        //@}
+
         /// \brief Logical AND in place
         ///
         /// Apply the result of a logical AND of this Bitset and another to this Bitset.
@@ -75,9 +277,12 @@ namespace dccl
         {
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator&= requires this->size() == rhs.size()"));
-                
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] & rhs[i];
+
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                unsigned n = std::min<size_type>(size_ - i, WORD_BITS);
+                write_bits(i, n, read_bits(i, n) & rhs.read_bits(i, n));
+            }
             return *this;
         }
 
@@ -92,8 +297,11 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator|= requires this->size() == rhs.size()"));
 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] | rhs[i];
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                unsigned n = std::min<size_type>(size_ - i, WORD_BITS);
+                write_bits(i, n, read_bits(i, n) | rhs.read_bits(i, n));
+            }
             return *this;
         }
             
@@ -108,8 +316,11 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator^= requires this->size() == rhs.size()"));
 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] ^ rhs[i];
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                unsigned n = std::min<size_type>(size_ - i, WORD_BITS);
+                write_bits(i, n, read_bits(i, n) ^ rhs.read_bits(i, n));
+            }
             return *this;
         }
             
@@ -124,11 +335,15 @@ namespace dccl
         /// \return  A reference to the resulting Bitset
         Bitset& operator<<=(size_type n)
         {
-            for(size_type i = 0; i < n; ++i)
-            {
-                push_front(false);
-                pop_back();
-            }
+            const size_type old_size = size_;
+            if(n >= old_size)
+                return reset();
+
+            // drop the most significant n bits, then insert n zeros at the little end
+            resize(old_size - n);
+            reserve_front(n);
+            offset_ -= n;
+            size_ += n;
             return *this;
         }
                
@@ -140,11 +355,12 @@ namespace dccl
         /// \return  A reference to the resulting Bitset
         Bitset& operator>>=(size_type n)
         {
-            for(size_type i = 0; i < n; ++i)
-            {
-                push_back(false);
-                pop_front();
-            }
+            const size_type old_size = size_;
+            if(n >= old_size)
+                return reset();
+
+            erase_front(n);
+            resize(old_size);
             return *this;
         }
             
@@ -184,8 +400,8 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& set()
         {
-            for(iterator it = begin(), n = end(); it != n; ++it)
-                *it = true;
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+                write_bits(i, std::min<size_type>(size_ - i, WORD_BITS), ~word_type(0));
             return *this;
         }
             
@@ -201,8 +417,7 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& reset()
         {
-            for(iterator it = begin(), n = end(); it != n; ++it)
-                *it = false;
+            std::fill(words_.begin(), words_.end(), word_type(0));
             return *this;
         }
 
@@ -218,8 +433,11 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& flip()
         {
-            for(size_type i = 0, n = size(); i < n; ++i)
-                flip(i);
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                unsigned n = std::min<size_type>(size_ - i, WORD_BITS);
+                write_bits(i, n, ~read_bits(i, n));
+            }
             return *this;
         }
             
@@ -244,13 +462,12 @@ namespace dccl
         template<typename IntType>
             void from(IntType value, size_type num_bits = std::numeric_limits<IntType>::digits)
         {
-            this->resize(num_bits);
-            for(int i = 0, n = std::min<size_type>(std::numeric_limits<IntType>::digits, size());
-                i < n; ++i)
-            {
-                if(value & (static_cast<IntType>(1) << i))
-                    (*this)[i] = true;
-            }
+            clear();
+            resize(num_bits);
+
+            const unsigned n = std::min<size_type>(std::numeric_limits<IntType>::digits, num_bits);
+            if(n)
+                write_bits(0, n, static_cast<word_type>(value));
         }
 
         /// \brief Sets value of the Bitset to the contents of an unsigned long integer. Equivalent to from<unsigned long>()
@@ -269,14 +486,7 @@ namespace dccl
             if(size() > static_cast<size_type>(std::numeric_limits<IntType>::digits))
                 throw(Exception("Type IntType cannot represent current bitset (this->size() > std::numeric_limits<IntType>::digits)"));
 
-            IntType out = 0;
-            for(int i = 0, n = size(); i < n; ++i)
-            {
-                if((*this)[i])
-                    out |= (static_cast<IntType>(1) << i);
-            }
-                
-            return out;
+            return size_ ? static_cast<IntType>(read_bits(0, size_)) : IntType(0);
         }
 
         
@@ -290,13 +500,8 @@ namespace dccl
         std::string to_string() const
         {
             std::string s(size(), 0);
-            int i = 0;
-            for(Bitset::const_reverse_iterator it = rbegin(),
-                    n = rend(); it != n; ++it)
-            {
-                s[i] = (*it) ? '1' : '0';
-                ++i;
-            }
+            for(size_type i = 0; i < size_; ++i)
+                s[size_ - i - 1] = (*this)[i] ? '1' : '0';
             return s;
         }
 
@@ -307,14 +512,12 @@ namespace dccl
         /// \brief Returns the value of the Bitset to a byte string, where each character represents 8 bits of the Bitset. The string is used as a byte container, and is not intended to be printed.
         ///
         /// \return A string containing the value of the Bitset, with the least signficant byte in string[0] and the most significant byte in string[size()-1]
-        std::string to_byte_string()
+        std::string to_byte_string() const
         {
             // number of bytes needed is ceil(size() / 8)
             std::string s(this->size()/8 + (this->size()%8 ? 1 : 0), 0);
-                
-            for(size_type i = 0, n = this->size(); i < n; ++i)
-                s[i/8] |= static_cast<char>((*this)[i] << (i%8));
-                
+            if(!s.empty())
+                to_byte_string(&s[0], s.size());
             return s;
         }
 
@@ -323,7 +526,7 @@ namespace dccl
         /// \param max_len Maximum length of buf
         /// \return number of bytes written to buf
         /// \throw std::length_error if max_len < encoded length.
-        size_t to_byte_string(char* buf, size_t max_len)
+        size_t to_byte_string(char* buf, size_t max_len) const
         {
             // number of bytes needed is ceil(size() / 8)
             size_t len = this->size()/8 + (this->size()%8 ? 1 : 0);
@@ -333,11 +536,13 @@ namespace dccl
                 throw std::length_error("max_len must be >= len");
             }
 
-            // initialize buffer to all zeroes
-            std::fill_n(buf, len, 0);
-
-            for(size_type i = 0, n = this->size(); i < n; ++i)
-                buf[i/8] |= static_cast<char>((*this)[i] << (i%8));
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                const unsigned n = std::min<size_type>(size_ - i, WORD_BITS);
+                const word_type w = read_bits(i, n);
+                for(unsigned j = 0; j < n; j += 8)
+                    buf[(i + j) / 8] = static_cast<char>((w >> j) & 0xFF);
+            }
 
             return len;
         }
@@ -357,60 +562,214 @@ namespace dccl
         template<typename CharIterator>
         void from_byte_stream(CharIterator begin, CharIterator end)
         {
-            this->resize(std::distance(begin, end) * 8);
-            int i = 0;
-            for(CharIterator it = begin; it != end; ++it)
-            {
-                for(size_type j = 0; j < 8; ++j)
-                    (*this)[i*8+j] = (*it) & (1 << j);
-                ++i;
-            }
+            const size_type num_bytes = std::distance(begin, end);
+            offset_ = 0;
+            size_ = num_bytes * 8;
+            words_.assign(words_for(size_), 0);
+
+            size_type i = 0;
+            for(CharIterator it = begin; it != end; ++it, ++i)
+                words_[i / 8] |= static_cast<word_type>(static_cast<unsigned char>(*it)) << (8 * (i % 8));
         }
 
         /// \brief Adds the bitset to the little end
         Bitset& prepend(const Bitset& bits)
         {
-            for(const_reverse_iterator it = bits.rbegin(),
-                    n = bits.rend(); it != n; ++it)
-                push_front(*it);
-
+            const size_type n = bits.size();
+            if(!n)
+                return *this;
+
+            reserve_front(n);
+            offset_ -= n;
+            size_ += n;
+            for(size_type i = 0; i < n; i += WORD_BITS)
+            {
+                const unsigned k = std::min<size_type>(n - i, WORD_BITS);
+                write_bits(i, k, bits.read_bits(i, k));
+            }
             return *this;
         }
 
         /// \brief Adds the bitset to the big end
         Bitset& append(const Bitset& bits)
         {
-            for(const_iterator it = bits.begin(),
-                    n = bits.end(); it != n; ++it)
-                push_back(*it);                
-
+            const size_type n = bits.size();
+            for(size_type i = 0; i < n; i += WORD_BITS)
+            {
+                const unsigned k = std::min<size_type>(n - i, WORD_BITS);
+                append_bits(bits.read_bits(i, k), k);
+            }
             return *this;
         }
-            
+
+        /// \brief Adds the least significant `num_bits` of `value` to the big end
+        ///
+        /// \param value Bits to add (bits above `num_bits` are ignored)
+        /// \param num_bits Number of bits to add (must be <= 64)
+        void append_bits(word_type value, unsigned num_bits)
+        {
+            if(!num_bits)
+                return;
+            const size_type pos = size_;
+            size_ += num_bits;
+            words_.resize(words_for(offset_ + size_), 0);
+            write_bits(pos, num_bits, value);
+        }
+
+        /// \brief Adds `count` values of `num_bits` each to the big end (`values[0]` becomes the least significant). This is equivalent to calling append_bits() for each value but builds each word of storage only once.
+        ///
+        /// \param values Values to add (bits above `num_bits` are ignored)
+        /// \param count Number of values to add
+        /// \param num_bits Number of bits of each value to add (must be <= 64)
+        void append_packed(const word_type* values, size_type count, unsigned num_bits)
+        {
+            if(!num_bits || !count)
+                return;
+
+            const size_type abs_pos = offset_ + size_;
+            size_ += count * num_bits;
+            words_.resize(words_for(offset_ + size_), 0);
+
+            size_type w = abs_pos / WORD_BITS;
+            unsigned filled = abs_pos % WORD_BITS;
+            // storage above the most significant bit is always zero
+            word_type acc = words_[w] & mask(filled);
+            const word_type m = mask(num_bits);
+            for(size_type i = 0; i < count; ++i)
+            {
+                const word_type value = values[i] & m;
+                acc |= value << filled;
+                filled += num_bits;
+                if(filled >= static_cast<unsigned>(WORD_BITS))
+                {
+                    words_[w++] = acc;
+                    filled -= WORD_BITS;
+                    // the bits of value that did not fit
+                    acc = filled ? value >> (num_bits - filled) : 0;
+                }
+            }
+            if(filled)
+                words_[w] = acc;
+        }
+
+        /// \brief Returns `num_bits` (<= 64) bits starting at bit `pos` as an integer (bit `pos` becomes the lsb of the result)
+        word_type read_bits(size_type pos, unsigned num_bits) const
+        {
+            if(!num_bits)
+                return 0;
+
+            const size_type abs_pos = offset_ + pos;
+            const size_type w = abs_pos / WORD_BITS;
+            const unsigned b = abs_pos % WORD_BITS;
+
+            word_type out = words_[w] >> b;
+            if(b && b + num_bits > WORD_BITS)
+                out |= words_[w + 1] << (WORD_BITS - b);
+            return out & mask(num_bits);
+        }
+
+        /// \brief Overwrites `num_bits` (<= 64) bits starting at bit `pos` with the least significant bits of `value`
+        void write_bits(size_type pos, unsigned num_bits, word_type value)
+        {
+            if(!num_bits)
+                return;
+
+            value &= mask(num_bits);
+            const size_type abs_pos = offset_ + pos;
+            const size_type w = abs_pos / WORD_BITS;
+            const unsigned b = abs_pos % WORD_BITS;
+
+            words_[w] = (words_[w] & ~(mask(num_bits) << b)) | (value << b);
+            if(b && b + num_bits > WORD_BITS)
+            {
+                const unsigned spill = b + num_bits - WORD_BITS;
+                words_[w + 1] = (words_[w + 1] & ~mask(spill)) | (value >> (WORD_BITS - b));
+            }
+        }
             
       private:            
         Bitset relinquish_bits(size_type num_bits, bool final_child);
+
+        static word_type mask(unsigned num_bits)
+        { return num_bits >= static_cast<unsigned>(WORD_BITS) ? ~word_type(0) : ((word_type(1) << num_bits) - 1); }
+
+        static size_type words_for(size_type num_bits)
+        { return (num_bits + WORD_BITS - 1) / WORD_BITS; }
+
+        // zero bits [pos, pos+num_bits) so that storage outside of the Bitset is always zero
+        void clear_range(size_type pos, size_type num_bits)
+        {
+            for(size_type i = 0; i < num_bits; i += WORD_BITS)
+                write_bits(pos + i, std::min<size_type>(num_bits - i, WORD_BITS), 0);
+        }
+
+        // ensures at least num_bits of (zeroed) room below the current least significant bit
+        void reserve_front(size_type num_bits)
+        {
+            if(offset_ >= num_bits)
+                return;
+            const size_type new_words = words_for(num_bits - offset_);
+            words_.insert(words_.begin(), new_words, word_type(0));
+            offset_ += new_words * WORD_BITS;
+        }
+
+        // removes num_bits (<= size()) from the little end
+        void erase_front(size_type num_bits)
+        {
+            clear_range(0, num_bits);
+            offset_ += num_bits;
+            size_ -= num_bits;
+
+            // release whole words that are now entirely below the least significant bit
+            const size_type dead_words = offset_ / WORD_BITS;
+            if(dead_words)
+            {
+                words_.erase(words_.begin(), words_.begin() + std::min(dead_words, words_.size()));
+                offset_ -= dead_words * WORD_BITS;
+            }
+        }
             
       private:            
+        // bit i of this Bitset is stored at bit (offset_ + i) of words_
+        std::vector<word_type> words_;
+        size_type offset_;
+        size_type size_;
         Bitset* parent_;
-
-            
+        BitSource* source_;
     };
     
     inline bool operator==(const Bitset& a, const Bitset& b)
     {
-        return (a.size() == b.size()) && std::equal(a.begin(), a.end(), b.begin());
+        if(a.size() != b.size())
+            return false;
+        for(Bitset::size_type i = 0, n = a.size(); i < n; i += Bitset::WORD_BITS)
+        {
+            const unsigned k = std::min<Bitset::size_type>(n - i, Bitset::WORD_BITS);
+            if(a.read_bits(i, k) != b.read_bits(i, k))
+                return false;
+        }
+        return true;
     }
         
     inline bool operator<(const Bitset& a, const Bitset& b)
     {
-        for(int i = (std::max(a.size(), b.size()) - 1); i >= 0; --i)
+        // compare a word at a time, starting from the most significant end
+        // (missing high bits in the shorter Bitset are treated as zero)
+        Bitset::size_type n = std::max(a.size(), b.size());
+        while(n > 0)
         {
-            bool a_bit = (i < static_cast<int>(a.size())) ? a[i] : 0;
-            bool b_bit = (i < static_cast<int>(b.size())) ? b[i] : 0;
-                
-            if(a_bit > b_bit) return false;
-            else if(a_bit < b_bit) return true;
+            const unsigned k = (n % Bitset::WORD_BITS) ? (n % Bitset::WORD_BITS) : static_cast<unsigned>(Bitset::WORD_BITS);
+            const Bitset::size_type pos = n - k;
+
+            Bitset::word_type a_word = 0, b_word = 0;
+            if(pos < a.size())
+                a_word = a.read_bits(pos, std::min<Bitset::size_type>(k, a.size() - pos));
+            if(pos < b.size())
+                b_word = b.read_bits(pos, std::min<Bitset::size_type>(k, b.size() - pos));
+
+            if(a_word != b_word)
+                return a_word < b_word;
+            n = pos;
         }
         return false;
     }                
@@ -141,6 +141,8 @@ namespace dccl
             double max() { return (1 << dccl::BITS_IN_BYTE) - 1; }
             double min() { return 0; }
             void validate() { }
+            // encode() and decode() scale the value
+            bool bulk_quantize() { return false; }
             
             enum { SCALE_FACTOR = 4 };
             
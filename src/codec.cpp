@@ -20,6 +20,13 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include <dlfcn.h> // for shared library loading
 
@@ -59,13 +66,156 @@ using google::protobuf::Descriptor;
 using google::protobuf::FieldDescriptor;
 using google::protobuf::Reflection;
 
+#if DCCL_HAS_CRYPTOPP
+namespace
+{
+// AES-CTR cipher whose key schedule is expanded once, so that each message only needs its IV set
+class CtrCipher
+{
+  public:
+    explicit CtrCipher(const std::string& key)
+    {
+        using namespace CryptoPP;
+        byte iv[AES::BLOCKSIZE] = {0};
+        cipher_.SetKeyWithIV((const byte*)key.data(), key.size(), iv);
+    }
+
+    // en/decrypts [s, s + size) in place, with the IV given by the SHA256 hash of the nonce
+    void process(char* s, std::size_t size, const char* nonce, std::size_t nonce_size)
+    {
+        using namespace CryptoPP;
+        byte iv[SHA256::DIGESTSIZE];
+        hash_.CalculateDigest(iv, (const byte*)nonce, nonce_size);
+        cipher_.Resynchronize(iv, AES::BLOCKSIZE);
+        cipher_.ProcessData((byte*)s, (const byte*)s, size);
+    }
+
+  private:
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption cipher_;
+    CryptoPP::SHA256 hash_;
+};
+
+} // namespace
+#endif // DCCL_HAS_CRYPTOPP
+
+namespace
+{
+// overwrites the key before clearing it, so that it doesn't linger in memory that is reused
+void wipe_key(std::string* key)
+{
+    volatile char* p = &(*key)[0];
+    for (std::size_t i = 0, n = key->size(); i < n; ++i) p[i] = 0;
+    key->clear();
+}
+} // namespace
+
+// A cipher holds the counter state of the message it is processing, so cannot be shared between
+// threads; instead each thread en/decrypting takes an idle cipher from its Codec's pool (expanding
+// a new one if there are none) and returns it afterwards. The pool is emptied when the key
+// changes (Crypto++ wipes the key schedules as they are destroyed), and a cipher taken before
+// that is not returned to it
+struct dccl::Codec::CipherPool
+{
+#if DCCL_HAS_CRYPTOPP
+    struct Cipher
+    {
+        Cipher(const std::string& key, unsigned generation)
+            : cipher(key), key_generation(generation)
+        {
+        }
+        CtrCipher cipher;
+        unsigned key_generation;
+    };
+
+    // a cipher taken from the pool (when first needed) until this is destroyed
+    class Lease
+    {
+      public:
+        Lease(CipherPool& pool, const std::string& key) : pool_(pool), key_(key) {}
+        ~Lease()
+        {
+            if (cipher_)
+                pool_.release(std::move(cipher_));
+        }
+
+        void process(char* s, std::size_t size, const char* nonce, std::size_t nonce_size)
+        {
+            if (!size)
+                return;
+            if (!cipher_)
+                cipher_ = pool_.acquire(key_);
+            cipher_->cipher.process(s, size, nonce, nonce_size);
+        }
+
+      private:
+        CipherPool& pool_;
+        const std::string& key_;
+        std::unique_ptr<Cipher> cipher_;
+    };
+
+    std::unique_ptr<Cipher> acquire(const std::string& key)
+    {
+        unsigned generation;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty())
+            {
+                std::unique_ptr<Cipher> cipher(std::move(idle.back()));
+                idle.pop_back();
+                return cipher;
+            }
+            generation = key_generation;
+        }
+        // expanding the key schedule is the slow part, so is done outside the lock
+        return std::unique_ptr<Cipher>(new Cipher(key, generation));
+    }
+
+    void release(std::unique_ptr<Cipher> cipher)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cipher->key_generation != key_generation)
+            return;
+        idle.push_back(std::move(cipher));
+        // more than this are only idle after a burst of threads: keep the most recently used
+        if (idle.size() > max_idle)
+            idle.pop_front();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.clear();
+        ++key_generation;
+    }
+
+    static constexpr std::size_t max_idle = 16;
+    std::mutex mutex;
+    // least recently used first
+    std::deque<std::unique_ptr<Cipher>> idle;
+    unsigned key_generation{0};
+#else
+    class Lease
+    {
+      public:
+        Lease(CipherPool&, const std::string&) {}
+        void process(char*, std::size_t, const char*, std::size_t) {}
+    };
+
+    void clear() {}
+#endif
+};
+
 
 //
 // Codec
 //
 
 dccl::Codec::Codec(const std::string& dccl_id_codec, const std::string& library_path)
-    : strict_(false), id_codec_(dccl_id_codec), console_width_(60)
+    : ciphers_(new CipherPool),
+      strict_(false),
+      id_codec_(dccl_id_codec),
+      console_width_(60),
+      manager_(&FieldCodecManager::global())
 {
     set_default_codecs();
     FieldCodecManager::add<DefaultIdentifierCodec>(default_id_codec_name());
@@ -80,10 +230,16 @@ dccl::Codec::~Codec()
 {
     for (std::vector<void*>::iterator it = dl_handles_.begin(), n = dl_handles_.end(); it != n;
          ++it)
-    {
         unload_library(*it);
+
+    // the codecs may have been created by the libraries, so destroy them before closing these
+    manager_.clear();
+    for (std::vector<void*>::iterator it = dl_handles_.begin(), n = dl_handles_.end(); it != n;
+         ++it)
         dlclose(*it);
-    }
+
+    ciphers_->clear();
+    wipe_key(&crypto_key_);
 }
 
 void dccl::Codec::set_default_codecs()
@@ -190,9 +346,14 @@ void dccl::Codec::set_default_codecs()
     }
 }
 
-void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool header_only,
-                                  Bitset& head_bits, Bitset& body_bits, int user_id)
+unsigned dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool header_only,
+                                      Bitset& head_bits, Bitset& body_bits, int user_id,
+                                      boost::shared_ptr<FieldCodecBase> codec,
+                                      std::size_t max_bytes /* = 0 */)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    // the message is not modified, so each dynamic condition need only be evaluated once
+    DynamicConditions::MemoizeScope memoize_conditions;
     const Descriptor* desc = msg.GetDescriptor();
 
     dlog.is(DEBUG1, ENCODE) && dlog << "Began encoding message of type: " << desc->full_name()
@@ -202,6 +363,9 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
     {
         unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
         size_t head_byte_size = 0;
+        unsigned head_size_bits = 0;
+        const Bitset::size_type max_bits =
+            max_bytes ? max_bytes * BITS_IN_BYTE : std::numeric_limits<Bitset::size_type>::max();
 
         if (!msg.IsInitialized() && !header_only)
             throw(Exception(
@@ -211,8 +375,8 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
             throw(Exception("Message id " + boost::lexical_cast<std::string>(dccl_id) +
                             " has not been loaded. Call load() before encoding this type."));
 
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-        boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(desc);
+        if (!codec)
+            codec = manager_.find(desc);
 
         if (codec)
         {
@@ -221,9 +385,12 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
 
             internal::MessageStack msg_stack;
             msg_stack.push(msg.GetDescriptor());
-            codec->base_encode(&head_bits, msg, HEAD, strict_);
+            BitWriter head_writer(&head_bits, max_bits);
+            codec->base_encode(&head_writer, msg, HEAD, strict_);
+            head_writer.check();
 
             // given header of not even byte size (e.g. 01011), make even byte size (e.g. 00001011)
+            head_size_bits = head_bits.size();
             head_byte_size = ceil_bits2bytes(head_bits.size());
             head_bits.resize(head_byte_size * BITS_IN_BYTE);
 
@@ -234,7 +401,10 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
             }
             else
             {
-                codec->base_encode(&body_bits, msg, BODY, strict_);
+                BitWriter body_writer(&body_bits, max_bytes ? max_bits - head_bits.size()
+                                                            : max_bits);
+                codec->base_encode(&body_writer, msg, BODY, strict_);
+                body_writer.check();
             }
         }
         else
@@ -242,6 +412,8 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
             throw(Exception("Failed to find (dccl.msg).codec `" +
                             desc->options().GetExtension(dccl::msg).codec() + "`"));
         }
+
+        return head_size_bits;
     }
     catch (dccl::OutOfRangeException& e)
     {
@@ -251,6 +423,12 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
                  << e.what() << std::endl;
         throw;
     }
+    catch (BitLimitException& e)
+    {
+        dlog.is(DEBUG2, ENCODE) && dlog << "Message " << desc->full_name()
+                                        << " is larger than " << max_bytes << " bytes" << std::endl;
+        throw;
+    }
     catch (std::exception& e)
     {
         std::stringstream ss;
@@ -270,6 +448,66 @@ size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::
     Bitset body_bits;
     encode_internal(msg, header_only, head_bits, body_bits, user_id);
 
+    unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
+    return write_encoded(bytes, max_len, head_bits, body_bits, header_only, dccl_id, desc);
+}
+
+bool dccl::Codec::try_encode(char* bytes, size_t max_len, const google::protobuf::Message& msg,
+                             EncodedSize* size /* = 0 */, int user_id /* = -1 */)
+{
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    const Descriptor* desc = msg.GetDescriptor();
+    unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
+    const boost::shared_ptr<FieldCodecBase>& codec = manager_.find(desc);
+
+    std::size_t max_bytes = 0;
+    if (codec && id2desc_.count(dccl_id))
+    {
+        unsigned id_bits = 0;
+        id_codec()->field_size(&id_bits, dccl_id, 0);
+
+        // the message sizes are cached, so this is much cheaper than encoding
+        unsigned head_bits, body_bits;
+        codec->base_min_size(&head_bits, desc, HEAD);
+        codec->base_min_size(&body_bits, desc, BODY);
+        if (ceil_bits2bytes(id_bits + head_bits) + ceil_bits2bytes(body_bits) > max_len)
+            return false;
+
+        codec->base_max_size(&head_bits, desc, HEAD);
+        codec->base_max_size(&body_bits, desc, BODY);
+        if (ceil_bits2bytes(id_bits + head_bits) + ceil_bits2bytes(body_bits) > max_len)
+            max_bytes = max_len;
+    }
+
+    Bitset head_bits;
+    Bitset body_bits;
+    unsigned head_size_bits = 0;
+    try
+    {
+        head_size_bits =
+            encode_internal(msg, false, head_bits, body_bits, dccl_id, codec, max_bytes);
+    }
+    catch (BitLimitException& e)
+    {
+        return false;
+    }
+
+    write_encoded(bytes, max_len, head_bits, body_bits, false, dccl_id, desc);
+
+    if (size)
+    {
+        size->head_bits = head_size_bits;
+        size->body_bits = body_bits.size();
+        size->head_bytes = ceil_bits2bytes(head_bits.size());
+        size->body_bytes = ceil_bits2bytes(body_bits.size());
+    }
+    return true;
+}
+
+size_t dccl::Codec::write_encoded(char* bytes, size_t max_len, const Bitset& head_bits,
+                                  const Bitset& body_bits, bool header_only, unsigned dccl_id,
+                                  const Descriptor* desc)
+{
     size_t head_byte_size = ceil_bits2bytes(head_bits.size());
     if (max_len < head_byte_size)
     {
@@ -301,14 +539,8 @@ size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::
         dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " << body_byte_size << "("
                                         << body_bits.size() << ")" << std::endl;
 
-        unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
         if (!crypto_key_.empty() && !skip_crypto_ids_.count(dccl_id))
-        {
-            std::string head_bytes(bytes, bytes + head_byte_size);
-            std::string body_bytes(bytes + head_byte_size, bytes + head_byte_size + body_byte_size);
-            encrypt(&body_bytes, head_bytes);
-            std::memcpy(bytes + head_byte_size, body_bytes.data(), body_bytes.size());
-        }
+            encrypt(bytes + head_byte_size, body_byte_size, bytes, head_byte_size);
 
         dlog.is(logger::DEBUG3, logger::ENCODE) &&
             dlog << "Encrypted Body (hex): "
@@ -330,45 +562,299 @@ void dccl::Codec::encode(std::string* bytes, const google::protobuf::Message& ms
     Bitset body_bits;
     encode_internal(msg, header_only, head_bits, body_bits, user_id);
 
-    std::string head_bytes = head_bits.to_byte_string();
+    // written (and encrypted) in place at the end of bytes
+    const std::size_t offset = bytes->size();
+    const std::size_t head_byte_size = ceil_bits2bytes(head_bits.size());
+    const std::size_t body_byte_size = header_only ? 0 : ceil_bits2bytes(body_bits.size());
+    bytes->resize(offset + head_byte_size + body_byte_size);
+    const unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
+    write_encoded(&(*bytes)[offset], head_byte_size + body_byte_size, head_bits, body_bits,
+                  header_only, dccl_id, desc);
+}
 
-    dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes (bits): " << head_bytes.size() << "("
-                                    << head_bits.size() << ")" << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (bin): " << head_bits << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (hex): " << hex_encode(head_bytes)
-                                    << std::endl;
+void dccl::Codec::encode_batch(std::string* bytes,
+                               const std::vector<const google::protobuf::Message*>& msgs,
+                               std::vector<std::size_t>* offsets /* = 0 */,
+                               unsigned num_threads /* = 1 */)
+{
+    // the dccl id, codec and whether to encrypt, for each message type in this batch
+    struct TypeInfo
+    {
+        unsigned dccl_id;
+        boost::shared_ptr<FieldCodecBase> codec;
+        bool encrypt;
+    };
+    std::map<const Descriptor*, TypeInfo> types;
 
-    std::string body_bytes;
-    if (!header_only)
+    if (offsets)
     {
-        body_bytes = body_bits.to_byte_string();
+        offsets->clear();
+        offsets->reserve(msgs.size() + 1);
+    }
 
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (bin): " << body_bits << std::endl;
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (hex): " << hex_encode(body_bytes)
-                                        << std::endl;
-        dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " << body_bytes.size() << "("
-                                        << body_bits.size() << ")" << std::endl;
+    // bounds and head size of each encoded message, encrypted together once they are all encoded
+    const bool encrypt_any = !crypto_key_.empty();
+    std::vector<std::size_t> frame_offsets(1, bytes->size()), head_sizes;
+    if (encrypt_any)
+    {
+        frame_offsets.reserve(msgs.size() + 1);
+        head_sizes.reserve(msgs.size());
+    }
 
-        unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
-        if (!crypto_key_.empty() && !skip_crypto_ids_.count(dccl_id))
-            encrypt(&body_bytes, head_bytes);
+    Bitset head_bits, body_bits;
+    try
+    {
+        for (const google::protobuf::Message* msg : msgs)
+        {
+            const Descriptor* desc = msg->GetDescriptor();
+            std::map<const Descriptor*, TypeInfo>::iterator type_it = types.find(desc);
+            if (type_it == types.end())
+            {
+                TypeInfo type;
+                type.dccl_id = id(desc);
+                type.codec = manager_.find(desc);
+                type.encrypt = !crypto_key_.empty() && !skip_crypto_ids_.count(type.dccl_id);
+                type_it = types.insert(std::make_pair(desc, type)).first;
+            }
+            const TypeInfo& type = type_it->second;
+
+            head_bits.clear();
+            body_bits.clear();
+            encode_internal(*msg, false, head_bits, body_bits, type.dccl_id, type.codec);
+
+            const std::size_t offset = bytes->size();
+            const std::size_t head_byte_size = ceil_bits2bytes(head_bits.size());
+            const std::size_t body_byte_size = ceil_bits2bytes(body_bits.size());
+            bytes->resize(offset + head_byte_size + body_byte_size);
+            char* head = &(*bytes)[offset];
+            head_bits.to_byte_string(head, head_byte_size);
+            if (body_byte_size)
+                body_bits.to_byte_string(head + head_byte_size, body_byte_size);
+
+            if (encrypt_any)
+            {
+                frame_offsets.push_back(bytes->size());
+                // a message that isn't encrypted is treated as being all head
+                head_sizes.push_back(type.encrypt ? head_byte_size
+                                                  : head_byte_size + body_byte_size);
+            }
 
-        dlog.is(logger::DEBUG3, logger::ENCODE) &&
-            dlog << "Encrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
+            if (offsets)
+                offsets->push_back(offset);
+
+            dlog.is(DEBUG1, ENCODE) && dlog << "Successfully encoded message of type: "
+                                            << desc->full_name() << std::endl;
+        }
+    }
+    catch (...)
+    {
+        // leave the messages already encoded as encode() would
+        if (!head_sizes.empty())
+            crypt_frames(&(*bytes)[0], frame_offsets, head_sizes, num_threads);
+        throw;
     }
 
-    dlog.is(DEBUG1, ENCODE) && dlog << "Successfully encoded message of type: " << desc->full_name()
-                                    << std::endl;
-    *bytes += head_bytes + body_bytes;
+    if (!head_sizes.empty())
+        crypt_frames(&(*bytes)[0], frame_offsets, head_sizes, num_threads);
+
+    if (offsets)
+        offsets->push_back(bytes->size());
+}
+
+void dccl::Codec::encrypt_frames(std::string* bytes, const std::vector<std::size_t>& offsets,
+                                 unsigned num_threads /* = 1 */) const
+{
+    if (crypto_key_.empty() || offsets.size() < 2)
+        return;
+
+    if (offsets.back() > bytes->size())
+        throw(Exception("Message offsets extend past the end of the bytes passed"));
+
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    std::vector<std::size_t> head_sizes;
+    head_sizes.reserve(offsets.size() - 1);
+    for (std::size_t i = 0, n = offsets.size() - 1; i < n; ++i)
+    {
+        if (offsets[i + 1] < offsets[i])
+            throw(Exception("Message offsets must be in increasing order"));
+
+        const std::size_t frame_size = offsets[i + 1] - offsets[i];
+        const unsigned dccl_id =
+            id(bytes->begin() + offsets[i], bytes->begin() + offsets[i + 1]);
+        if (skip_crypto_ids_.count(dccl_id))
+        {
+            head_sizes.push_back(frame_size);
+            continue;
+        }
+
+        std::map<int32, const Descriptor*>::const_iterator desc_it = id2desc_.find(dccl_id);
+        if (desc_it == id2desc_.end())
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(dccl_id) +
+                            " has not been loaded. Call load() before encrypting this type."));
+
+        const std::size_t head_size = encoded_head_size(dccl_id, desc_it->second);
+        if (head_size > frame_size)
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(dccl_id) +
+                            " is shorter than its head"));
+        head_sizes.push_back(head_size);
+    }
+
+    crypt_frames(&(*bytes)[0], offsets, head_sizes, num_threads);
+}
+
+void dccl::Codec::decrypt_frames(std::string* bytes, const std::vector<std::size_t>& offsets,
+                                 unsigned num_threads /* = 1 */) const
+{
+    // CTR mode decryption is the same operation as encryption, and the heads are not encrypted
+    encrypt_frames(bytes, offsets, num_threads);
+}
+
+void dccl::Codec::crypt_frames(char* bytes, const std::vector<std::size_t>& offsets,
+                               const std::vector<std::size_t>& head_sizes,
+                               unsigned num_threads) const
+{
+    // frames are handed out in chunks to limit contention, and a thread is only worth starting
+    // for several chunks (each frame costs around a microsecond)
+    const std::size_t chunk_size = 64;
+    const std::size_t min_frames_per_thread = 4 * chunk_size;
+
+    const std::size_t num_frames = head_sizes.size();
+    num_threads = std::max<std::size_t>(
+        1, std::min<std::size_t>(num_threads, num_frames / min_frames_per_thread));
+
+    std::atomic<std::size_t> next(0);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto crypt_next = [&]()
+    {
+        // one cipher for all the frames done by this thread
+        CipherPool::Lease cipher(*ciphers_, crypto_key_);
+        for (std::size_t begin = next.fetch_add(chunk_size); begin < num_frames;
+             begin = next.fetch_add(chunk_size))
+        {
+            try
+            {
+                for (std::size_t i = begin, end = std::min(begin + chunk_size, num_frames);
+                     i < end; ++i)
+                {
+                    char* head = bytes + offsets[i];
+                    cipher.process(head + head_sizes[i],
+                                   offsets[i + 1] - offsets[i] - head_sizes[i], head,
+                                   head_sizes[i]);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                // stop the other threads
+                next = num_frames;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t) threads.emplace_back(crypt_next);
+    crypt_next();
+    for (std::thread& thread : threads) thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+std::size_t dccl::Codec::encoded_head_size(unsigned dccl_id, const Descriptor* desc) const
+{
+    const boost::shared_ptr<FieldCodecBase>& codec = manager_.find(desc);
+    if (!codec)
+        throw(Exception("Failed to find (dccl.msg).codec `" +
+                        desc->options().GetExtension(dccl::msg).codec() + "`"));
+
+    unsigned head_bits = 0;
+    codec->base_max_size(&head_bits, desc, HEAD);
+    unsigned id_bits = 0;
+    id_codec()->field_size(&id_bits, dccl_id, 0);
+    return ceil_bits2bytes(id_bits + head_bits);
+}
+
+void dccl::Codec::scan_frames(const std::string& bytes, std::vector<std::size_t>* offsets)
+{
+    scan_frames(bytes, offsets,
+                static_cast<std::vector<boost::shared_ptr<google::protobuf::Message>>*>(0), 0);
+}
+
+std::size_t dccl::Codec::fixed_frame_size(unsigned dccl_id, const Descriptor* desc) const
+{
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    boost::shared_ptr<FieldCodecBase> codec = manager_.find(desc);
+    if (!codec)
+        return 0;
+
+    unsigned head_min_bits, head_max_bits, body_min_bits, body_max_bits;
+    codec->base_min_size(&head_min_bits, desc, HEAD);
+    codec->base_max_size(&head_max_bits, desc, HEAD);
+    codec->base_min_size(&body_min_bits, desc, BODY);
+    codec->base_max_size(&body_max_bits, desc, BODY);
+    if (head_min_bits != head_max_bits || body_min_bits != body_max_bits)
+        return 0;
+
+    unsigned id_bits = 0;
+    id_codec()->field_size(&id_bits, dccl_id, 0);
+
+    // the head and body are each padded to a whole number of bytes
+    return ceil_bits2bytes(id_bits + head_max_bits) + ceil_bits2bytes(body_max_bits);
+}
+
+void dccl::Codec::decode_frames(const std::string& bytes, const std::vector<std::size_t>& offsets,
+                                const std::vector<google::protobuf::Message*>& msgs,
+                                unsigned num_threads)
+{
+    std::atomic<std::size_t> next(0);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto decode_next = [&]()
+    {
+        for (std::size_t i = next++; i < msgs.size(); i = next++)
+        {
+            if (!msgs[i])
+                continue;
+            try
+            {
+                decode(bytes.begin() + offsets[i], bytes.begin() + offsets[i + 1], msgs[i]);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                // stop the other threads
+                next = msgs.size();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t) threads.emplace_back(decode_next);
+    decode_next();
+    for (std::thread& thread : threads) thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
 }
 
 unsigned dccl::Codec::id(const std::string& bytes) const { return id(bytes.begin(), bytes.end()); }
 
 void dccl::Codec::decode(std::string* bytes, google::protobuf::Message* msg)
 {
-    decode(*bytes, msg);
-    unsigned last_size = size(*msg);
-    bytes->erase(0, last_size);
+    bytes->erase(0, decode_front(*bytes, msg));
+}
+
+std::size_t dccl::Codec::decode_front(const std::string& bytes, google::protobuf::Message* msg,
+                                      bool header_only /* = false */)
+{
+    return decode(bytes.begin(), bytes.end(), msg, header_only) - bytes.begin();
 }
 
 void dccl::Codec::decode(const std::string& bytes, google::protobuf::Message* msg,
@@ -381,6 +867,7 @@ void dccl::Codec::decode(const std::string& bytes, google::protobuf::Message* ms
 // checks all bounds on the message
 void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /* = -1 */)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     try
     {
         if (user_id < 0 && !desc->options().GetExtension(dccl::msg).has_id())
@@ -399,7 +886,11 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /*
                             "message definition for " +
                             desc->full_name() + " to use the default DCCL4 codecs."));
 
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+        // a newly loaded Descriptor may reuse the address of one previously unloaded
+        internal::CacheGeneration::increment();
+        internal::FieldOptionsCache::add(desc);
+
+        boost::shared_ptr<FieldCodecBase> codec = manager_.find(desc);
 
         unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
         unsigned head_size_bits, body_size_bits;
@@ -453,6 +944,7 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /*
 
 void dccl::Codec::unload(const google::protobuf::Descriptor* desc)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     unsigned int erased = 0;
     for (std::map<int32, const google::protobuf::Descriptor*>::iterator it = id2desc_.begin();
          it != id2desc_.end();)
@@ -472,12 +964,20 @@ void dccl::Codec::unload(const google::protobuf::Descriptor* desc)
         dlog.is(DEBUG1) && dlog << "Message " << desc->full_name()
                                 << ": is not loaded. Ignoring unload request." << std::endl;
     }
+    else
+    {
+        internal::FieldOptionsCache::remove(desc);
+        internal::CacheGeneration::increment();
+    }
 }
 
 void dccl::Codec::unload(size_t dccl_id)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     if (id2desc_.count(dccl_id))
     {
+        internal::FieldOptionsCache::remove(id2desc_[dccl_id]);
+        internal::CacheGeneration::increment();
         id2desc_.erase(dccl_id);
     }
     else
@@ -490,9 +990,12 @@ void dccl::Codec::unload(size_t dccl_id)
 
 unsigned dccl::Codec::size(const google::protobuf::Message& msg, int user_id /* = -1 */)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    // the message is not modified, so each dynamic condition need only be evaluated once
+    DynamicConditions::MemoizeScope memoize_conditions;
     const Descriptor* desc = msg.GetDescriptor();
 
-    boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+    const boost::shared_ptr<FieldCodecBase>& codec = manager_.find(desc);
 
     unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
     unsigned head_size_bits;
@@ -512,7 +1015,8 @@ unsigned dccl::Codec::size(const google::protobuf::Message& msg, int user_id /*
 
 unsigned dccl::Codec::max_size(const google::protobuf::Descriptor* desc) const
 {
-    boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    const boost::shared_ptr<FieldCodecBase>& codec = manager_.find(desc);
 
     unsigned head_size_bits;
     codec->base_max_size(&head_size_bits, desc, HEAD);
@@ -531,7 +1035,8 @@ unsigned dccl::Codec::max_size(const google::protobuf::Descriptor* desc) const
 
 unsigned dccl::Codec::min_size(const google::protobuf::Descriptor* desc) const
 {
-    boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
+    const boost::shared_ptr<FieldCodecBase>& codec = manager_.find(desc);
 
     unsigned head_size_bits;
     codec->base_min_size(&head_size_bits, desc, HEAD);
@@ -551,13 +1056,14 @@ unsigned dccl::Codec::min_size(const google::protobuf::Descriptor* desc) const
 void dccl::Codec::info(const google::protobuf::Descriptor* desc, std::ostream* param_os /*= 0 */,
                        int user_id /* = -1 */) const
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     std::ostream* os = (param_os) ? param_os : &dlog;
 
     if (param_os || dlog.is(INFO))
     {
         try
         {
-            boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+            boost::shared_ptr<FieldCodecBase> codec = manager_.find(desc);
 
             unsigned config_head_bit_size, body_bit_size;
             codec->base_max_size(&config_head_bit_size, desc, HEAD);
@@ -632,45 +1138,17 @@ void dccl::Codec::info(const google::protobuf::Descriptor* desc, std::ostream* p
     }
 }
 
-void dccl::Codec::encrypt(std::string* s, const std::string& nonce /* message head */)
+void dccl::Codec::encrypt(char* s, std::size_t size, const char* nonce /* message head */,
+                          std::size_t nonce_size) const
 {
-#if DCCL_HAS_CRYPTOPP
-    using namespace CryptoPP;
-
-    std::string iv;
-    SHA256 hash;
-    StringSource unused(nonce, true, new HashFilter(hash, new StringSink(iv)));
-
-    CTR_Mode<AES>::Encryption encryptor;
-    encryptor.SetKeyWithIV((byte*)crypto_key_.c_str(), crypto_key_.size(), (byte*)iv.c_str());
-
-    std::string cipher;
-    StreamTransformationFilter in(encryptor, new StringSink(cipher));
-    in.Put((byte*)s->c_str(), s->size());
-    in.MessageEnd();
-    *s = cipher;
-#endif
+    CipherPool::Lease(*ciphers_, crypto_key_).process(s, size, nonce, nonce_size);
 }
 
-void dccl::Codec::decrypt(std::string* s, const std::string& nonce)
+void dccl::Codec::decrypt(char* s, std::size_t size, const char* nonce,
+                          std::size_t nonce_size) const
 {
-#if DCCL_HAS_CRYPTOPP
-    using namespace CryptoPP;
-
-    std::string iv;
-    SHA256 hash;
-    StringSource unused(nonce, true, new HashFilter(hash, new StringSink(iv)));
-
-    CTR_Mode<AES>::Decryption decryptor;
-    decryptor.SetKeyWithIV((byte*)crypto_key_.c_str(), crypto_key_.size(), (byte*)iv.c_str());
-
-    std::string recovered;
-
-    StreamTransformationFilter out(decryptor, new StringSink(recovered));
-    out.Put((byte*)s->c_str(), s->size());
-    out.MessageEnd();
-    *s = recovered;
-#endif
+    // CTR mode decryption is the same operation as encryption
+    encrypt(s, size, nonce, nonce_size);
 }
 
 void dccl::Codec::load_library(const std::string& library_path)
@@ -683,6 +1161,7 @@ void dccl::Codec::load_library(const std::string& library_path)
 
 void dccl::Codec::load_library(void* dl_handle)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     if (!dl_handle)
         throw(Exception("Null shared library handle passed to load_library"));
 
@@ -695,6 +1174,7 @@ void dccl::Codec::load_library(void* dl_handle)
 
 void dccl::Codec::unload_library(void* dl_handle)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     if (!dl_handle)
         throw(Exception("Null shared library handle passed to unload_library"));
 
@@ -709,8 +1189,8 @@ void dccl::Codec::set_crypto_passphrase(
     const std::string& passphrase,
     const std::set<unsigned>& do_not_encrypt_ids_ /*= std::set<unsigned>()*/)
 {
-    if (!crypto_key_.empty())
-        crypto_key_.clear();
+    ciphers_->clear();
+    wipe_key(&crypto_key_);
     skip_crypto_ids_.clear();
 
 #if DCCL_HAS_CRYPTOPP
@@ -731,6 +1211,7 @@ void dccl::Codec::set_crypto_passphrase(
 
 void dccl::Codec::info_all(std::ostream* param_os /*= 0 */) const
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     std::ostream* os = (param_os) ? param_os : &dlog;
 
     if (param_os || dlog.is(INFO))
@@ -25,6 +25,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <stdexcept>
 #include <vector>
@@ -50,8 +51,26 @@
 namespace dccl
 {
     class FieldCodec;
-  
+
+    /// \brief Sizes of an encoded DCCL message, see Codec::try_encode()
+    struct EncodedSize
+    {
+        /// \brief Size of the head (including the DCCL id) in bits, before padding to a whole number of bytes
+        unsigned head_bits;
+        /// \brief Size of the body in bits, before padding to a whole number of bytes
+        unsigned body_bits;
+        /// \brief Size of the head in bytes
+        std::size_t head_bytes;
+        /// \brief Size of the body in bytes
+        std::size_t body_bytes;
+
+        /// \brief Total size of the encoded message in bytes
+        std::size_t bytes() const { return head_bytes + body_bytes; }
+    };
+
     /// \brief The Dynamic CCL enCODer/DECoder. This is the main class you will use to load, encode and decode DCCL messages. Many users will not need any other DCCL classes than this one.
+    ///
+    /// The state of an encode, decode or size call is kept per thread, so different threads can encode and decode at the same time (with separate Codec objects, or with one shared Codec as long as no thread is loading or unloading messages in it). Construct the Codec objects and add any custom field codecs (manager(), FieldCodecManager::add, load_library) before starting the threads that use them. dlog may stay connected while the threads run: their log messages are written one at a time.
     /// \ingroup dccl_api
     class Codec
     {
@@ -72,6 +91,7 @@ namespace dccl
         /// Codecs and messages must be loaded within the shared library using a C function
         /// (declared extern "C") called "dccl3_load" with the signature
         /// void dccl3_load(dccl::Codec* codec)
+        /// Codecs added there (using FieldCodecManager::add) are only used by this Codec (see manager()).
         void load_library(void* dl_handle);
 
         /// \brief Remove codecs and/or unload messages present in the given shared library handle
@@ -87,6 +107,13 @@ namespace dccl
         /// The library is opened and then load_library(void* dl_handle) is called. Any libraries
         /// loaded this way will be unloaded when Codec is destructed.
         void load_library(const std::string& library_path);
+
+        /// \brief The field codecs used only by this Codec. Codecs not found here are taken from FieldCodecManager::global(), which holds the default codecs.
+        ///
+        /// For example, `codec.manager().add<MyCodec>("my_codec")` makes "my_codec" available to the messages loaded by this Codec without affecting any other Codec.
+        FieldCodecManagerLocal& manager() { return manager_; }
+        /// \brief The field codecs used only by this Codec (const version)
+        const FieldCodecManagerLocal& manager() const { return manager_; }
         
         /// \brief All messages must be explicited loaded and validated (size checks, option extensions checks, etc.) before they can be encoded/decoded. Use this version of load() when the messages used are static (known at compile time).
         ///
@@ -140,6 +167,20 @@ namespace dccl
         void set_crypto_passphrase(const std::string& passphrase,
                                    const std::set<unsigned>& do_not_encrypt_ids_ = std::set<unsigned>());
 
+        /// \brief Encrypts, in place, the bodies of a buffer of back-to-back unencrypted DCCL messages (for example, from encode_batch() on a Codec without a passphrase), using the passphrase given to set_crypto_passphrase().
+        ///
+        /// The result is identical to encoding each message with encode() on this Codec. The message heads are hashed and the bodies encrypted by up to `num_threads` threads (including the calling thread), although small batches are done by the calling thread alone. Does nothing if no passphrase is set (or DCCL was compiled without Crypto++).
+        /// \param bytes Encoded messages, whose types must all be loaded
+        /// \param offsets Position in `bytes` of the start of each message, followed by the end of the last one (as provided by encode_batch() or scan_frames())
+        /// \param num_threads Maximum number of threads to encrypt with
+        /// \throw Exception if a message is not loaded or is shorter than its head
+        void encrypt_frames(std::string* bytes, const std::vector<std::size_t>& offsets, unsigned num_threads = 1) const;
+
+        /// \brief Decrypts, in place, the bodies of a buffer of back-to-back encrypted DCCL messages. This is the inverse of encrypt_frames(), and takes the same parameters.
+        ///
+        /// As the encrypted messages generally cannot be split until they are decoded, `offsets` would typically be from the encode_batch() call that produced them.
+        void decrypt_frames(std::string* bytes, const std::vector<std::size_t>& offsets, unsigned num_threads = 1) const;
+
         
         /// \brief Set "strict" mode where a dccl::OutOfRangeException will be thrown for encode if the value(s) provided are out of range
         ///
@@ -258,6 +299,19 @@ namespace dccl
         /// \return size of encoded message
         size_t encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only = false, int user_id = -1);
 
+        /// \brief Encodes a DCCL message if it fits in the given space (for example, a modem frame slot).
+        ///
+        /// Unlike calling size() before encode(), the message is only traversed once. If the (cached) minimum size of this message type is larger than `max_len`, this returns false without encoding; otherwise the encoding is abandoned as soon as it exceeds `max_len` bytes.
+        /// \param bytes Output buffer to store encoded msg
+        /// \param max_len Maximum size of output buffer
+        /// \param msg Message to encode (must already have been validated)
+        /// \param size If not null, set to the sizes of the encoded head and body when the message fits
+        /// \param user_id Custom user_speicified dccl id to identify a message, if user_id is not specified or <0, then the first
+        /// dccl id with the message descriptor corresponding to that of msg will be used
+        /// \throw Exception if message cannot be encoded.
+        /// \return true if the message was encoded in `bytes`, false if it does not fit in `max_len` bytes (in which case the contents of `bytes` are unspecified)
+        bool try_encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, EncodedSize* size = 0, int user_id = -1);
+
         /// \brief Decode a DCCL message when the type is known at compile time.
         ///
         /// \param begin Iterator to the first byte of encoded message to decode (must already have been validated)
@@ -284,6 +338,15 @@ namespace dccl
         /// \throw Exception if message cannot be decoded.
         void decode(std::string* bytes, google::protobuf::Message* msg);
 
+        /// \brief Decode the DCCL message at the front of a string of bytes when the type is known at compile time, returning how many bytes it used.
+        ///
+        /// \param bytes encoded message(s) to decode (must already have been validated)
+        /// \param msg Pointer to any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message). The decoded message will be written here.
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if message cannot be decoded.
+        /// \return Number of bytes used by the decoded message, i.e. the position in `bytes` of the next message (if any)
+        std::size_t decode_front(const std::string& bytes, google::protobuf::Message* msg, bool header_only = false);
+
         /// \brief An alterative form for decoding messages for message types <i>not</i> known at compile-time ("dynamic").
         ///
         /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
@@ -303,6 +366,73 @@ namespace dccl
         template<typename GoogleProtobufMessagePointer>
             GoogleProtobufMessagePointer decode(std::string* bytes);
 
+        /// \brief An alterative form for decoding the message at the front of a string of bytes for message types <i>not</i> known at compile-time ("dynamic"), also returning how many bytes it used.
+        ///
+        /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
+        /// \param bytes encoded message(s) to decode (must already have been validated)
+        /// \param bytes_used Set to the number of bytes used by the decoded message, i.e. the position in `bytes` of the next message (if any)
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if message cannot be decoded
+        /// \return pointer to decoded message (a google::protobuf::Message). You are responsible for deleting the memory used by this pointer, so we recommend using a smart pointer here (e.g. boost::shared_ptr or the C++11 equivalent).
+        template<typename GoogleProtobufMessagePointer>
+            GoogleProtobufMessagePointer decode_front(const std::string& bytes, std::size_t* bytes_used, bool header_only = false);
+
+        /// \brief Encodes a batch of DCCL messages back-to-back into one buffer. This is faster than calling encode() for each message as the work that only depends on the message type is done once per type and the working buffers are reused.
+        ///
+        /// \param bytes Pointer to byte string to append the encoded messages to
+        /// \param msgs Messages to encode (each must already have been validated)
+        /// \param offsets If not null, set to the position in `bytes` of the start of each encoded message, followed by the end of the last one (that is, msgs.size() + 1 values)
+        /// \param num_threads Maximum number of threads to encrypt the messages with (as encrypt_frames()), if a passphrase is set
+        /// \throw Exception if a message cannot be encoded. The messages before it are left in `bytes` (and `offsets`).
+        void encode_batch(std::string* bytes, const std::vector<const google::protobuf::Message*>& msgs, std::vector<std::size_t>* offsets = 0, unsigned num_threads = 1);
+
+        /// \brief Encodes a batch of DCCL messages of a type known at compile time back-to-back into one buffer.
+        ///
+        /// \tparam ProtobufMessage Any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message)
+        /// \param bytes Pointer to byte string to append the encoded messages to
+        /// \param msgs Messages to encode (each must already have been validated)
+        /// \param offsets If not null, set to the position in `bytes` of the start of each encoded message, followed by the end of the last one (that is, msgs.size() + 1 values)
+        /// \param num_threads Maximum number of threads to encrypt the messages with (as encrypt_frames()), if a passphrase is set
+        /// \throw Exception if a message cannot be encoded. The messages before it are left in `bytes` (and `offsets`).
+        template<typename ProtobufMessage>
+            void encode_batch(std::string* bytes, const std::vector<ProtobufMessage>& msgs, std::vector<std::size_t>* offsets = 0, unsigned num_threads = 1)
+        {
+            std::vector<const google::protobuf::Message*> msg_ptrs;
+            msg_ptrs.reserve(msgs.size());
+            for(typename std::vector<ProtobufMessage>::const_iterator it = msgs.begin(), end = msgs.end(); it != end; ++it)
+                msg_ptrs.push_back(&(*it));
+            encode_batch(bytes, msg_ptrs, offsets, num_threads);
+        }
+
+        /// \brief Decodes a buffer of back-to-back DCCL messages (for example, from encode_batch()) of any of the loaded types.
+        ///
+        /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
+        /// \param bytes Encoded messages to decode
+        /// \param msgs Pointer to vector to append the decoded messages to
+        /// \param offsets If not null, set to the position in `bytes` of the start of each decoded message, followed by the end of the last one
+        /// \throw Exception if a message cannot be decoded. The messages before it are left in `msgs` (and `offsets`).
+        template<typename GoogleProtobufMessagePointer>
+            void decode_batch(const std::string& bytes, std::vector<GoogleProtobufMessagePointer>* msgs, std::vector<std::size_t>* offsets = 0);
+
+        /// \brief Finds the boundaries of the messages in a buffer of back-to-back DCCL messages. The length of a message whose body has a fixed size is calculated from its identifier and the (cached) message sizes, whereas a message with a variable size body has to be decoded to find its end.
+        ///
+        /// \param bytes Encoded messages
+        /// \param offsets Set to the position in `bytes` of the start of each message, followed by the end of the last one
+        /// \throw Exception if a message is not loaded, is truncated or cannot be decoded
+        void scan_frames(const std::string& bytes, std::vector<std::size_t>* offsets);
+
+        /// \brief Decodes a buffer of back-to-back DCCL messages (as decode_batch()) using several threads.
+        ///
+        /// The buffer is first split into messages as by scan_frames(), which also decodes (in the calling thread) any messages with a variable size body. A message object is allocated for every message, and the rest are then decoded by `num_threads` threads (including the calling thread). The Codec must not be modified (e.g. by load()) while this runs.
+        /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
+        /// \param bytes Encoded messages to decode
+        /// \param msgs Pointer to vector to append the decoded messages to
+        /// \param num_threads Number of threads to decode with
+        /// \param offsets If not null, set to the position in `bytes` of the start of each decoded message, followed by the end of the last one
+        /// \throw Exception if a message cannot be decoded, in which case no messages are appended to `msgs`
+        template<typename GoogleProtobufMessagePointer>
+            void decode_parallel(const std::string& bytes, std::vector<GoogleProtobufMessagePointer>* msgs, unsigned num_threads, std::vector<std::size_t>* offsets = 0);
+
         /// \brief Provides the encoded size (in bytes) of msg. This is useful if you need to know the size of a message before encoding it (encoding it is generally much more expensive than calling this method)
         ///
         /// \param msg Google Protobuf message with DCCL extensions for which the encoded size is requested
@@ -359,17 +489,47 @@ namespace dccl
         Codec(const Codec&);
         Codec& operator= (const Codec&);
 
-        void encode_internal(const google::protobuf::Message& msg, bool header_only, Bitset& header_bits, Bitset& body_bits, int user_id);
+        // codec is the message codec for msg, if already known. If max_bytes is not zero, throws
+        // BitLimitException as soon as the encoded message is larger than max_bytes.
+        // Returns the size of the head in bits before it is padded to a whole number of bytes
+        unsigned encode_internal(const google::protobuf::Message& msg, bool header_only, Bitset& header_bits, Bitset& body_bits, int user_id,
+                                 boost::shared_ptr<FieldCodecBase> codec = boost::shared_ptr<FieldCodecBase>(),
+                                 std::size_t max_bytes = 0);
+
+        // writes the encoded (and padded) head and body into bytes, encrypting the body if required
+        size_t write_encoded(char* bytes, size_t max_len, const Bitset& head_bits, const Bitset& body_bits,
+                             bool header_only, unsigned dccl_id, const google::protobuf::Descriptor* desc);
+
+        // scan_frames(), also allocating and returning a message for each frame if msgs is not null
+        // (decoded[i] is true if msgs[i] was decoded to find its end)
+        template<typename GoogleProtobufMessagePointer>
+            void scan_frames(const std::string& bytes, std::vector<std::size_t>* offsets,
+                             std::vector<GoogleProtobufMessagePointer>* msgs, std::vector<bool>* decoded);
+
+        // size in bytes of every message of this type, or 0 if the size is variable
+        std::size_t fixed_frame_size(unsigned dccl_id, const google::protobuf::Descriptor* desc) const;
 
-        void encrypt(std::string* s, const std::string& nonce);
-        void decrypt(std::string* s, const std::string& nonce);
+        // decodes msgs[i] (if not null) from bytes [offsets[i], offsets[i+1]) using num_threads threads
+        void decode_frames(const std::string& bytes, const std::vector<std::size_t>& offsets,
+                           const std::vector<google::protobuf::Message*>& msgs, unsigned num_threads);
+
+        // encrypt / decrypt (AES-CTR) the `size` bytes at `s` in place, using the message head as nonce
+        void encrypt(char* s, std::size_t size, const char* nonce, std::size_t nonce_size) const;
+        void decrypt(char* s, std::size_t size, const char* nonce, std::size_t nonce_size) const;
+
+        // encrypts (or decrypts) in place the body of each frame [offsets[i], offsets[i + 1]) of `bytes`,
+        // which follows its head of head_sizes[i] bytes, using up to num_threads threads
+        void crypt_frames(char* bytes, const std::vector<std::size_t>& offsets,
+                          const std::vector<std::size_t>& head_sizes, unsigned num_threads) const;
+
+        // size in bytes of the (identifier and) head of messages of this type
+        std::size_t encoded_head_size(unsigned dccl_id, const google::protobuf::Descriptor* desc) const;
 
         void set_default_codecs();
 
-        boost::shared_ptr<FieldCodecBase> id_codec() const
+        const boost::shared_ptr<FieldCodecBase>& id_codec() const
         {
-            return FieldCodecManager::find(google::protobuf::FieldDescriptor::TYPE_UINT32,
-                                           id_codec_);
+            return manager_.find(google::protobuf::FieldDescriptor::TYPE_UINT32, id_codec_);
         }
 
         
@@ -377,6 +537,10 @@ namespace dccl
         // SHA256 hash of the crypto passphrase
         std::string crypto_key_;
 
+        // AES ciphers expanded from crypto_key_, not currently in use by any thread
+        struct CipherPool;
+        std::unique_ptr<CipherPool> ciphers_;
+
         // strict mode setting
         bool strict_;
 
@@ -392,6 +556,10 @@ namespace dccl
 
         std::vector<void *> dl_handles_;
 
+        // field codecs used only by this Codec (falling back to FieldCodecManager::global());
+        // mutable so that it can be made current in const methods
+        mutable FieldCodecManagerLocal manager_;
+
         std::string build_guard_for_console_output(std::string& base, char guard_char) const;
     };
 
@@ -417,18 +585,128 @@ GoogleProtobufMessagePointer dccl::Codec::decode(const std::string& bytes, bool
     return msg;
 }
 
+template<typename GoogleProtobufMessagePointer>
+void dccl::Codec::decode_batch(const std::string& bytes, std::vector<GoogleProtobufMessagePointer>* msgs, std::vector<std::size_t>* offsets /* = 0 */)
+{
+    if(offsets)
+        offsets->clear();
+
+    std::string::const_iterator begin = bytes.begin(), it = begin, end = bytes.end();
+    while(it != end)
+    {
+        unsigned this_id = id(it, end);
+
+        std::map<int32, const google::protobuf::Descriptor*>::const_iterator desc_it = id2desc_.find(this_id);
+        if(desc_it == id2desc_.end())
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
+
+        // ownership of this object goes to the caller of decode_batch()
+        GoogleProtobufMessagePointer msg =
+            dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(desc_it->second);
+
+        std::size_t offset = it - begin;
+        it = decode(it, end, &(*msg));
+
+        if(offsets)
+            offsets->push_back(offset);
+        msgs->push_back(msg);
+    }
+
+    if(offsets)
+        offsets->push_back(it - begin);
+}
+
+template<typename GoogleProtobufMessagePointer>
+void dccl::Codec::scan_frames(const std::string& bytes, std::vector<std::size_t>* offsets,
+                              std::vector<GoogleProtobufMessagePointer>* msgs, std::vector<bool>* decoded)
+{
+    offsets->clear();
+
+    // dccl id to fixed_frame_size()
+    std::map<unsigned, std::size_t> frame_sizes;
+
+    std::string::const_iterator begin = bytes.begin(), it = begin, end = bytes.end();
+    while(it != end)
+    {
+        unsigned this_id = id(it, end);
+
+        std::map<int32, const google::protobuf::Descriptor*>::const_iterator desc_it = id2desc_.find(this_id);
+        if(desc_it == id2desc_.end())
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
+
+        std::map<unsigned, std::size_t>::const_iterator size_it = frame_sizes.find(this_id);
+        if(size_it == frame_sizes.end())
+            size_it = frame_sizes.insert(std::make_pair(this_id, fixed_frame_size(this_id, desc_it->second))).first;
+        const std::size_t frame_size = size_it->second;
+
+        GoogleProtobufMessagePointer msg = GoogleProtobufMessagePointer();
+        if(msgs || !frame_size)
+            msg = dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(desc_it->second);
+
+        offsets->push_back(it - begin);
+        if(frame_size)
+        {
+            if(static_cast<std::size_t>(end - it) < frame_size)
+                throw(Exception("Message " + hex_encode(it, end) + " of type " + desc_it->second->full_name() + " is truncated: expected " + boost::lexical_cast<std::string>(frame_size) + " bytes"));
+            it += frame_size;
+        }
+        else
+        {
+            it = decode(it, end, &(*msg));
+        }
+
+        if(msgs)
+        {
+            msgs->push_back(msg);
+            decoded->push_back(!frame_size);
+        }
+    }
+
+    offsets->push_back(it - begin);
+}
+
+template<typename GoogleProtobufMessagePointer>
+void dccl::Codec::decode_parallel(const std::string& bytes, std::vector<GoogleProtobufMessagePointer>* msgs, unsigned num_threads, std::vector<std::size_t>* offsets /* = 0 */)
+{
+    std::vector<std::size_t> frame_offsets;
+    std::vector<GoogleProtobufMessagePointer> frame_msgs;
+    std::vector<bool> decoded;
+    scan_frames(bytes, &frame_offsets, &frame_msgs, &decoded);
+
+    // messages remaining to be decoded
+    std::vector<google::protobuf::Message*> pending(frame_msgs.size(), static_cast<google::protobuf::Message*>(0));
+    for(std::size_t i = 0, n = frame_msgs.size(); i < n; ++i)
+    {
+        if(!decoded[i])
+            pending[i] = &(*frame_msgs[i]);
+    }
+    decode_frames(bytes, frame_offsets, pending, num_threads);
+
+    msgs->insert(msgs->end(), frame_msgs.begin(), frame_msgs.end());
+    if(offsets)
+        offsets->swap(frame_offsets);
+}
+
 template<typename GoogleProtobufMessagePointer>
 GoogleProtobufMessagePointer dccl::Codec::decode(std::string* bytes)
 {
-    unsigned this_id = id(*bytes);
+    std::size_t bytes_used = 0;
+    GoogleProtobufMessagePointer msg = decode_front<GoogleProtobufMessagePointer>(*bytes, &bytes_used);
+    bytes->erase(0, bytes_used);
+    return msg;
+}
+
+template<typename GoogleProtobufMessagePointer>
+GoogleProtobufMessagePointer dccl::Codec::decode_front(const std::string& bytes, std::size_t* bytes_used, bool header_only /* = false */)
+{
+    unsigned this_id = id(bytes);
 
     if(!id2desc_.count(this_id))
         throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
-                    
+
     GoogleProtobufMessagePointer msg =
         dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(id2desc_.find(this_id)->second);
-    std::string::iterator new_begin = decode(bytes->begin(), bytes->end(), &(*msg));
-    bytes->erase(bytes->begin(), new_begin);
+    *bytes_used = decode_front(bytes, &(*msg), header_only);
     return msg;
 }
 
@@ -457,6 +735,7 @@ unsigned dccl::Codec::id(CharIterator begin, CharIterator end) const
 template <typename CharIterator>
 CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::protobuf::Message* msg, bool header_only /*= false*/)
 {
+    FieldCodecManagerLocal::ScopedCurrent scoped_manager(&manager_);
     try
     {
         unsigned this_id = id(begin, end);
@@ -470,8 +749,7 @@ CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::p
 
         dlog.is(logger::DEBUG1, logger::DECODE) && dlog  << "Type name: " << desc->full_name() << std::endl;
 
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-        boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(desc);
+        const boost::shared_ptr<FieldCodecBase>& codec = manager_.find(desc);
 
         CharIterator actual_end = end;
         if(codec)
@@ -493,19 +771,24 @@ CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::p
             CharIterator head_bytes_end = begin + head_size_bytes;
             dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (hex): " << hex_encode(begin, head_bytes_end) << std::endl;
 
-            Bitset head_bits;
-            head_bits.from_byte_stream(begin, head_bytes_end);
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (bin): " << head_bits << std::endl;
+            // contiguous copy of the head so that the field codecs can read it in place
+            std::string head_bytes(begin, head_bytes_end);
+            if(dlog.is(logger::DEBUG3, logger::DECODE))
+            {
+                Bitset head_bits;
+                head_bits.from_byte_string(head_bytes);
+                dlog  << "Unencrypted Head (bin): " << head_bits << std::endl;
+            }
 
-            // shift off ID bits
-            head_bits >>= id_size;
+            BitReader head_reader(head_bytes.data(), head_bytes.data() + head_bytes.size());
 
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head after ID bits removal (bin): " << head_bits << std::endl;
+            // skip over ID bits
+            head_reader.skip(id_size);
 
             internal::MessageStack msg_stack;
             msg_stack.push(msg->GetDescriptor());
 
-            codec->base_decode(&head_bits, msg, HEAD);
+            codec->base_decode(&head_reader, msg, HEAD);
             dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "after header decode, message is: " << *msg << std::endl;
 
 
@@ -516,29 +799,30 @@ CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::p
             }
             else
             {
-                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Encrypted Body (hex): " << hex_encode(head_bytes_end, end) << std::endl;
+                // the body cannot be longer than its maximum size, so there is no need to copy (and decrypt) any following bytes (e.g. other messages in the same buffer)
+                CharIterator body_bytes_end = end;
+                if(std::distance(head_bytes_end, end) > static_cast<long>(body_size_bytes))
+                    body_bytes_end = head_bytes_end + body_size_bytes;
+
+                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Encrypted Body (hex): " << hex_encode(head_bytes_end, body_bytes_end) << std::endl;
 
-                Bitset body_bits;
+                std::string body_bytes(head_bytes_end, body_bytes_end);
                 if(!crypto_key_.empty() && !skip_crypto_ids_.count(this_id))
+                    decrypt(&body_bytes[0], body_bytes.size(), head_bytes.data(), head_bytes.size());
+
+                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
+                if(dlog.is(logger::DEBUG3, logger::DECODE))
                 {
-                    std::string head_bytes(begin, head_bytes_end);
-                    std::string body_bytes(head_bytes_end, end);
-                    decrypt(&body_bytes, head_bytes);
-                    dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
-                    body_bits.from_byte_stream(body_bytes.begin(), body_bytes.end());
-                }
-                else
-                {
-                    dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(head_bytes_end, end) << std::endl;
-                    body_bits.from_byte_stream(head_bytes_end, end);
+                    Bitset body_bits;
+                    body_bits.from_byte_string(body_bytes);
+                    dlog  << "Unencrypted Body (bin): " << body_bits << std::endl;
                 }
 
-                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (bin): " << body_bits << std::endl;
-
-                codec->base_decode(&body_bits, msg, BODY);
+                BitReader body_reader(body_bytes.data(), body_bytes.data() + body_bytes.size());
+                codec->base_decode(&body_reader, msg, BODY);
                 dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "after header & body decode, message is: " << *msg << std::endl;
 
-                actual_end = end - body_bits.size()/BITS_IN_BYTE;
+                actual_end = body_bytes_end - body_reader.remaining()/BITS_IN_BYTE;
             }
         }
         else
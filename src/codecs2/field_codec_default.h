@@ -26,6 +26,9 @@
 
 #include <sys/time.h>
 
+#include <unordered_map>
+#include <vector>
+
 #include <boost/utility.hpp>
 #include <boost/type_traits.hpp>
 #include <boost/static_assert.hpp>
@@ -131,38 +134,31 @@ namespace dccl
               {
                   dccl::dlog.is(dccl::logger::DEBUG2, dccl::logger::ENCODE) && dlog << "Encode " << value << " with bounds: [" << min() << "," << max() << "]" << std::endl;
 
+                  const Scale& s = scale();
                   
                   // round first, before checking bounds
-                  WireType wire_value = dccl::round(value, precision());
+                  WireType wire_value = round_to_precision(value, s);
 
                   // check bounds
-                  if(wire_value < min() || wire_value > max())
+                  if(wire_value < s.min || wire_value > s.max)
                   {
                       // strict mode
                       if(this->strict())
                           throw(dccl::OutOfRangeException(std::string("Value exceeds min/max bounds for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
                       // non-strict (default): if out-of-bounds, send as zeros
                       else
-                          return Bitset(size());
+                          return Bitset(s.size);
                   }
           
-                  wire_value -= dccl::round((WireType)min(), precision());
-
-                  if (precision() < 0) {
-                      wire_value /= (WireType)std::pow(10.0, -precision());
-                  } else if (precision() > 0) {
-                      wire_value *= (WireType)std::pow(10.0, precision());
-                  }
-
-                  dccl::uint64 uint_value = boost::numeric_cast<dccl::uint64>(dccl::round(wire_value, 0));
+                  dccl::uint64 uint_value = boost::numeric_cast<dccl::uint64>(quantize(wire_value, s));
 
                   // "presence" value (0)
-                  if(!FieldCodecBase::use_required())
+                  if(!s.use_required)
                       uint_value += 1;
 	  
 
                   Bitset encoded;
-                  encoded.from(uint_value, size());
+                  encoded.from(uint_value, s.size);
                   return encoded;
               }
           
@@ -170,6 +166,7 @@ namespace dccl
               {
                   dccl::dlog.is(dccl::logger::DEBUG2, dccl::logger::DECODE) && dlog << "Decode with bounds: [" << min() << "," << max() << "]" << std::endl;
 
+                  const Scale& s = scale();
 
                   // The line below SHOULD BE:
                   // dccl::uint64 t = bits->to<dccl::uint64>();
@@ -177,39 +174,208 @@ namespace dccl
                   // See, e.g., http://gcc.gnu.org/bugzilla/show_bug.cgi?id=10959
                   dccl::uint64 uint_value = (bits->template to<dccl::uint64>)();
 
-                  if(!FieldCodecBase::use_required())
+                  if(!s.use_required)
                   {
                       if(!uint_value) throw NullValueException();
                       --uint_value;
                   }
 	  
+                  return dequantize(uint_value, s);
+              }
+
+              // bring size(const WireType&) into scope so callers can access it
+              using TypedFixedFieldCodec<WireType, FieldType>::size;
+
+              unsigned size()
+              {
+                  return scale().size;
+              }
+
+            protected:
+              /// \brief The size is cached unless min or max are set by dynamic_conditions (and so depend on the message). Subclasses whose min(), max() or precision() depend on anything but the field options must return false.
+              bool schema_only_size()
+              {
+                  DynamicConditions& dc = this->dynamic_conditions(this->this_field());
+                  return !(dc.has_min() || dc.has_max());
+              }
+
+              /// \brief True if repeated fields may be quantized in bulk by encode_repeated_values_to() and decode_repeated_values_from(), which give the same bits and values as calling encode() and decode() on each element (with the bounds from min(), max() and precision(), so these may be overridden). Subclasses that override encode() or decode() must return false.
+              virtual bool bulk_quantize()
+              { return true; }
+
+              // quantizes and packs the whole array in two passes: the first (rounding, bounds check and scaling)
+              // has no data dependent branches or calls so it can be vectorized by the compiler, the second handles
+              // out of range values exactly as encode() does before the results are packed together
+              bool encode_repeated_values_to(BitWriter* writer, const std::vector<WireType>& wire_values,
+                                             unsigned wire_vector_size)
+              {
+                  if(!use_bulk_path())
+                      return TypedFixedFieldCodec<WireType, FieldType>::encode_repeated_values_to(writer, wire_values, wire_vector_size);
+
+                  const Scale& s = scale();
+                  const std::size_t n = std::min<std::size_t>(wire_values.size(), wire_vector_size);
+
+                  std::vector<WireType> quantized(n);
+                  std::vector<unsigned char> in_range(n);
+                  for(std::size_t i = 0; i < n; ++i)
+                  {
+                      const WireType wire_value = round_to_precision(wire_values[i], s);
+                      in_range[i] = !(wire_value < s.min || wire_value > s.max);
+                      // out of range values are replaced by the offset (and not used) to avoid integer overflow
+                      quantized[i] = quantize(in_range[i] ? wire_value : s.offset, s);
+                  }
+
+                  // empty elements (past the end of wire_values) are left as zero
+                  std::vector<dccl::uint64> packed(wire_vector_size, 0);
+                  const dccl::uint64 presence = s.use_required ? 0 : 1;
+                  for(std::size_t i = 0; i < n; ++i)
+                  {
+                      if(in_range[i])
+                          packed[i] = boost::numeric_cast<dccl::uint64>(quantized[i]) + presence;
+                      else if(this->strict())
+                          throw(dccl::OutOfRangeException(std::string("Value exceeds min/max bounds for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+                  }
+
+                  writer->write_packed(packed.data(), packed.size(), s.size);
+                  return true;
+              }
+
+              bool decode_repeated_values_from(BitReader* reader, std::vector<WireType>* wire_values,
+                                               std::vector<bool>* decoded)
+              {
+                  if(!use_bulk_path())
+                      return TypedFixedFieldCodec<WireType, FieldType>::decode_repeated_values_from(reader, wire_values, decoded);
+
+                  const Scale& s = scale();
+                  const std::size_t n = wire_values->size();
+
+                  std::vector<dccl::uint64> packed(n);
+                  reader->read_packed(packed.data(), n, s.size);
+
+                  const dccl::uint64 presence = s.use_required ? 0 : 1;
+                  for(std::size_t i = 0; i < n; ++i)
+                  {
+                      // the presence value (0) is decoded as the offset and then discarded
+                      const bool present = packed[i] >= presence;
+                      (*wire_values)[i] = dequantize(present ? packed[i] - presence : 0, s);
+                      (*decoded)[i] = present;
+                  }
+                  return true;
+              }
+
+            private:
+              // the bulk path gives identical results to encode() / decode() but skips their per-value logging
+              bool use_bulk_path()
+              {
+                  return bulk_quantize() && !dccl::dlog.enabled(dccl::logger::DEBUG2) && scale().size <= 64;
+              }
+
+              /// \brief Values derived from min(), max() and precision() that are needed for every value encoded or decoded
+              struct Scale
+              {
+                  Scale() : valid(false) { }
+                  
+                  bool valid;
+                  // inputs (the derived values are recalculated if any of these change)
+                  double min;
+                  double max;
+                  double precision;
+                  bool use_required;
+                  
+                  // dccl::round(min, precision), subtracted before scaling
+                  WireType offset;
+                  // 10^|precision|, the wire value is multiplied by this (divided for negative precision)
+                  WireType scaling;
+                  // 10^precision, as used by dccl::round(value, precision)
+                  WireType round_scaling;
+                  unsigned size;
+              };
+
+              // dccl::round(value, precision), using the cached scaling
+              static WireType round_to_precision(WireType value, const Scale& s)
+              { return round_to_precision(value, s, boost::is_integral<WireType>()); }
+
+              static WireType round_to_precision(WireType value, const Scale& s, boost::false_type /* floating point */)
+              { return dccl::round(value*s.round_scaling)/s.round_scaling; }
+
+              static WireType round_to_precision(WireType value, const Scale& s, boost::true_type /* integer */)
+              {
+                  // integers with non-negative precision (the common case) need no rounding
+                  if(s.precision >= 0)
+                      return value;
+
+                  WireType remainder = value % s.scaling;
+                  value -= remainder;
+                  if(remainder >= s.scaling/2)
+                      value += s.scaling;
+                  return value;
+              }
+
+              // the part of encode() after the bounds check: remove the offset, scale by the precision and round
+              static WireType quantize(WireType wire_value, const Scale& s)
+              {
+                  wire_value -= s.offset;
+
+                  if (s.precision < 0) {
+                      wire_value /= s.scaling;
+                  } else if (s.precision > 0) {
+                      wire_value *= s.scaling;
+                  }
+
+                  return round_to_integer(wire_value, boost::is_integral<WireType>());
+              }
+
+              // the inverse of quantize(), for a value with the presence bit already removed
+              static WireType dequantize(dccl::uint64 uint_value, const Scale& s)
+              {
                   WireType wire_value = (WireType)uint_value;
 
-                  if (precision() < 0) {
-                      wire_value *= (WireType)std::pow(10.0, -precision());
-                  } else if (precision() > 0) {
-                      wire_value /= (WireType)std::pow(10.0, precision());
+                  if (s.precision < 0) {
+                      wire_value *= s.scaling;
+                  } else if (s.precision > 0) {
+                      wire_value /= s.scaling;
                   }
 
                   // round values again to properly handle cases where double precision
                   // leads to slightly off values (e.g. 2.099999999 instead of 2.1)
-                  wire_value = dccl::round(wire_value + dccl::round((WireType)min(), precision()),
-                                           precision());
-
-                  return wire_value;
+                  return round_to_precision(wire_value + s.offset, s);
               }
 
-              // bring size(const WireType&) into scope so callers can access it
-              using TypedFixedFieldCodec<WireType, FieldType>::size;
-
-              unsigned size()
+              // dccl::round(value, 0)
+              static WireType round_to_integer(WireType value, boost::false_type /* floating point */)
+              { return dccl::round(value); }
+              static WireType round_to_integer(WireType value, boost::true_type /* integer */)
+              { return value; }
+              
+              // the Scale for the current field, calculated once per field (and thread) unless the bounds change
+              // (for example, with dynamic conditions or a subclass that overrides min(), max() or precision())
+              const Scale& scale()
               {
+                  const double min = this->min(), max = this->max(), precision = this->precision();
+                  const bool use_required = this->use_required();
+
+                  static thread_local std::unordered_map<const google::protobuf::FieldDescriptor*, Scale> scales;
+                  Scale& s = scales[this->this_field()];
+                  if(s.valid && s.min == min && s.max == max && s.precision == precision && s.use_required == use_required)
+                      return s;
+
+                  s.min = min;
+                  s.max = max;
+                  s.precision = precision;
+                  s.use_required = use_required;
+                  
+                  s.offset = dccl::round((WireType)min, (int)precision);
+                  s.scaling = (WireType)std::pow(10.0, std::abs(precision));
+                  // (only used for floating point types)
+                  s.round_scaling = boost::is_integral<WireType>::value ? 1 : std::pow(10.0, (int)precision);
+                  
                   // if not required field, leave one value for unspecified (always encoded as 0)
-                  unsigned NULL_VALUE = FieldCodecBase::use_required() ? 0 : 1;
-              
-                  return dccl::ceil_log2((max()-min())*std::pow(10.0, precision())+1 + NULL_VALUE);
+                  unsigned NULL_VALUE = use_required ? 0 : 1;
+                  s.size = dccl::ceil_log2((max-min)*std::pow(10.0, precision)+1 + NULL_VALUE);
+
+                  s.valid = true;
+                  return s;
               }
-            
             };
 
         /// \brief Provides a bool encoder. Uses 1 bit if field is `required`, 2 bits if `optional`
@@ -223,6 +389,7 @@ namespace dccl
             bool decode(Bitset* bits);
             unsigned size();
             void validate();
+            bool schema_only_size() { return true; }
         };
         
         /// \brief Provides an variable length ASCII string encoder. Can encode strings up to 255 bytes by using a length byte preceeding the string.
@@ -239,6 +406,7 @@ namespace dccl
             unsigned max_size();
             unsigned min_size();
             void validate();
+            bool schema_only_size() { return true; }
           private:
             enum { MAX_STRING_LENGTH = 255 };
             
@@ -257,6 +425,7 @@ namespace dccl
             unsigned max_size();
             unsigned min_size();
             void validate();
+            bool schema_only_size() { return true; }
         };
 
         /// \brief Provides an enum encoder. This converts the enumeration to an integer (based on the enumeration <i>index</i> (<b>not</b> its <i>value</i>) and uses DefaultNumericFieldCodec to encode the integer.
@@ -367,6 +536,9 @@ namespace dccl
             
             unsigned size()
             { return 0; }
+
+            bool schema_only_size()
+            { return true; }
             
             void validate()
             {
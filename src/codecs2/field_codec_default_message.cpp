@@ -54,28 +54,21 @@ void dccl::v2::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
         
         google::protobuf::Message* msg = boost::any_cast<google::protobuf::Message* >(*wire_value);
         
-        const google::protobuf::Descriptor* desc = msg->GetDescriptor();
         const google::protobuf::Reflection* refl = msg->GetReflection();
+        boost::shared_ptr<const internal::MessagePlan> p = plan(msg->GetDescriptor());
         
-        for(int i = 0, n = desc->field_count(); i < n; ++i)
+        for(std::vector<internal::FieldPlan>::const_iterator it = p->fields.begin(),
+                end = p->fields.end(); it != end; ++it)
         {
-        
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-            if(!check_field(field_desc))
-                continue;
-
-            
-            boost::shared_ptr<FieldCodecBase> codec = find(field_desc);            
-            boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                internal::TypeHelper::find(field_desc);
+            const google::protobuf::FieldDescriptor* field_desc = it->field;
+            const boost::shared_ptr<FieldCodecBase>& codec = it->codec;
 
             if(field_desc->is_repeated())
             {   
                 std::vector<boost::any> wire_values;
                 if(field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
                 {
-                    for(unsigned j = 0, m = field_desc->options().GetExtension(dccl::field).max_repeat(); j < m; ++j)
+                    for(unsigned j = 0, m = internal::FieldOptionsCache::find(field_desc).max_repeat(); j < m; ++j)
                         wire_values.push_back(refl->AddMessage(msg, field_desc));
                     
                     codec->field_decode_repeated(bits, &wire_values, field_desc);
@@ -88,9 +81,7 @@ void dccl::v2::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 else
                 {
                     // for primitive types
-                    codec->field_decode_repeated(bits, &wire_values, field_desc);
-                    for(int j = 0, m = wire_values.size(); j < m; ++j)
-                        helper->add_value(field_desc, msg, wire_values[j]);
+                    codec->field_decode_repeated_into_message(bits, msg, field_desc);
                 }
             }
             else
@@ -106,8 +97,7 @@ void dccl::v2::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 else
                 {
                     // for primitive types
-                    codec->field_decode(bits, &wire_value, field_desc);
-                    helper->set_value(field_desc, msg, wire_value);
+                    codec->field_decode_into_message(bits, msg, field_desc);
                 }
             } 
         }
@@ -159,6 +149,27 @@ std::string dccl::v2::DefaultMessageCodec::info()
     return ss.str();
 }
 
+boost::shared_ptr<const dccl::internal::MessagePlan> dccl::v2::DefaultMessageCodec::plan(const google::protobuf::Descriptor* desc)
+{
+    auto build = [this, desc](internal::MessagePlan* plan)
+        {
+            for(int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+                if(!check_field(field_desc))
+                    continue;
+
+                internal::FieldPlan field_plan = { field_desc, find(field_desc),
+                                                   internal::TypeHelper::find(field_desc), -1 };
+                plan->fields.push_back(field_plan);
+            }
+        };
+    
+    return internal::MessagePlanCache::find(this, &FieldCodecManagerLocal::current(), desc,
+                                            root_descriptor(), part(),
+                                            internal::MessageStack::current_part(), build);
+}
+
 bool dccl::v2::DefaultMessageCodec::check_field(const google::protobuf::FieldDescriptor* field)
 {
     if(!field)
@@ -167,7 +178,7 @@ bool dccl::v2::DefaultMessageCodec::check_field(const google::protobuf::FieldDes
     }
     else
     {
-        dccl::DCCLFieldOptions dccl_field_options = field->options().GetExtension(dccl::field);
+        const dccl::DCCLFieldOptions& dccl_field_options = internal::FieldOptionsCache::find(field);
         if(dccl_field_options.omit()) // omit
         {
             return false;
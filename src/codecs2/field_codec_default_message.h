@@ -24,6 +24,7 @@
 
 #include "dccl/field_codec.h"
 #include "dccl/field_codec_manager.h"
+#include "dccl/internal/message_plan.h"
 
 #include "dccl/option_extensions.pb.h"
 
@@ -41,6 +42,8 @@ namespace dccl
             unsigned max_size();
             unsigned min_size();
             unsigned any_size(const boost::any& wire_value);
+            // the fields' codecs clear this for the message if their sizes cannot be cached
+            bool schema_only_size() { return true; }
 
 
             boost::shared_ptr<FieldCodecBase> find(const google::protobuf::FieldDescriptor* field_desc)
@@ -53,6 +56,9 @@ namespace dccl
             std::string info();
             bool check_field(const google::protobuf::FieldDescriptor* field);
 
+            // fields of desc that are encoded in the current part
+            boost::shared_ptr<const internal::MessagePlan> plan(const google::protobuf::Descriptor* desc);
+
             struct Size
             {
                 static void repeated(boost::shared_ptr<FieldCodecBase> codec,
@@ -70,6 +76,24 @@ namespace dccl
                     {
                         codec->field_size(return_value, field_value, field_desc);
                     }
+
+                // as single(), for a non-message field read directly from msg
+                static void single_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                              unsigned* return_value,
+                                              const google::protobuf::Message& msg,
+                                              const google::protobuf::FieldDescriptor* field_desc)
+                    {
+                        codec->field_size_from_message(return_value, msg, field_desc);
+                    }
+
+                // as repeated(), for a non-message field read directly from msg
+                static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                                unsigned* return_value,
+                                                const google::protobuf::Message& msg,
+                                                const google::protobuf::FieldDescriptor* field_desc)
+                    {
+                        codec->field_size_repeated_from_message(return_value, msg, field_desc);
+                    }
                 
             };
             
@@ -90,6 +114,22 @@ namespace dccl
                     {
                         codec->field_encode(return_value, field_value, field_desc);
                     }
+
+                static void single_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                              Bitset* return_value,
+                                              const google::protobuf::Message& msg,
+                                              const google::protobuf::FieldDescriptor* field_desc)
+                    {
+                        codec->field_encode_from_message(return_value, msg, field_desc);
+                    }
+
+                static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                                Bitset* return_value,
+                                                const google::protobuf::Message& msg,
+                                                const google::protobuf::FieldDescriptor* field_desc)
+                    {
+                        codec->field_encode_repeated_from_message(return_value, msg, field_desc);
+                    }
             };
 
             struct MaxSize
@@ -137,17 +177,10 @@ namespace dccl
             template<typename Action, typename ReturnType>
                 void traverse_descriptor(ReturnType* return_value)
             {
-                const google::protobuf::Descriptor* desc =
-                    FieldCodecBase::this_descriptor();
-                for(int i = 0, n = desc->field_count(); i < n; ++i)
-                {
-                    const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-                    
-                    if(!check_field(field_desc))
-                        continue;
-
-                    Action::field(find(field_desc), return_value, field_desc);                    
-                }
+                boost::shared_ptr<const internal::MessagePlan> p = plan(FieldCodecBase::this_descriptor());
+                for(std::vector<internal::FieldPlan>::const_iterator it = p->fields.begin(),
+                        end = p->fields.end(); it != end; ++it)
+                    Action::field(it->codec, return_value, it->field);
             }
             
 
@@ -159,31 +192,37 @@ namespace dccl
                     ReturnType return_value = ReturnType();
        
                     const google::protobuf::Message* msg = boost::any_cast<const google::protobuf::Message*>(wire_value);
-                    const google::protobuf::Descriptor* desc = msg->GetDescriptor();
                     const google::protobuf::Reflection* refl = msg->GetReflection();
-                    for(int i = 0, n = desc->field_count(); i < n; ++i)
+                    boost::shared_ptr<const internal::MessagePlan> p = plan(msg->GetDescriptor());
+                    for(std::vector<internal::FieldPlan>::const_iterator it = p->fields.begin(),
+                            end = p->fields.end(); it != end; ++it)
                     {       
-                        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-                        if(!check_field(field_desc))
-                            continue;
-           
-                        boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-                        boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                            internal::TypeHelper::find(field_desc);
+                        const google::protobuf::FieldDescriptor* field_desc = it->field;
+                        const boost::shared_ptr<FieldCodecBase>& codec = it->codec;
+                        const boost::shared_ptr<internal::FromProtoCppTypeBase>& helper = it->helper;
             
             
                         if(field_desc->is_repeated())
                         {
-                            std::vector<boost::any> field_values;
-                            for(int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
-                                field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
-                   
-                            Action::repeated(codec, &return_value, field_values, field_desc);
+                            if(field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                            {
+                                std::vector<boost::any> field_values;
+                                for(int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
+                                    field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
+
+                                Action::repeated(codec, &return_value, field_values, field_desc);
+                            }
+                            else
+                            {
+                                Action::repeated_in_message(codec, &return_value, *msg, field_desc);
+                            }
                         }
                         else
                         {
-                            Action::single(codec, &return_value, helper->get_value(field_desc, *msg), field_desc);
+                            if(field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                                Action::single(codec, &return_value, helper->get_value(field_desc, *msg), field_desc);
+                            else
+                                Action::single_in_message(codec, &return_value, *msg, field_desc);
                         }
                     }
                     return return_value;
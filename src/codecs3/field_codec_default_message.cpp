@@ -81,19 +81,13 @@ void dccl::v3::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
             }
         }
 
-        const google::protobuf::Descriptor* desc = msg->GetDescriptor();
         const google::protobuf::Reflection* refl = msg->GetReflection();
 
-        for (int i = 0, n = desc->field_count(); i < n; ++i)
+        boost::shared_ptr<const internal::MessagePlan> p = plan(msg->GetDescriptor());
+        for (const internal::FieldPlan& field_plan : p->fields)
         {
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-            if (!check_field(field_desc))
-                continue;
-
-            boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-            boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                internal::TypeHelper::find(field_desc);
+            const google::protobuf::FieldDescriptor* field_desc = field_plan.field;
+            const boost::shared_ptr<FieldCodecBase>& codec = field_plan.codec;
 
             if (field_desc->is_repeated())
             {
@@ -101,7 +95,7 @@ void dccl::v3::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 if (field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
                 {
                     unsigned max_repeat =
-                        field_desc->options().GetExtension(dccl::field).max_repeat();
+                        internal::FieldOptionsCache::find(field_desc).max_repeat();
                     for (unsigned j = 0, m = max_repeat; j < m; ++j)
                         field_values.push_back(refl->AddMessage(msg, field_desc));
 
@@ -114,9 +108,7 @@ void dccl::v3::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 else
                 {
                     // for primitive types
-                    codec->field_decode_repeated(bits, &field_values, field_desc);
-                    for (int j = 0, m = field_values.size(); j < m; ++j)
-                        helper->add_value(field_desc, msg, field_values[j]);
+                    codec->field_decode_repeated_into_message(bits, msg, field_desc);
                 }
             }
             else
@@ -143,8 +135,7 @@ void dccl::v3::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 else
                 {
                     // for primitive types
-                    codec->field_decode(bits, &field_value, field_desc);
-                    helper->set_value(field_desc, msg, field_value);
+                    codec->field_decode_into_message(bits, msg, field_desc);
                 }
             }
         }
@@ -209,6 +200,27 @@ std::string dccl::v3::DefaultMessageCodec::info()
     return ss.str();
 }
 
+boost::shared_ptr<const dccl::internal::MessagePlan>
+dccl::v3::DefaultMessageCodec::plan(const google::protobuf::Descriptor* desc)
+{
+    return internal::MessagePlanCache::find(
+        this, &FieldCodecManagerLocal::current(), desc, root_descriptor(), part(),
+        internal::MessageStack::current_part(),
+        [this, desc](internal::MessagePlan* plan)
+        {
+            for (int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+                if (!check_field(field_desc))
+                    continue;
+
+                internal::FieldPlan field_plan = {field_desc, find(field_desc),
+                                                  internal::TypeHelper::find(field_desc), -1};
+                plan->fields.push_back(field_plan);
+            }
+        });
+}
+
 bool dccl::v3::DefaultMessageCodec::check_field(const google::protobuf::FieldDescriptor* field)
 {
     if (!field)
@@ -217,7 +229,8 @@ bool dccl::v3::DefaultMessageCodec::check_field(const google::protobuf::FieldDes
     }
     else
     {
-        dccl::DCCLFieldOptions dccl_field_options = field->options().GetExtension(dccl::field);
+        const dccl::DCCLFieldOptions& dccl_field_options =
+            internal::FieldOptionsCache::find(field);
         if (dccl_field_options.omit()) // omit
         {
             return false;
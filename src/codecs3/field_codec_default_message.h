@@ -24,6 +24,7 @@
 
 #include "dccl/field_codec.h"
 #include "dccl/field_codec_manager.h"
+#include "dccl/internal/message_plan.h"
 
 #include "dccl/option_extensions.pb.h"
 
@@ -40,6 +41,8 @@ class DefaultMessageCodec : public FieldCodecBase
     unsigned max_size();
     unsigned min_size();
     unsigned any_size(const boost::any& wire_value);
+    // the fields' codecs clear this for the message if their sizes cannot be cached
+    bool schema_only_size() { return true; }
 
     boost::shared_ptr<FieldCodecBase> find(const google::protobuf::FieldDescriptor* field_desc)
     {
@@ -52,6 +55,9 @@ class DefaultMessageCodec : public FieldCodecBase
     std::string info();
     bool check_field(const google::protobuf::FieldDescriptor* field);
 
+    // fields of desc that are encoded in the current part
+    boost::shared_ptr<const internal::MessagePlan> plan(const google::protobuf::Descriptor* desc);
+
     struct Size
     {
         static void repeated(boost::shared_ptr<FieldCodecBase> codec, unsigned* return_value,
@@ -67,6 +73,23 @@ class DefaultMessageCodec : public FieldCodecBase
         {
             codec->field_size(return_value, field_value, field_desc);
         }
+
+        // as single(), for a non-message field read directly from msg
+        static void single_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                      unsigned* return_value, const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_size_from_message(return_value, msg, field_desc);
+        }
+
+        // as repeated(), for a non-message field read directly from msg
+        static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                        unsigned* return_value,
+                                        const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_size_repeated_from_message(return_value, msg, field_desc);
+        }
     };
 
     struct Encoder
@@ -84,6 +107,20 @@ class DefaultMessageCodec : public FieldCodecBase
         {
             codec->field_encode(return_value, field_value, field_desc);
         }
+
+        static void single_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                      Bitset* return_value, const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_encode_from_message(return_value, msg, field_desc);
+        }
+
+        static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                        Bitset* return_value, const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_encode_repeated_from_message(return_value, msg, field_desc);
+        }
     };
 
     struct MaxSize
@@ -132,17 +169,9 @@ class DefaultMessageCodec : public FieldCodecBase
     template <typename Action, typename ReturnType>
     void traverse_descriptor(ReturnType* return_value)
     {
-        const google::protobuf::Descriptor* desc = FieldCodecBase::this_descriptor();
-
-        for (int i = 0, n = desc->field_count(); i < n; ++i)
-        {
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-            if (!check_field(field_desc))
-                continue;
-
-            Action::field(find(field_desc), return_value, field_desc);
-        }
+        boost::shared_ptr<const internal::MessagePlan> p = plan(FieldCodecBase::this_descriptor());
+        for (const internal::FieldPlan& field_plan : p->fields)
+            Action::field(field_plan.codec, return_value, field_plan.field);
     }
 
     template <typename Action, typename ReturnType>
@@ -155,27 +184,31 @@ class DefaultMessageCodec : public FieldCodecBase
 
             const google::protobuf::Message* msg =
                 boost::any_cast<const google::protobuf::Message*>(wire_value);
-            const google::protobuf::Descriptor* desc = msg->GetDescriptor();
             const google::protobuf::Reflection* refl = msg->GetReflection();
 
-            for (int i = 0, n = desc->field_count(); i < n; ++i)
+            boost::shared_ptr<const internal::MessagePlan> p = plan(msg->GetDescriptor());
+            for (const internal::FieldPlan& field_plan : p->fields)
             {
-                const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-                if (!check_field(field_desc))
-                    continue;
-
-                boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-                boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                    internal::TypeHelper::find(field_desc);
+                const google::protobuf::FieldDescriptor* field_desc = field_plan.field;
+                const boost::shared_ptr<FieldCodecBase>& codec = field_plan.codec;
+                const boost::shared_ptr<internal::FromProtoCppTypeBase>& helper =
+                    field_plan.helper;
 
                 if (field_desc->is_repeated())
                 {
-                    std::vector<boost::any> field_values;
-                    for (int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
-                        field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
+                    if (field_desc->cpp_type() ==
+                        google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                    {
+                        std::vector<boost::any> field_values;
+                        for (int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
+                            field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
 
-                    Action::repeated(codec, &return_value, field_values, field_desc);
+                        Action::repeated(codec, &return_value, field_values, field_desc);
+                    }
+                    else
+                    {
+                        Action::repeated_in_message(codec, &return_value, *msg, field_desc);
+                    }
                 }
                 else
                 {
@@ -189,8 +222,12 @@ class DefaultMessageCodec : public FieldCodecBase
                             continue;
                     }
 
-                    Action::single(codec, &return_value, helper->get_value(field_desc, *msg),
-                                   field_desc);
+                    if (field_desc->cpp_type() ==
+                        google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                        Action::single(codec, &return_value, helper->get_value(field_desc, *msg),
+                                       field_desc);
+                    else
+                        Action::single_in_message(codec, &return_value, *msg, field_desc);
                 }
             }
             return return_value;
@@ -162,6 +162,12 @@ namespace dccl
                 }
             }
 
+            /// Sizes are cached if those of the "wrapped" codec are
+            virtual bool schema_only_size()
+            {
+                return FieldCodecBase::wrapped_schema_only_size(_inner_codec);
+            }
+
         };
     }
 }
@@ -44,6 +44,7 @@ namespace dccl
             unsigned max_size();
             unsigned min_size();
             void validate();
+            bool schema_only_size() { return true; }
         
         private:
             unsigned prefix_size()
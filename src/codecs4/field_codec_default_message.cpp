@@ -25,7 +25,34 @@
 
 using dccl::dlog;
 
-std::unordered_map<std::string, unsigned> dccl::v4::DefaultMessageCodec::MaxSize::oneofs_max_size;
+thread_local std::unordered_map<std::string, unsigned>
+    dccl::v4::DefaultMessageCodec::MaxSize::oneofs_max_size;
+
+namespace
+{
+// read the presence bit (already pulled as part of min_size()), returning its value
+bool read_presence(dccl::Bitset* bits)
+{
+    if (!bits->to_ulong())
+        return false;
+    bits->pop_front();
+    return true;
+}
+
+bool read_presence(dccl::BitReader* reader) { return reader->read(1); }
+
+unsigned long read_value(dccl::Bitset* bits, unsigned num_bits)
+{
+    dccl::Bitset value_bits(bits);
+    value_bits.get_more_bits(num_bits);
+    return value_bits.to_ulong();
+}
+
+unsigned long read_value(dccl::BitReader* reader, unsigned num_bits)
+{
+    return reader->read(num_bits);
+}
+} // namespace
 
 //
 // DefaultMessageCodec
@@ -46,6 +73,21 @@ void dccl::v4::DefaultMessageCodec::any_encode(Bitset* bits, const boost::any& w
     }
 }
 
+void dccl::v4::DefaultMessageCodec::any_encode_to(BitWriter* writer, const boost::any& wire_value)
+{
+    if (wire_value.empty())
+    {
+        writer->write_zeros(min_size());
+    }
+    else
+    {
+        if (is_optional())
+            writer->write(1, 1); // presence bit
+
+        traverse_const_message<CursorEncoder>(wire_value, writer);
+    }
+}
+
 unsigned dccl::v4::DefaultMessageCodec::any_size(const boost::any& wire_value)
 {
     if (wire_value.empty())
@@ -66,49 +108,46 @@ unsigned dccl::v4::DefaultMessageCodec::any_size(const boost::any& wire_value)
 }
 
 void dccl::v4::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_value)
+{
+    decode_message(bits, wire_value);
+}
+
+void dccl::v4::DefaultMessageCodec::any_decode_from(BitReader* reader, boost::any* wire_value)
+{
+    decode_message(reader, wire_value);
+}
+
+template <typename BitSource>
+void dccl::v4::DefaultMessageCodec::decode_message(BitSource* bits, boost::any* wire_value)
 {
     try
     {
         google::protobuf::Message* msg = boost::any_cast<google::protobuf::Message*>(*wire_value);
 
-        if (is_optional())
+        if (is_optional() && !read_presence(bits))
         {
-            if (!bits->to_ulong())
-            {
-                *wire_value = boost::any();
-                return;
-            }
-            else
-            {
-                bits->pop_front(); // presence bit
-            }
+            *wire_value = boost::any();
+            return;
         }
 
         const google::protobuf::Descriptor* desc = msg->GetDescriptor();
         const google::protobuf::Reflection* refl = msg->GetReflection();
+        boost::shared_ptr<const internal::MessagePlan> p = plan(desc);
 
         // First, process the oneof definitions, storing the case value...
         std::vector<int> oneof_cases(desc->oneof_decl_count());
-        for (auto i = 0, n = desc->oneof_decl_count(); part() != HEAD && i < n; ++i)
+        for (const google::protobuf::OneofDescriptor* oneof_desc : p->oneofs)
         {
-            Bitset case_bits(bits);
-            case_bits.get_more_bits(oneof_size(desc->oneof_decl(i)));
-
-            // Store the index of the field set for the i-th oneof (if unset, it will be -1)
-            oneof_cases[i] = static_cast<int>(case_bits.to_ulong()) - 1;
+            // Store the index of the field set for the oneof (if unset, it will be -1)
+            oneof_cases[oneof_desc->index()] =
+                static_cast<int>(read_value(bits, oneof_size(oneof_desc))) - 1;
         }
 
         // ... then, process the fields
-        for (int i = 0, n = desc->field_count(); i < n; ++i)
+        for (const internal::FieldPlan& field_plan : p->fields)
         {
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-            if (!check_field(field_desc))
-                continue;
-
-            boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-            boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                internal::TypeHelper::find(field_desc);
+            const google::protobuf::FieldDescriptor* field_desc = field_plan.field;
+            const boost::shared_ptr<FieldCodecBase>& codec = field_plan.codec;
 
             if (field_desc->is_repeated())
             {
@@ -116,7 +155,7 @@ void dccl::v4::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 if (field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
                 {
                     unsigned max_repeat =
-                        field_desc->options().GetExtension(dccl::field).max_repeat();
+                        internal::FieldOptionsCache::find(field_desc).max_repeat();
                     for (unsigned j = 0, m = max_repeat; j < m; ++j)
                         field_values.push_back(refl->AddMessage(msg, field_desc));
 
@@ -129,19 +168,16 @@ void dccl::v4::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 else
                 {
                     // for primitive types
-                    codec->field_decode_repeated(bits, &field_values, field_desc);
-                    for (int j = 0, m = field_values.size(); j < m; ++j)
-                        helper->add_value(field_desc, msg, field_values[j]);
+                    codec->field_decode_repeated_into_message(bits, msg, field_desc);
                 }
             }
             else
             {
-                if (is_part_of_oneof(field_desc))
+                if (field_plan.oneof_index >= 0)
                 {
                     // If the field belongs to a oneof and its index is the one stored for the containing
                     // oneof, decode it; otherwise, skip the field.
-                    if (field_desc->index_in_oneof() !=
-                        oneof_cases[containing_oneof_index(field_desc)])
+                    if (field_desc->index_in_oneof() != oneof_cases[field_plan.oneof_index])
                         continue;
                 }
 
@@ -167,8 +203,7 @@ void dccl::v4::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
                 else
                 {
                     // for primitive types
-                    codec->field_decode(bits, &field_value, field_desc);
-                    helper->set_value(field_desc, msg, field_value);
+                    codec->field_decode_into_message(bits, msg, field_desc);
                 }
             }
         }
@@ -227,6 +262,31 @@ std::string dccl::v4::DefaultMessageCodec::info()
     return ss.str();
 }
 
+boost::shared_ptr<const dccl::internal::MessagePlan>
+dccl::v4::DefaultMessageCodec::plan(const google::protobuf::Descriptor* desc)
+{
+    return internal::MessagePlanCache::find(
+        this, &FieldCodecManagerLocal::current(), desc, root_descriptor(), part(),
+        internal::MessageStack::current_part(),
+        [this, desc](internal::MessagePlan* plan)
+        {
+            for (int i = 0, n = desc->oneof_decl_count(); part() != HEAD && i < n; ++i)
+                plan->oneofs.push_back(desc->oneof_decl(i));
+
+            for (int i = 0, n = desc->field_count(); i < n; ++i)
+            {
+                const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+                if (!check_field(field_desc))
+                    continue;
+
+                internal::FieldPlan field_plan = {field_desc, find(field_desc),
+                                                  internal::TypeHelper::find(field_desc),
+                                                  containing_oneof_index(field_desc)};
+                plan->fields.push_back(field_plan);
+            }
+        });
+}
+
 bool dccl::v4::DefaultMessageCodec::check_field(const google::protobuf::FieldDescriptor* field)
 {
     if (!field)
@@ -235,7 +295,8 @@ bool dccl::v4::DefaultMessageCodec::check_field(const google::protobuf::FieldDes
     }
     else
     {
-        dccl::DCCLFieldOptions dccl_field_options = field->options().GetExtension(dccl::field);
+        const dccl::DCCLFieldOptions& dccl_field_options =
+            internal::FieldOptionsCache::find(field);
         if (dccl_field_options.omit()) // omit
         {
             return false;
@@ -26,6 +26,7 @@
 
 #include "dccl/field_codec.h"
 #include "dccl/field_codec_manager.h"
+#include "dccl/internal/message_plan.h"
 #include "dccl/oneof.h"
 
 #include "dccl/option_extensions.pb.h"
@@ -40,9 +41,15 @@ class DefaultMessageCodec : public FieldCodecBase
   private:
     void any_encode(Bitset* bits, const boost::any& wire_value);
     void any_decode(Bitset* bits, boost::any* wire_value);
+    void any_encode_to(BitWriter* writer, const boost::any& wire_value);
+    void any_decode_from(BitReader* reader, boost::any* wire_value);
+    // shared implementation of any_decode and any_decode_from
+    template <typename BitSource> void decode_message(BitSource* bits, boost::any* wire_value);
     unsigned max_size();
     unsigned min_size();
     unsigned any_size(const boost::any& wire_value);
+    // the fields' codecs clear this for the message if their sizes cannot be cached
+    bool schema_only_size() { return true; }
 
     boost::shared_ptr<FieldCodecBase> find(const google::protobuf::FieldDescriptor* field_desc)
     {
@@ -55,6 +62,9 @@ class DefaultMessageCodec : public FieldCodecBase
     std::string info();
     bool check_field(const google::protobuf::FieldDescriptor* field);
 
+    // fields and oneofs of desc that are encoded in the current part
+    boost::shared_ptr<const internal::MessagePlan> plan(const google::protobuf::Descriptor* desc);
+
     struct Size
     {
         static void repeated(boost::shared_ptr<FieldCodecBase> codec, unsigned* return_value,
@@ -79,6 +89,24 @@ class DefaultMessageCodec : public FieldCodecBase
             }
         }
 
+        // as single(), for a non-message field read directly from msg
+        static void single_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                      unsigned* return_value, const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+        {
+            if (!is_part_of_oneof(field_desc) || msg.GetReflection()->HasField(msg, field_desc))
+                codec->field_size_from_message(return_value, msg, field_desc);
+        }
+
+        // as repeated(), for a non-message field read directly from msg
+        static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                        unsigned* return_value,
+                                        const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_size_repeated_from_message(return_value, msg, field_desc);
+        }
+
         static void oneof(unsigned* return_value,
                           const google::protobuf::OneofDescriptor* oneof_desc,
                           const google::protobuf::Message&)
@@ -112,6 +140,21 @@ class DefaultMessageCodec : public FieldCodecBase
             }
         }
 
+        static void single_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                      Bitset* return_value, const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+        {
+            if (!is_part_of_oneof(field_desc) || msg.GetReflection()->HasField(msg, field_desc))
+                codec->field_encode_from_message(return_value, msg, field_desc);
+        }
+
+        static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec,
+                                        Bitset* return_value, const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_encode_repeated_from_message(return_value, msg, field_desc);
+        }
+
         static void oneof(Bitset* return_value, const google::protobuf::OneofDescriptor* oneof_desc,
                           const google::protobuf::Message& msg)
         {
@@ -131,10 +174,60 @@ class DefaultMessageCodec : public FieldCodecBase
         }
     };
 
+    // as Encoder, but writes directly to a BitWriter cursor
+    struct CursorEncoder
+    {
+        static void repeated(boost::shared_ptr<FieldCodecBase> codec, BitWriter* writer,
+                             const std::vector<boost::any>& field_values,
+                             const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_encode_repeated(writer, field_values, field_desc);
+        }
+
+        static void single(boost::shared_ptr<FieldCodecBase> codec, BitWriter* writer,
+                           const boost::any& field_value,
+                           const google::protobuf::FieldDescriptor* field_desc)
+        {
+            if (!is_part_of_oneof(field_desc) || !field_value.empty())
+                codec->field_encode(writer, field_value, field_desc);
+        }
+
+        static void single_in_message(boost::shared_ptr<FieldCodecBase> codec, BitWriter* writer,
+                                      const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field_desc)
+        {
+            if (!is_part_of_oneof(field_desc) || msg.GetReflection()->HasField(msg, field_desc))
+                codec->field_encode_from_message(writer, msg, field_desc);
+        }
+
+        static void repeated_in_message(boost::shared_ptr<FieldCodecBase> codec, BitWriter* writer,
+                                        const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field_desc)
+        {
+            codec->field_encode_repeated_from_message(writer, msg, field_desc);
+        }
+
+        static void oneof(BitWriter* writer, const google::protobuf::OneofDescriptor* oneof_desc,
+                          const google::protobuf::Message& msg)
+        {
+            unsigned case_ = 0;
+            auto refl = msg.GetReflection();
+            if (refl->HasOneof(msg, oneof_desc))
+                for (auto i = 0; i < oneof_desc->field_count(); ++i)
+                    if (refl->HasField(msg, oneof_desc->field(i)))
+                    {
+                        case_ = i + 1;
+                        break;
+                    }
+
+            writer->write(case_, oneof_size(oneof_desc));
+        }
+    };
+
     struct MaxSize
     {
         // Keeps track of the maximum size of each oneof
-        static std::unordered_map<std::string, unsigned> oneofs_max_size;
+        static thread_local std::unordered_map<std::string, unsigned> oneofs_max_size;
 
         static void field(boost::shared_ptr<FieldCodecBase> codec, unsigned* return_value,
                           const google::protobuf::FieldDescriptor* field_desc)
@@ -266,59 +359,60 @@ class DefaultMessageCodec : public FieldCodecBase
     template <typename Action, typename ReturnType>
     void traverse_descriptor(ReturnType* return_value)
     {
-        const google::protobuf::Descriptor* desc = FieldCodecBase::this_descriptor();
+        boost::shared_ptr<const internal::MessagePlan> p = plan(FieldCodecBase::this_descriptor());
 
         // First, process the oneof definitions...
-        for (auto i = 0, n = desc->oneof_decl_count(); part() != HEAD && i < n; ++i)
-            Action::oneof(return_value, desc->oneof_decl(i));
+        for (const google::protobuf::OneofDescriptor* oneof_desc : p->oneofs)
+            Action::oneof(return_value, oneof_desc);
 
         // ... then, process the fields
-        for (int i = 0, n = desc->field_count(); i < n; ++i)
-        {
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-            if (!check_field(field_desc))
-                continue;
-
-            Action::field(find(field_desc), return_value, field_desc);
-        }
+        for (const internal::FieldPlan& field_plan : p->fields)
+            Action::field(field_plan.codec, return_value, field_plan.field);
     }
 
     template <typename Action, typename ReturnType>
     ReturnType traverse_const_message(const boost::any& wire_value)
+    {
+        ReturnType return_value = ReturnType();
+        traverse_const_message<Action>(wire_value, &return_value);
+        return return_value;
+    }
+
+    template <typename Action, typename ReturnType>
+    void traverse_const_message(const boost::any& wire_value, ReturnType* return_value)
     {
         try
         {
-            ReturnType return_value = ReturnType();
-
             const google::protobuf::Message* msg =
                 boost::any_cast<const google::protobuf::Message*>(wire_value);
-            const google::protobuf::Descriptor* desc = msg->GetDescriptor();
             const google::protobuf::Reflection* refl = msg->GetReflection();
+            boost::shared_ptr<const internal::MessagePlan> p = plan(msg->GetDescriptor());
 
             // First, process the oneof definitions...
-            for (auto i = 0, n = desc->oneof_decl_count(); part() != HEAD && i < n; ++i)
-                Action::oneof(&return_value, desc->oneof_decl(i), *msg);
+            for (const google::protobuf::OneofDescriptor* oneof_desc : p->oneofs)
+                Action::oneof(return_value, oneof_desc, *msg);
 
             // ... then, process the fields
-            for (int i = 0, n = desc->field_count(); i < n; ++i)
+            for (const internal::FieldPlan& field_plan : p->fields)
             {
-                const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-                if (!check_field(field_desc))
-                    continue;
-
-                boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-                boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                    internal::TypeHelper::find(field_desc);
+                const google::protobuf::FieldDescriptor* field_desc = field_plan.field;
 
                 if (field_desc->is_repeated())
                 {
-                    std::vector<boost::any> field_values;
-                    for (int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
-                        field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
+                    if (field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                    {
+                        std::vector<boost::any> field_values;
+                        for (int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
+                            field_values.push_back(
+                                field_plan.helper->get_repeated_value(field_desc, *msg, j));
 
-                    Action::repeated(codec, &return_value, field_values, field_desc);
+                        Action::repeated(field_plan.codec, return_value, field_values, field_desc);
+                    }
+                    else
+                    {
+                        Action::repeated_in_message(field_plan.codec, return_value, *msg,
+                                                    field_desc);
+                    }
                 }
                 else
                 {
@@ -332,11 +426,14 @@ class DefaultMessageCodec : public FieldCodecBase
                             continue;
                     }
 
-                    Action::single(codec, &return_value, helper->get_value(field_desc, *msg),
-                                   field_desc);
+                    if (field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+                        Action::single(field_plan.codec, return_value,
+                                       field_plan.helper->get_value(field_desc, *msg), field_desc);
+                    else
+                        Action::single_in_message(field_plan.codec, return_value, *msg,
+                                                  field_desc);
                 }
             }
-            return return_value;
         }
         catch (boost::bad_any_cast& e)
         {
@@ -20,8 +20,14 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include "dccl/dynamic_conditions.h"
 #include "dccl/exception.h"
+#include "dccl/internal/cache_generation.h"
+#include "dccl/internal/field_options_cache.h"
 
 #if DCCL_HAS_LUA
 #include "dccl/thirdparty/sol/sol.hpp"
@@ -29,29 +35,315 @@
 LUALIB_API int luaopen_pb(lua_State* L);
 #define SOL_ALL_SAFETIES_ON 1
 #define SOL_PRINT_ERRORS 1
-#endif
 
-void build_file_desc_set(const google::protobuf::FileDescriptor* file_desc,
-                         google::protobuf::FileDescriptorSet& file_desc_set)
+namespace
+{
+// Lua userdata giving read-only access to a message (repeated_field == nullptr) or to one of its
+// repeated fields, read through reflection when indexed. Values are represented as lua-protobuf
+// pb.decode() would represent them (enumerations by name, submessages as (nested) tables, repeated
+// fields as arrays indexed from 1), so condition scripts see the message as they would a decoded
+// copy, but without serializing it.
+//
+// The message is only guaranteed to exist while the script that was given the view runs, so each
+// view records the generation of the Lua state it was created in, and the state's generation is
+// advanced after every script: a view kept by a script (e.g. "last = this") then raises an error
+// rather than reading a message that may have been destroyed.
+struct MessageView
+{
+    const google::protobuf::Message* msg;
+    const google::protobuf::FieldDescriptor* repeated_field;
+    lua_Integer generation;
+};
+
+const char* message_view_metatable = "dccl.MessageView";
+
+// registry key (by address) of the current view generation
+const char view_generation_key = 0;
+
+lua_Integer view_generation(lua_State* L)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &view_generation_key);
+    lua_Integer generation = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return generation;
+}
+
+void next_view_generation(lua_State* L)
 {
-    for (int i = 0, n = file_desc->dependency_count(); i < n; ++i)
-        build_file_desc_set(file_desc->dependency(i), file_desc_set);
+    lua_pushinteger(L, view_generation(L) + 1);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &view_generation_key);
+}
 
-    google::protobuf::FileDescriptorProto* file_desc_proto = file_desc_set.add_file();
-    file_desc->CopyTo(file_desc_proto);
+void push_message_view(lua_State* L, const google::protobuf::Message* msg,
+                       const google::protobuf::FieldDescriptor* repeated_field = nullptr)
+{
+    MessageView* view = static_cast<MessageView*>(lua_newuserdata(L, sizeof(MessageView)));
+    view->msg = msg;
+    view->repeated_field = repeated_field;
+    view->generation = view_generation(L);
+    luaL_setmetatable(L, message_view_metatable);
 }
 
+// returns the view at stack index arg, raising a Lua error if it is stale
+const MessageView* check_message_view(lua_State* L, int arg)
+{
+    const MessageView* view =
+        static_cast<const MessageView*>(luaL_checkudata(L, arg, message_view_metatable));
+    if (view->generation != view_generation(L))
+        luaL_error(L, "message view used after the condition script it was given to returned "
+                      "('this' and 'root' are only valid while the script runs)");
+    return view;
+}
+
+// pushes the value of field (or the index-th value, if repeated) of msg
+void push_field_value(lua_State* L, const google::protobuf::Message& msg,
+                      const google::protobuf::FieldDescriptor* field, int index)
+{
+    using google::protobuf::FieldDescriptor;
+    const google::protobuf::Reflection* refl = msg.GetReflection();
+    const bool repeated = field->is_repeated();
+    switch (field->cpp_type())
+    {
+        case FieldDescriptor::CPPTYPE_INT32:
+            lua_pushinteger(L, repeated ? refl->GetRepeatedInt32(msg, field, index)
+                                        : refl->GetInt32(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_INT64:
+            lua_pushinteger(L, repeated ? refl->GetRepeatedInt64(msg, field, index)
+                                        : refl->GetInt64(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            lua_pushinteger(L, repeated ? refl->GetRepeatedUInt32(msg, field, index)
+                                        : refl->GetUInt32(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT64:
+            lua_pushinteger(L, static_cast<lua_Integer>(
+                                   repeated ? refl->GetRepeatedUInt64(msg, field, index)
+                                            : refl->GetUInt64(msg, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            lua_pushnumber(L, repeated ? refl->GetRepeatedDouble(msg, field, index)
+                                       : refl->GetDouble(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            lua_pushnumber(L, repeated ? refl->GetRepeatedFloat(msg, field, index)
+                                       : refl->GetFloat(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            lua_pushboolean(L, repeated ? refl->GetRepeatedBool(msg, field, index)
+                                        : refl->GetBool(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_STRING:
+        {
+            const std::string value = repeated ? refl->GetRepeatedString(msg, field, index)
+                                               : refl->GetString(msg, field);
+            lua_pushlstring(L, value.data(), value.size());
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_ENUM:
+            lua_pushstring(L, (repeated ? refl->GetRepeatedEnum(msg, field, index)
+                                        : refl->GetEnum(msg, field))
+                                  ->name()
+                                  .c_str());
+            break;
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            if (repeated)
+                push_message_view(L, &refl->GetRepeatedMessage(msg, field, index));
+            else if (refl->HasField(msg, field))
+                push_message_view(L, &refl->GetMessage(msg, field));
+            else
+                lua_pushnil(L);
+            break;
+    }
+}
+
+// __index metamethod: view.field_name or view[index]
+int message_view_index(lua_State* L)
+{
+    const MessageView* view = check_message_view(L, 1);
+
+    if (view->repeated_field)
+    {
+        int is_integer = 0;
+        lua_Integer index = lua_tointegerx(L, 2, &is_integer);
+        if (is_integer && index >= 1 &&
+            index <= view->msg->GetReflection()->FieldSize(*view->msg, view->repeated_field))
+            push_field_value(L, *view->msg, view->repeated_field, static_cast<int>(index - 1));
+        else
+            lua_pushnil(L);
+    }
+    else
+    {
+        const char* name = lua_tostring(L, 2);
+        const google::protobuf::FieldDescriptor* field =
+            name ? view->msg->GetDescriptor()->FindFieldByName(name) : nullptr;
+        if (!field)
+            lua_pushnil(L);
+        else if (field->is_repeated())
+            push_message_view(L, view->msg, field);
+        else
+            push_field_value(L, *view->msg, field, -1);
+    }
+    return 1;
+}
+
+// __len metamethod: #view
+int message_view_len(lua_State* L)
+{
+    const MessageView* view = check_message_view(L, 1);
+    lua_pushinteger(L, view->repeated_field ? view->msg->GetReflection()->FieldSize(
+                                                  *view->msg, view->repeated_field)
+                                            : 0);
+    return 1;
+}
+
+// iterator function returned by __pairs: given the previous key, pushes the next key and value (or
+// nil when done). A repeated field is iterated as an array (index, value); a message by the fields
+// that are set, in declaration order (name, value), as pb.decode() would have filled a table
+int message_view_next(lua_State* L)
+{
+    const MessageView* view = check_message_view(L, 1);
+    const google::protobuf::Reflection* refl = view->msg->GetReflection();
+
+    if (view->repeated_field)
+    {
+        lua_Integer index = lua_isnoneornil(L, 2) ? 1 : luaL_checkinteger(L, 2) + 1;
+        if (index < 1 || index > refl->FieldSize(*view->msg, view->repeated_field))
+            return 0;
+        lua_pushinteger(L, index);
+        push_field_value(L, *view->msg, view->repeated_field, static_cast<int>(index - 1));
+        return 2;
+    }
+
+    const google::protobuf::Descriptor* desc = view->msg->GetDescriptor();
+    int field_index = 0;
+    if (!lua_isnoneornil(L, 2))
+    {
+        const google::protobuf::FieldDescriptor* previous =
+            desc->FindFieldByName(luaL_checkstring(L, 2));
+        if (!previous)
+            return luaL_error(L, "invalid key to 'next'");
+        field_index = previous->index() + 1;
+    }
+
+    for (; field_index < desc->field_count(); ++field_index)
+    {
+        const google::protobuf::FieldDescriptor* field = desc->field(field_index);
+        if (field->is_repeated() ? refl->FieldSize(*view->msg, field) > 0
+                                 : refl->HasField(*view->msg, field))
+        {
+            lua_pushstring(L, field->name().c_str());
+            if (field->is_repeated())
+                push_message_view(L, view->msg, field);
+            else
+                push_field_value(L, *view->msg, field, -1);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+// __pairs metamethod: pairs(view). The view is userdata, so next(view) cannot work as it would on
+// a decoded table; scripts must use pairs()
+int message_view_pairs(lua_State* L)
+{
+    check_message_view(L, 1);
+    lua_pushcfunction(L, message_view_next);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+} // namespace
+
+struct dccl::DynamicConditions::LuaState
+{
+    LuaState()
+    {
+        lua.open_libraries();
+        lua.require("pb", luaopen_pb);
+
+        lua_State* L = lua.lua_state();
+        luaL_newmetatable(L, message_view_metatable);
+        lua_pushcfunction(L, message_view_index);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, message_view_len);
+        lua_setfield(L, -2, "__len");
+        lua_pushcfunction(L, message_view_pairs);
+        lua_setfield(L, -2, "__pairs");
+        lua_pop(L, 1);
+    }
+
+    ~LuaState()
+    {
+        // the compiled functions refer to the Lua state
+        functions.clear();
+        // without this, we get a segfault in Ubuntu jammy
+        lua.script("pb.clear()");
+    }
+
+    // takes an idle state from the pool, or creates one if there are none
+    static LuaState* acquire()
+    {
+        Pool& p = pool();
+        {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            if (!p.idle.empty())
+            {
+                LuaState* state = p.idle.back();
+                p.idle.pop_back();
+                return state;
+            }
+        }
+        return new LuaState;
+    }
+
+    // returns a state to the pool, for use by another thread
+    static void release(LuaState* state)
+    {
+        Pool& p = pool();
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.idle.push_back(state);
+    }
+
+    sol::state lua;
+    // condition scripts compiled into Lua functions, by script
+    std::unordered_map<std::string, sol::protected_function> functions;
+
+  private:
+    // states not in use by any thread; a new thread (e.g. one started by Codec::decode_parallel)
+    // takes one of these, with the scripts already compiled, rather than starting a new one
+    struct Pool
+    {
+        ~Pool()
+        {
+            for (LuaState* state : idle) delete state;
+        }
+        std::mutex mutex;
+        std::vector<LuaState*> idle;
+    };
+
+    static Pool& pool()
+    {
+        // the thread_local DynamicConditions (which release their states here) of the main thread
+        // are destroyed before this
+        static Pool pool;
+        return pool;
+    }
+};
+#endif
+
+thread_local std::unordered_map<dccl::DynamicConditions::MemoKey, double,
+                                dccl::DynamicConditions::MemoKeyHash>
+    dccl::DynamicConditions::memo_;
+thread_local int dccl::DynamicConditions::memo_depth_ = 0;
+
 dccl::DynamicConditions::DynamicConditions() {}
 
 dccl::DynamicConditions::~DynamicConditions()
 {
 #if DCCL_HAS_LUA
     if (lua_)
-    {
-        // without this, we get a segfault in Ubuntu jammy
-        lua_->script("pb.clear()");
-        delete lua_;
-    }
+        LuaState::release(lua_);
 #endif
 }
 
@@ -65,73 +357,153 @@ void dccl::DynamicConditions::regenerate(const google::protobuf::Message* this_m
     root_msg_ = root_msg;
     if (!this_msg_)
         this_msg_ = root_msg_;
+}
 
-#if DCCL_HAS_LUA
-    if (this_msg_ && root_msg_)
+namespace
+{
+bool convert(const dccl::internal::ConditionExpression::Value& value, bool* result)
+{
+    *result = value.truthy();
+    return true;
+}
+
+bool convert(const dccl::internal::ConditionExpression::Value& value, double* result)
+{
+    // Lua would convert a numeric string
+    if (value.type != dccl::internal::ConditionExpression::Value::NUMBER)
+        return false;
+    *result = value.number;
+    return true;
+}
+} // namespace
+
+dccl::DynamicConditions::MemoizeScope::MemoizeScope()
+{
+    // the messages of any previous call may no longer exist
+    if (memo_depth_++ == 0)
+        memo_.clear();
+}
+
+dccl::DynamicConditions::MemoizeScope::~MemoizeScope() { --memo_depth_; }
+
+template <typename T> T dccl::DynamicConditions::evaluate(const std::string& script)
+{
+    if (memo_depth_ > 0)
     {
-        if (!lua_)
-        {
-            lua_ = new sol::state;
-            lua_->open_libraries();
-            lua_->require("pb", luaopen_pb);
-        }
+        const MemoKey key = {&script, this_msg_, root_msg_, index_};
+        std::unordered_map<MemoKey, double, MemoKeyHash>::const_iterator it = memo_.find(key);
+        if (it != memo_.end())
+            return static_cast<T>(it->second);
+
+        const T result = evaluate_script<T>(script);
+        memo_.insert(std::make_pair(key, static_cast<double>(result)));
+        return result;
+    }
+    return evaluate_script<T>(script);
+}
+
+template <typename T> T dccl::DynamicConditions::evaluate_script(const std::string& script)
+{
+    if (expressions_generation_ != internal::CacheGeneration::current())
+    {
+        expressions_.clear();
+        expressions_generation_ = internal::CacheGeneration::current();
+    }
 
-        sol::load_result desc_load = lua_->load(R"(local desc = ...; return pb.load(desc) )");
+    std::unordered_map<std::string, internal::ConditionExpression>::iterator it =
+        expressions_.find(script);
+    if (it == expressions_.end())
+        it = expressions_.insert(std::make_pair(script, internal::ConditionExpression(script)))
+                 .first;
 
-        google::protobuf::FileDescriptorSet file_desc_set;
-        build_file_desc_set(root_msg_->GetDescriptor()->file(), file_desc_set);
+    internal::ConditionExpression::Value value;
+    T result;
+    if (it->second.evaluate(this_msg_, root_msg_, index_, &value) && convert(value, &result))
+        return result;
 
-        std::tuple<bool, int> desc_load_result = desc_load(file_desc_set.SerializeAsString());
-        assert(std::get<0>(desc_load_result));
-        const auto& decode_script = R"(
-         local this_encoded_msg, this_type, root_encoded_msg, root_type, cpp_index = ...;
-         pb.option('use_default_metatable');
-         root = pb.decode(root_type, root_encoded_msg);
-         this = pb.decode(this_type, this_encoded_msg); this_index = cpp_index+1;
-         return this;
-        )";
+#if DCCL_HAS_LUA
+    return evaluate_lua<T>(script);
+#else
+    throw(Exception("DCCL built without Lua support: cannot evaluate dynamic_conditions script \"" +
+                    script + "\" (only simple expressions are supported without Lua)"));
+#endif
+}
 
-        sol::load_result decode_message = lua_->load(decode_script);
-        if (!decode_message.valid())
+#if DCCL_HAS_LUA
+template <typename T> T dccl::DynamicConditions::evaluate_lua(const std::string& script)
+{
+    if (!lua_)
+        lua_ = LuaState::acquire();
+
+    // the messages are only read as the script uses them, so this is cheap
+    lua_State* L = lua_->lua.lua_state();
+    // however the script ends, don't leave views of our messages reachable from the (pooled) state
+    struct ViewScope
+    {
+        ~ViewScope()
         {
-            sol::error err = decode_message;
-            throw(Exception(std::string("Failed to load condition script into the Lua program: ") +
-                            err.what()));
+            for (const char* name : {"root", "this", "this_index"})
+            {
+                lua_pushnil(L);
+                lua_setglobal(L, name);
+            }
+            next_view_generation(L);
         }
+        lua_State* L;
+    } view_scope{L};
 
-        auto index = index_;
+    push_message_view(L, root_msg_);
+    lua_setglobal(L, "root");
+    push_message_view(L, this_msg_);
+    lua_setglobal(L, "this");
+    lua_pushinteger(L, index_ + 1);
+    lua_setglobal(L, "this_index");
 
-        sol::table decoded_message = decode_message(
-            this_msg_->SerializePartialAsString(), this_msg_->GetDescriptor()->full_name(),
-            root_msg_->SerializePartialAsString(), root_msg_->GetDescriptor()->full_name(), index);
+    std::unordered_map<std::string, sol::protected_function>::iterator it =
+        lua_->functions.find(script);
+    if (it == lua_->functions.end())
+    {
+        sol::load_result loaded = lua_->lua.load(return_prefix(script));
+        if (!loaded.valid())
+        {
+            sol::error err = loaded;
+            throw(Exception("Failed to load condition script \"" + script +
+                            "\" into the Lua program: " + err.what()));
+        }
+        it = lua_->functions
+                 .insert(std::make_pair(script, loaded.get<sol::protected_function>()))
+                 .first;
     }
-#endif
+
+    sol::protected_function_result result = it->second();
+    if (!result.valid())
+    {
+        sol::error err = result;
+        throw(Exception("Failed to run condition script \"" + script + "\": " + err.what()));
+    }
+    return result.get<T>();
 }
+#endif
 
 const dccl::DCCLFieldOptions::Conditions& dccl::DynamicConditions::conditions()
 {
     if (field_desc_)
-        return field_desc_->options().GetExtension(dccl::field).dynamic_conditions();
+        return internal::FieldOptionsCache::find(field_desc_).dynamic_conditions();
     else
         throw(Exception("Null field_desc"));
 }
 
 bool dccl::DynamicConditions::required()
 {
-#if DCCL_HAS_LUA
     if (is_initialized())
     {
         if (conditions().has_required_if())
         {
-            auto condition_script = return_prefix(conditions().required_if());
-            bool required = lua_->script(condition_script);
-            return required;
+            return evaluate<bool>(conditions().required_if());
         }
         else if (conditions().has_only_if())
         {
-            auto condition_script = return_prefix(conditions().only_if());
-            bool only = lua_->script(condition_script);
-            return only;
+            return evaluate<bool>(conditions().only_if());
         }
         else
         {
@@ -142,28 +514,19 @@ bool dccl::DynamicConditions::required()
     {
         return false;
     }
-
-#else
-    throw(Exception("DCCL built without Lua support: cannot use dynamic_conditions"));
-#endif
 }
 
 bool dccl::DynamicConditions::omit()
 {
-#if DCCL_HAS_LUA
     if (is_initialized())
     {
         if (conditions().has_omit_if())
         {
-            auto condition_script = return_prefix(conditions().omit_if());
-            bool omit = lua_->script(condition_script);
-            return omit;
+            return evaluate<bool>(conditions().omit_if());
         }
         else if (conditions().has_only_if())
         {
-            auto condition_script = return_prefix(conditions().only_if());
-            bool only = lua_->script(condition_script);
-            return !only;
+            return !evaluate<bool>(conditions().only_if());
         }
         else
         {
@@ -174,43 +537,28 @@ bool dccl::DynamicConditions::omit()
     {
         return false;
     }
-#else
-    throw(Exception("DCCL built without Lua support: cannot use dynamic_conditions"));
-#endif
 }
 
 double dccl::DynamicConditions::min()
 {
-#if DCCL_HAS_LUA
     if (is_initialized())
     {
-        auto condition_script = return_prefix(conditions().min());
-        double v = lua_->script(condition_script);
-        return v;
+        return evaluate<double>(conditions().min());
     }
     else
     {
         return -std::numeric_limits<double>::infinity();
     }
-#else
-    throw(Exception("DCCL built without Lua support: cannot use dynamic_conditions"));
-#endif
 }
 
 double dccl::DynamicConditions::max()
 {
-#if DCCL_HAS_LUA
     if (is_initialized())
     {
-        auto condition_script = return_prefix(conditions().max());
-        double v = lua_->script(condition_script);
-        return v;
+        return evaluate<double>(conditions().max());
     }
     else
     {
         return std::numeric_limits<double>::infinity();
     }
-#else
-    throw(Exception("DCCL built without Lua support: cannot use dynamic_conditions"));
-#endif
 }
@@ -23,20 +23,18 @@
 #ifndef DCCLDYNAMICCONDITIONALS20220214H
 #define DCCLDYNAMICCONDITIONALS20220214H
 
+#include <unordered_map>
+
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
 
+#include "dccl/internal/condition_expression.h"
 #include "dccl/option_extensions.pb.h"
 
 // clang-format off
 #define DCCL_HAS_LUA @DCCL_HAS_LUA@
 // clang-format on
 
-namespace sol
-{
-class state;
-}
-
 namespace dccl
 {
 class DynamicConditions
@@ -71,7 +69,29 @@ class DynamicConditions
     double min();
     double max();
 
+    /// \brief While an object of this class exists, the result of each condition is remembered (in this thread) by field, message and repeated index, and not evaluated again. For the duration of a call that does not modify the message (e.g. Codec::encode), where the same condition is otherwise evaluated for sizing, validation and encoding.
+    class MemoizeScope
+    {
+      public:
+        MemoizeScope();
+        ~MemoizeScope();
+
+      private:
+        MemoizeScope(const MemoizeScope&);
+        MemoizeScope& operator=(const MemoizeScope&);
+    };
+
   private:
+    // runs the given condition script (or returns the remembered result, within a MemoizeScope)
+    template <typename T> T evaluate(const std::string& script);
+    // runs the given condition script: natively if it is simple enough
+    // (internal::ConditionExpression), otherwise with Lua
+    template <typename T> T evaluate_script(const std::string& script);
+#if DCCL_HAS_LUA
+    // runs the given condition script with Lua, compiling it the first time it is seen
+    template <typename T> T evaluate_lua(const std::string& script);
+#endif
+
     std::string return_prefix(const std::string& script)
     {
         if (script.find("return") == std::string::npos)
@@ -86,8 +106,44 @@ class DynamicConditions
     const google::protobuf::Message* root_msg_{nullptr};
     int index_{0};
 
+    // condition scripts compiled for native evaluation, by script (emptied when the
+    // CacheGeneration changes, as they cache field lookups)
+    std::unordered_map<std::string, internal::ConditionExpression> expressions_;
+    unsigned expressions_generation_{0};
+
+    // results remembered within a MemoizeScope (the script identifies the field and condition)
+    struct MemoKey
+    {
+        const std::string* script;
+        const google::protobuf::Message* this_msg;
+        const google::protobuf::Message* root_msg;
+        int index;
+
+        bool operator==(const MemoKey& other) const
+        {
+            return script == other.script && this_msg == other.this_msg &&
+                   root_msg == other.root_msg && index == other.index;
+        }
+    };
+    struct MemoKeyHash
+    {
+        std::size_t operator()(const MemoKey& key) const
+        {
+            std::size_t h = std::hash<const void*>()(key.script);
+            h = h * 31 + std::hash<const void*>()(key.this_msg);
+            h = h * 31 + std::hash<const void*>()(key.root_msg);
+            return h * 31 + key.index;
+        }
+    };
+    static thread_local std::unordered_map<MemoKey, double, MemoKeyHash> memo_;
+    // number of MemoizeScope objects in this thread
+    static thread_local int memo_depth_;
+
 #if DCCL_HAS_LUA
-    sol::state* lua_{nullptr};
+    // Lua interpreter (and the condition scripts compiled in it), taken from a process-wide pool
+    // when this thread first needs one and returned to the pool when the thread exits
+    struct LuaState;
+    LuaState* lua_{nullptr};
 #endif
 };
 
@@ -45,6 +45,15 @@ namespace dccl
         { }    
     };
 
+    /// \brief Exception used to signal that more bits were written to a BitWriter than its limit allows (e.g. a message did not fit in the space given to Codec::try_encode()).
+    class BitLimitException : public std::length_error
+    {
+      public:
+      BitLimitException()
+          : std::length_error("Bit limit exceeded")
+        { }
+    };
+
     class OutOfRangeException : public std::out_of_range
     {
       public:
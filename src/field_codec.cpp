@@ -25,13 +25,14 @@
 #include "exception.h"
 #include "field_codec.h"
 
-dccl::MessagePart dccl::FieldCodecBase::part_ = dccl::UNKNOWN;
+thread_local dccl::MessagePart dccl::FieldCodecBase::part_ = dccl::UNKNOWN;
 
-bool dccl::FieldCodecBase::strict_ = false;
+thread_local bool dccl::FieldCodecBase::strict_ = false;
 
-const google::protobuf::Message* dccl::FieldCodecBase::root_message_ = 0;
-const google::protobuf::Descriptor* dccl::FieldCodecBase::root_descriptor_ = 0;
-dccl::DynamicConditions dccl::FieldCodecBase::dynamic_conditions_;
+thread_local const google::protobuf::Message* dccl::FieldCodecBase::root_message_ = 0;
+thread_local const google::protobuf::Descriptor* dccl::FieldCodecBase::root_descriptor_ = 0;
+thread_local dccl::DynamicConditions dccl::FieldCodecBase::dynamic_conditions_;
+thread_local bool dccl::FieldCodecBase::schema_only_size_ = true;
 
 using dccl::dlog;
 using namespace dccl::logger;
@@ -52,6 +53,16 @@ void dccl::FieldCodecBase::base_encode(Bitset* bits, const google::protobuf::Mes
         bits, internal::TypeHelper::find(field_value.GetDescriptor())->get_value(field_value), 0);
 }
 
+void dccl::FieldCodecBase::base_encode(BitWriter* writer,
+                                       const google::protobuf::Message& field_value,
+                                       MessagePart part, bool strict)
+{
+    BaseRAII scoped_globals(part, &field_value, strict);
+
+    field_encode(
+        writer, internal::TypeHelper::find(field_value.GetDescriptor())->get_value(field_value), 0);
+}
+
 void dccl::FieldCodecBase::field_encode(Bitset* bits, const boost::any& field_value,
                                         const google::protobuf::FieldDescriptor* field)
 {
@@ -66,7 +77,7 @@ void dccl::FieldCodecBase::field_encode(Bitset* bits, const boost::any& field_va
 
     Bitset new_bits;
     any_encode(&new_bits, wire_value);
-    disp_size(field, new_bits, msg_handler.field_.size());
+    disp_size(field, new_bits.size(), msg_handler.field_.size());
     bits->append(new_bits);
 
     if (field)
@@ -85,10 +96,118 @@ void dccl::FieldCodecBase::field_encode_repeated(Bitset* bits,
 
     Bitset new_bits;
     any_encode_repeated(&new_bits, wire_values);
-    disp_size(field, new_bits, msg_handler.field_.size(), wire_values.size());
+    disp_size(field, new_bits.size(), msg_handler.field_.size(), wire_values.size());
     bits->append(new_bits);
 }
 
+void dccl::FieldCodecBase::field_encode(BitWriter* writer, const boost::any& field_value,
+                                        const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if (field)
+        dlog.is(DEBUG2, ENCODE) && dlog << "Starting encode for field: " << field->DebugString()
+                                        << std::flush;
+
+    boost::any wire_value;
+    field_pre_encode(&wire_value, field_value);
+
+    const Bitset::size_type start = writer->size();
+    any_encode_to(writer, wire_value);
+    disp_size(field, writer->size() - start, msg_handler.field_.size());
+
+    if (field)
+        dlog.is(DEBUG2, ENCODE) && dlog << "... produced these " << writer->size() - start
+                                        << " bits" << std::endl;
+}
+
+void dccl::FieldCodecBase::field_encode_repeated(BitWriter* writer,
+                                                 const std::vector<boost::any>& field_values,
+                                                 const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    std::vector<boost::any> wire_values;
+    field_pre_encode_repeated(&wire_values, field_values);
+
+    const Bitset::size_type start = writer->size();
+    any_encode_repeated_to(writer, wire_values);
+    disp_size(field, writer->size() - start, msg_handler.field_.size(), wire_values.size());
+}
+
+void dccl::FieldCodecBase::field_encode_from_message(Bitset* bits,
+                                                     const google::protobuf::Message& msg,
+                                                     const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "Starting encode for field: " << field->DebugString()
+                                    << std::flush;
+
+    Bitset new_bits;
+    if (!typed_encode(&new_bits, msg, field))
+    {
+        boost::any wire_value;
+        field_pre_encode(&wire_value, internal::TypeHelper::find(field)->get_value(field, msg));
+        any_encode(&new_bits, wire_value);
+    }
+    disp_size(field, new_bits.size(), msg_handler.field_.size());
+    bits->append(new_bits);
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "... produced these " << new_bits.size()
+                                    << " bits: " << new_bits << std::endl;
+}
+
+void dccl::FieldCodecBase::field_encode_from_message(BitWriter* writer,
+                                                     const google::protobuf::Message& msg,
+                                                     const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "Starting encode for field: " << field->DebugString()
+                                    << std::flush;
+
+    const Bitset::size_type start = writer->size();
+    if (!typed_encode_to(writer, msg, field))
+    {
+        boost::any wire_value;
+        field_pre_encode(&wire_value, internal::TypeHelper::find(field)->get_value(field, msg));
+        any_encode_to(writer, wire_value);
+    }
+    disp_size(field, writer->size() - start, msg_handler.field_.size());
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "... produced these " << writer->size() - start
+                                    << " bits" << std::endl;
+}
+
+void dccl::FieldCodecBase::field_encode_repeated_from_message(
+    Bitset* bits, const google::protobuf::Message& msg,
+    const google::protobuf::FieldDescriptor* field)
+{
+    Bitset new_bits;
+    BitWriter writer(&new_bits);
+    field_encode_repeated_from_message(&writer, msg, field);
+    bits->append(new_bits);
+}
+
+void dccl::FieldCodecBase::field_encode_repeated_from_message(
+    BitWriter* writer, const google::protobuf::Message& msg,
+    const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    const Bitset::size_type start = writer->size();
+    const int num_values = msg.GetReflection()->FieldSize(msg, field);
+    if (!typed_encode_repeated_to(writer, msg, field))
+    {
+        std::vector<boost::any> field_values, wire_values;
+        repeated_values_from_message(msg, field, &field_values);
+        field_pre_encode_repeated(&wire_values, field_values);
+        any_encode_repeated_to(writer, wire_values);
+    }
+    disp_size(field, writer->size() - start, msg_handler.field_.size(), num_values);
+}
+
 void dccl::FieldCodecBase::base_size(unsigned* bit_size, const google::protobuf::Message& msg,
                                      MessagePart part)
 {
@@ -122,6 +241,35 @@ void dccl::FieldCodecBase::field_size_repeated(unsigned* bit_size,
     *bit_size += any_size_repeated(wire_values);
 }
 
+void dccl::FieldCodecBase::field_size_from_message(unsigned* bit_size,
+                                                   const google::protobuf::Message& msg,
+                                                   const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if (!typed_size(bit_size, msg, field))
+    {
+        boost::any wire_value;
+        field_pre_encode(&wire_value, internal::TypeHelper::find(field)->get_value(field, msg));
+        *bit_size += any_size(wire_value);
+    }
+}
+
+void dccl::FieldCodecBase::field_size_repeated_from_message(
+    unsigned* bit_size, const google::protobuf::Message& msg,
+    const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if (!typed_size_repeated(bit_size, msg, field))
+    {
+        std::vector<boost::any> field_values, wire_values;
+        repeated_values_from_message(msg, field, &field_values);
+        field_pre_encode_repeated(&wire_values, field_values);
+        *bit_size += any_size_repeated(wire_values);
+    }
+}
+
 void dccl::FieldCodecBase::base_decode(Bitset* bits, google::protobuf::Message* field_value,
                                        MessagePart part)
 {
@@ -130,6 +278,14 @@ void dccl::FieldCodecBase::base_decode(Bitset* bits, google::protobuf::Message*
     field_decode(bits, &value, 0);
 }
 
+void dccl::FieldCodecBase::base_decode(BitReader* reader, google::protobuf::Message* field_value,
+                                       MessagePart part)
+{
+    BaseRAII scoped_globals(part, field_value);
+    boost::any value(field_value);
+    field_decode(reader, &value, 0);
+}
+
 void dccl::FieldCodecBase::field_decode(Bitset* bits, boost::any* field_value,
                                         const google::protobuf::FieldDescriptor* field)
 {
@@ -195,6 +351,148 @@ void dccl::FieldCodecBase::field_decode_repeated(Bitset* bits,
     field_post_decode_repeated(wire_values, field_values);
 }
 
+void dccl::FieldCodecBase::field_decode(BitReader* reader, boost::any* field_value,
+                                        const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if (!field_value)
+        throw(Exception("Decode called with NULL boost::any"));
+    else if (!reader)
+        throw(Exception("Decode called with NULL BitReader"));
+
+    if (field)
+        dlog.is(DEBUG2, DECODE) && dlog << "Starting decode for field: " << field->DebugString()
+                                        << std::flush;
+
+    if (root_message())
+        dlog.is(DEBUG3, DECODE) && dlog << "Message thus far is: " << root_message()->DebugString()
+                                        << std::flush;
+
+    boost::any wire_value = *field_value;
+
+    any_decode_from(reader, &wire_value);
+
+    field_post_decode(wire_value, field_value);
+}
+
+void dccl::FieldCodecBase::field_decode_repeated(BitReader* reader,
+                                                 std::vector<boost::any>* field_values,
+                                                 const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if (!field_values)
+        throw(Exception("Decode called with NULL field_values"));
+    else if (!reader)
+        throw(Exception("Decode called with NULL BitReader"));
+
+    if (field)
+        dlog.is(DEBUG2, DECODE) &&
+            dlog << "Starting repeated decode for field: " << field->DebugString() << std::endl;
+
+    std::vector<boost::any> wire_values = *field_values;
+    any_decode_repeated_from(reader, &wire_values);
+
+    field_values->clear();
+    field_post_decode_repeated(wire_values, field_values);
+}
+
+void dccl::FieldCodecBase::field_decode_into_message(Bitset* bits, google::protobuf::Message* msg,
+                                                     const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "Starting decode for field: " << field->DebugString()
+                                    << std::flush;
+
+    if (root_message())
+        dlog.is(DEBUG3, DECODE) && dlog << "Message thus far is: " << root_message()->DebugString()
+                                        << std::flush;
+
+    Bitset these_bits(bits);
+
+    unsigned bits_to_transfer = 0;
+    field_min_size(&bits_to_transfer, field);
+    these_bits.get_more_bits(bits_to_transfer);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "... using these bits: " << these_bits << std::endl;
+
+    if (!typed_decode(&these_bits, msg, field))
+    {
+        boost::any wire_value, field_value;
+        any_decode(&these_bits, &wire_value);
+        field_post_decode(wire_value, &field_value);
+        internal::TypeHelper::find(field)->set_value(field, msg, field_value);
+    }
+}
+
+void dccl::FieldCodecBase::field_decode_into_message(BitReader* reader,
+                                                     google::protobuf::Message* msg,
+                                                     const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "Starting decode for field: " << field->DebugString()
+                                    << std::flush;
+
+    if (root_message())
+        dlog.is(DEBUG3, DECODE) && dlog << "Message thus far is: " << root_message()->DebugString()
+                                        << std::flush;
+
+    if (!typed_decode_from(reader, msg, field))
+    {
+        boost::any wire_value, field_value;
+        any_decode_from(reader, &wire_value);
+        field_post_decode(wire_value, &field_value);
+        internal::TypeHelper::find(field)->set_value(field, msg, field_value);
+    }
+}
+
+void dccl::FieldCodecBase::field_decode_repeated_into_message(
+    Bitset* bits, google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "Starting repeated decode for field: "
+                                    << field->DebugString() << std::endl;
+
+    Bitset these_bits(bits);
+
+    unsigned bits_to_transfer = 0;
+    field_min_size(&bits_to_transfer, field);
+    these_bits.get_more_bits(bits_to_transfer);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "using these " << these_bits.size()
+                                    << " bits: " << these_bits << std::endl;
+
+    if (!typed_decode_repeated(&these_bits, msg, field))
+    {
+        std::vector<boost::any> wire_values, field_values;
+        any_decode_repeated(&these_bits, &wire_values);
+        field_post_decode_repeated(wire_values, &field_values);
+        add_repeated_values_to_message(field_values, msg, field);
+    }
+}
+
+void dccl::FieldCodecBase::field_decode_repeated_into_message(
+    BitReader* reader, google::protobuf::Message* msg,
+    const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "Starting repeated decode for field: "
+                                    << field->DebugString() << std::endl;
+
+    if (!typed_decode_repeated_from(reader, msg, field))
+    {
+        std::vector<boost::any> wire_values, field_values;
+        any_decode_repeated_from(reader, &wire_values);
+        field_post_decode_repeated(wire_values, &field_values);
+        add_repeated_values_to_message(field_values, msg, field);
+    }
+}
+
 void dccl::FieldCodecBase::base_max_size(unsigned* bit_size,
                                          const google::protobuf::Descriptor* desc, MessagePart part)
 {
@@ -214,11 +512,7 @@ void dccl::FieldCodecBase::field_max_size(unsigned* bit_size,
                                           const google::protobuf::FieldDescriptor* field)
 {
     internal::MessageStack msg_handler(field);
-
-    if (this_field())
-        *bit_size += this_field()->is_repeated() ? max_size_repeated() : max_size();
-    else
-        *bit_size += max_size();
+    *bit_size += cached_size(internal::SizeCache::MAX_SIZE);
 }
 
 void dccl::FieldCodecBase::base_min_size(unsigned* bit_size,
@@ -242,11 +536,53 @@ void dccl::FieldCodecBase::field_min_size(unsigned* bit_size,
 
 {
     internal::MessageStack msg_handler(field);
+    *bit_size += cached_size(internal::SizeCache::MIN_SIZE);
+}
+
+unsigned dccl::FieldCodecBase::cached_size(internal::SizeCache::Bound bound)
+{
+    // sizes requested outside of a message (e.g. of the identifier codec) are not cached
+    if (!this_descriptor())
+        return calculate_size(bound);
+
+    internal::SizeCache::Key key = {this,
+                                    &FieldCodecManagerLocal::current(),
+                                    this_field(),
+                                    this_descriptor(),
+                                    root_descriptor_,
+                                    part_,
+                                    internal::MessageStack::current_part(),
+                                    bound};
+    unsigned size = 0;
+    if (internal::SizeCache::find(key, &size))
+        return size;
+
+    // nested fields (of an embedded message) clear schema_only_size_ if their size cannot be cached
+    bool enclosing_schema_only = schema_only_size_;
+    schema_only_size_ = schema_only_size();
+    try
+    {
+        size = calculate_size(bound);
+    }
+    catch (...)
+    {
+        schema_only_size_ = enclosing_schema_only;
+        throw;
+    }
+
+    if (schema_only_size_)
+        internal::SizeCache::insert(key, size);
+    schema_only_size_ = enclosing_schema_only && schema_only_size_;
+    return size;
+}
 
-    if (this_field())
-        *bit_size += this_field()->is_repeated() ? min_size_repeated() : min_size();
+unsigned dccl::FieldCodecBase::calculate_size(internal::SizeCache::Bound bound)
+{
+    bool repeated = this_field() && this_field()->is_repeated();
+    if (bound == internal::SizeCache::MAX_SIZE)
+        return repeated ? max_size_repeated() : max_size();
     else
-        *bit_size += min_size();
+        return repeated ? min_size_repeated() : min_size();
 }
 
 void dccl::FieldCodecBase::base_validate(const google::protobuf::Descriptor* desc, MessagePart part)
@@ -371,14 +707,38 @@ std::string dccl::FieldCodecBase::codec_group(const google::protobuf::Descriptor
 
 std::string dccl::FieldCodecBase::info() { return std::string(); }
 
+void dccl::FieldCodecBase::repeated_values_from_message(
+    const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field,
+    std::vector<boost::any>* field_values)
+{
+    boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(field);
+    for (int j = 0, m = msg.GetReflection()->FieldSize(msg, field); j < m; ++j)
+        field_values->push_back(helper->get_repeated_value(field, msg, j));
+}
+
+void dccl::FieldCodecBase::add_repeated_values_to_message(
+    const std::vector<boost::any>& field_values, google::protobuf::Message* msg,
+    const google::protobuf::FieldDescriptor* field)
+{
+    boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(field);
+    for (int j = 0, m = field_values.size(); j < m; ++j)
+        helper->add_value(field, msg, field_values[j]);
+}
+
 void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits,
                                                const std::vector<boost::any>& wire_values)
+{
+    BitWriter writer(bits);
+    encode_repeated_elements(&writer, wire_values);
+}
+
+unsigned dccl::FieldCodecBase::encode_repeated_size(BitWriter* writer, std::size_t num_values)
 {
     // out_bits = [field_values[2]][field_values[1]][field_values[0]]
 
     unsigned wire_vector_size = dccl_field_options().max_repeat();
 
-    if (wire_values.size() > wire_vector_size && strict())
+    if (num_values > wire_vector_size && strict())
         throw(
             dccl::OutOfRangeException(std::string("Repeated size exceeds max_repeat for field: ") +
                                           FieldCodecBase::this_field()->DebugString(),
@@ -387,66 +747,96 @@ void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits,
     // for DCCL3 and beyond, add a prefix numeric field giving the vector size (rather than always going to max_repeat)
     if (codec_version() > 2)
     {
-        wire_vector_size =
-            std::min((int)dccl_field_options().max_repeat(), (int)wire_values.size());
+        wire_vector_size = std::min((int)dccl_field_options().max_repeat(), (int)num_values);
         Bitset size_bits(repeated_vector_field_size(dccl_field_options().max_repeat()),
                          wire_vector_size);
-        bits->append(size_bits);
+        writer->write(size_bits);
 
         dlog.is(DEBUG2, ENCODE) && dlog << "repeated size field ... produced these "
                                         << size_bits.size() << " bits: " << size_bits << std::endl;
     }
+    return wire_vector_size;
+}
+
+unsigned dccl::FieldCodecBase::decode_repeated_size(BitReader* reader)
+{
+    if (codec_version() > 2)
+        return reader->read(repeated_vector_field_size(dccl_field_options().max_repeat()));
+    else
+        return dccl_field_options().max_repeat();
+}
+
+unsigned dccl::FieldCodecBase::decode_repeated_size(Bitset* bits)
+{
+    if (codec_version() > 2)
+    {
+        Bitset size_bits(bits);
+        size_bits.get_more_bits(repeated_vector_field_size(dccl_field_options().max_repeat()));
+        return size_bits.to_ulong();
+    }
+    else
+    {
+        return dccl_field_options().max_repeat();
+    }
+}
+
+unsigned dccl::FieldCodecBase::size_repeated_size(unsigned* bit_size, std::size_t num_values)
+{
+    if (codec_version() > 2)
+    {
+        *bit_size += repeated_vector_field_size(dccl_field_options().max_repeat());
+        return std::min((int)dccl_field_options().max_repeat(), (int)num_values);
+    }
+    else
+    {
+        return dccl_field_options().max_repeat();
+    }
+}
+
+bool dccl::FieldCodecBase::omit_repeated_element(internal::MessageStack* msg_handler, unsigned i)
+{
+    msg_handler->update_index(this->this_field(), i);
+
+    DynamicConditions& dc = this->dynamic_conditions(this->this_field());
+    dc.set_repeated_index(i);
+    if (dc.has_omit_if())
+    {
+        dc.regenerate(this_message(), root_message(), i);
+        return dc.omit();
+    }
+    return false;
+}
+
+void dccl::FieldCodecBase::encode_repeated_elements(BitWriter* writer,
+                                                    const std::vector<boost::any>& wire_values)
+{
+    const unsigned wire_vector_size = encode_repeated_size(writer, wire_values.size());
 
     internal::MessageStack msg_handler(this->this_field());
     for (unsigned i = 0, n = wire_vector_size; i < n; ++i)
     {
-        msg_handler.update_index(this->this_field(), i);
-
-        DynamicConditions& dc = this->dynamic_conditions(this->this_field());
-        dc.set_repeated_index(i);
-        if (dc.has_omit_if())
-        {
-            dc.regenerate(this_message(), root_message(), i);
-            if (dc.omit())
-                continue;
-        }
-
-        Bitset new_bits;
+        if (omit_repeated_element(&msg_handler, i))
+            continue;
+
         if (i < wire_values.size())
-            any_encode(&new_bits, wire_values[i]);
+            any_encode_to(writer, wire_values[i]);
         else
-            any_encode(&new_bits, boost::any());
-        bits->append(new_bits);
+            any_encode_to(writer, boost::any());
     }
 }
 
 void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits,
                                                std::vector<boost::any>* wire_values)
 {
-    unsigned wire_vector_size = dccl_field_options().max_repeat();
-    if (codec_version() > 2)
-    {
-        Bitset size_bits(repeated_bits);
-        size_bits.get_more_bits(repeated_vector_field_size(dccl_field_options().max_repeat()));
-
-        wire_vector_size = size_bits.to_ulong();
-    }
+    const unsigned wire_vector_size = decode_repeated_size(repeated_bits);
 
     wire_values->resize(wire_vector_size);
 
     internal::MessageStack msg_handler(this->this_field());
     for (unsigned i = 0, n = wire_vector_size; i < n; ++i)
     {
-        msg_handler.update_index(this->this_field(), i);
-
-        DynamicConditions& dc = this->dynamic_conditions(this->this_field());
-        dc.set_repeated_index(i);
-        if (dc.has_omit_if())
-        {
-            dc.regenerate(this_message(), root_message(), i);
-            if (dc.omit())
-                continue;
-        }
+        if (omit_repeated_element(&msg_handler, i))
+            continue;
 
         Bitset these_bits(repeated_bits);
         these_bits.get_more_bits(min_size());
@@ -454,30 +844,33 @@ void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits,
     }
 }
 
-unsigned dccl::FieldCodecBase::any_size_repeated(const std::vector<boost::any>& wire_values)
+void dccl::FieldCodecBase::decode_repeated_elements(BitReader* reader,
+                                                    std::vector<boost::any>* wire_values)
 {
-    unsigned out = 0;
-    unsigned wire_vector_size = dccl_field_options().max_repeat();
+    const unsigned wire_vector_size = decode_repeated_size(reader);
 
-    if (codec_version() > 2)
+    wire_values->resize(wire_vector_size);
+
+    internal::MessageStack msg_handler(this->this_field());
+    for (unsigned i = 0, n = wire_vector_size; i < n; ++i)
     {
-        wire_vector_size =
-            std::min((int)dccl_field_options().max_repeat(), (int)wire_values.size());
-        out += repeated_vector_field_size(dccl_field_options().max_repeat());
+        if (omit_repeated_element(&msg_handler, i))
+            continue;
+
+        any_decode_from(reader, &(*wire_values)[i]);
     }
+}
+
+unsigned dccl::FieldCodecBase::any_size_repeated(const std::vector<boost::any>& wire_values)
+{
+    unsigned out = 0;
+    const unsigned wire_vector_size = size_repeated_size(&out, wire_values.size());
 
     internal::MessageStack msg_handler(this->this_field());
     for (unsigned i = 0, n = wire_vector_size; i < n; ++i)
     {
-        msg_handler.update_index(this->this_field(), i);
-        DynamicConditions& dc = this->dynamic_conditions(this->this_field());
-        dc.set_repeated_index(i);
-        if (dc.has_omit_if())
-        {
-            dc.regenerate(this_message(), root_message(), i);
-            if (dc.omit())
-                continue;
-        }
+        if (omit_repeated_element(&msg_handler, i))
+            continue;
 
         if (i < wire_values.size())
             out += any_size(wire_values[i]);
@@ -539,7 +932,8 @@ void dccl::FieldCodecBase::any_post_decode_repeated(const std::vector<boost::any
 //
 
 void dccl::FieldCodecBase::disp_size(const google::protobuf::FieldDescriptor* field,
-                                     const Bitset& new_bits, int depth, int vector_size /* = -1 */)
+                                     unsigned new_bits_size, int depth,
+                                     int vector_size /* = -1 */)
 {
     if (!root_descriptor_)
         return;
@@ -551,7 +945,7 @@ void dccl::FieldCodecBase::disp_size(const google::protobuf::FieldDescriptor* fi
             name += "[" + boost::lexical_cast<std::string>(vector_size) + "]";
 
         dlog << std::string(depth, '|') << name << std::setfill('.')
-             << std::setw(40 - name.size() - depth) << new_bits.size() << std::endl;
+             << std::setw(40 - name.size() - depth) << new_bits_size << std::endl;
 
         if (!field)
             dlog << std::endl;
@@ -32,12 +32,15 @@
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/message.h>
 
+#include "bit_cursor.h"
 #include "common.h"
 #include "dccl/binary.h"
 #include "dccl/dynamic_conditions.h"
 #include "dccl/option_extensions.pb.h"
 #include "exception.h"
 #include "internal/field_codec_message_stack.h"
+#include "internal/field_options_cache.h"
+#include "internal/size_cache.h"
 #include "internal/type_helper.h"
 #include "oneof.h"
 
@@ -110,6 +113,9 @@ class FieldCodecBase
     // currently encoded or (partially) decoded root message
     static const google::protobuf::Message* root_message() { return root_message_; }
 
+    // descriptor of the currently encoded, decoded or loaded root message
+    static const google::protobuf::Descriptor* root_descriptor() { return root_descriptor_; }
+
     static bool has_codec_group()
     {
         if (root_descriptor_)
@@ -160,6 +166,14 @@ class FieldCodecBase
     void base_encode(Bitset* bits, const google::protobuf::Message& msg, MessagePart part,
                      bool strict);
 
+    /// \brief Encode this part (body or head) of the base message using a BitWriter cursor
+    ///
+    /// \param writer BitWriter that all bits will be written to (i.e. pushed on to the most significant end of the underlying Bitset).
+    /// \param msg DCCL Message to encode
+    /// \param part Part of the message to encode
+    void base_encode(BitWriter* writer, const google::protobuf::Message& msg, MessagePart part,
+                     bool strict);
+
     /// \brief Calculate the size (in bits) of a part of the base message when it is encoded
     ///
     /// \param bit_size Pointer to unsigned integer to store the result.
@@ -174,6 +188,13 @@ class FieldCodecBase
     /// \param part part of the Message to decode
     void base_decode(Bitset* bits, google::protobuf::Message* msg, MessagePart part);
 
+    /// \brief Decode part of a message using a BitReader cursor
+    ///
+    /// \param reader BitReader to read the bits from. The reader is advanced past the bits that were used.
+    /// \param msg DCCL Message to <i>merge</i> the decoded result into.
+    /// \param part part of the Message to decode
+    void base_decode(BitReader* reader, google::protobuf::Message* msg, MessagePart part);
+
     /// \brief Calculate the maximum size of a message given its Descriptor alone (no data)
     ///
     /// \param bit_size Pointer to unsigned integer to store calculated maximum size in bits.
@@ -253,6 +274,22 @@ class FieldCodecBase
     void field_encode_repeated(Bitset* bits, const std::vector<boost::any>& field_values,
                                const google::protobuf::FieldDescriptor* field);
 
+    /// \brief Encode a non-repeated field using a BitWriter cursor.
+    ///
+    /// \param writer BitWriter to write the encoded bits to
+    /// \param field_value Value to encode (FieldType)
+    /// \param field Protobuf descriptor to the field to encode. Set to 0 for base message.
+    void field_encode(BitWriter* writer, const boost::any& field_value,
+                      const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Encode a repeated field using a BitWriter cursor.
+    ///
+    /// \param writer BitWriter to write the encoded bits to
+    /// \param field_values Values to encode (FieldType)
+    /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+    void field_encode_repeated(BitWriter* writer, const std::vector<boost::any>& field_values,
+                               const google::protobuf::FieldDescriptor* field);
+
     /// \brief Calculate the size of a field
     ///
     /// \param bit_size Location to <i>add</i> calculated bit size to. Be sure to zero `bit_size` if you want only the size of this field.
@@ -286,6 +323,22 @@ class FieldCodecBase
     void field_decode_repeated(Bitset* bits, std::vector<boost::any>* field_values,
                                const google::protobuf::FieldDescriptor* field);
 
+    /// \brief Decode a non-repeated field using a BitReader cursor
+    ///
+    /// \param reader BitReader to read from. The reader is advanced past the bits that were used.
+    /// \param field_value Location to store decoded value (FieldType)
+    /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+    void field_decode(BitReader* reader, boost::any* field_value,
+                      const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Decode a repeated field using a BitReader cursor
+    ///
+    /// \param reader BitReader to read from. The reader is advanced past the bits that were used.
+    /// \param field_values Location to store decoded values (FieldType)
+    /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+    void field_decode_repeated(BitReader* reader, std::vector<boost::any>* field_values,
+                               const google::protobuf::FieldDescriptor* field);
+
     /// \brief Post-decodes a non-repeated (i.e. optional or required) field by converting the WireType (the type used in the encoded DCCL message) representation into the FieldType representation (the Google Protobuf representation). This allows for type-converting codecs.
     ///
     /// \param wire_value Should be set to the desired value to translate
@@ -305,6 +358,87 @@ class FieldCodecBase
         any_post_decode_repeated(wire_values, field_values);
     }
 
+    /// \brief Encode a non-repeated, non-message field, taking its value directly from the message that contains it. For codecs derived from TypedFieldCodec this does not use boost::any; otherwise it is the same as field_encode() with the field's value.
+    ///
+    /// \param bits Pointer to bitset to store encoded bits. Bits are added to the most significant end of `bits`
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field to encode.
+    void field_encode_from_message(Bitset* bits, const google::protobuf::Message& msg,
+                                   const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Encode a non-repeated, non-message field using a BitWriter cursor, taking its value directly from the message that contains it.
+    ///
+    /// \param writer BitWriter to write the encoded bits to
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field to encode.
+    void field_encode_from_message(BitWriter* writer, const google::protobuf::Message& msg,
+                                   const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Calculate the size of a non-repeated, non-message field, taking its value directly from the message that contains it.
+    ///
+    /// \param bit_size Location to <i>add</i> calculated bit size to.
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_size_from_message(unsigned* bit_size, const google::protobuf::Message& msg,
+                                 const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Decode a non-repeated, non-message field and set it (if not empty) in the message that contains it.
+    ///
+    /// \param bits Bits to decode. Used bits are consumed (erased) from the least significant end
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_decode_into_message(Bitset* bits, google::protobuf::Message* msg,
+                                   const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Decode a non-repeated, non-message field using a BitReader cursor and set it (if not empty) in the message that contains it.
+    ///
+    /// \param reader BitReader to read from. The reader is advanced past the bits that were used.
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_decode_into_message(BitReader* reader, google::protobuf::Message* msg,
+                                   const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Encode a repeated, non-message field, taking its values directly from the message that contains it. For codecs derived from TypedFieldCodec the values are read as a whole through a RepeatedFieldRef rather than as a std::vector<boost::any>; otherwise this is the same as field_encode_repeated() with the field's values.
+    ///
+    /// \param bits Pointer to bitset to store encoded bits. Bits are added to the most significant end of `bits`
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_encode_repeated_from_message(Bitset* bits, const google::protobuf::Message& msg,
+                                            const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Encode a repeated, non-message field using a BitWriter cursor, taking its values directly from the message that contains it.
+    ///
+    /// \param writer BitWriter to write the encoded bits to
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_encode_repeated_from_message(BitWriter* writer,
+                                            const google::protobuf::Message& msg,
+                                            const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Calculate the size of a repeated, non-message field, taking its values directly from the message that contains it.
+    ///
+    /// \param bit_size Location to <i>add</i> calculated bit size to.
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_size_repeated_from_message(unsigned* bit_size, const google::protobuf::Message& msg,
+                                          const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Decode a repeated, non-message field and add the (non-empty) values to the message that contains it.
+    ///
+    /// \param bits Bits to decode. Used bits are consumed (erased) from the least significant end
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_decode_repeated_into_message(Bitset* bits, google::protobuf::Message* msg,
+                                            const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Decode a repeated, non-message field using a BitReader cursor and add the (non-empty) values to the message that contains it.
+    ///
+    /// \param reader BitReader to read from. The reader is advanced past the bits that were used.
+    /// \param msg Message containing the field
+    /// \param field Protobuf descriptor to the field.
+    void field_decode_repeated_into_message(BitReader* reader, google::protobuf::Message* msg,
+                                            const google::protobuf::FieldDescriptor* field);
+
     // traverse schema (Descriptor)
 
     /// \brief Calculate the upper bound on this field's size (in bits)
@@ -335,10 +469,10 @@ class FieldCodecBase
     /// \brief Get the DCCL field option extension value for the current field
     ///
     /// dccl::DCCLFieldOptions is defined in acomms_option_extensions.proto
-    dccl::DCCLFieldOptions dccl_field_options() const
+    const dccl::DCCLFieldOptions& dccl_field_options() const
     {
         if (this_field())
-            return this_field()->options().GetExtension(dccl::field);
+            return internal::FieldOptionsCache::find(this_field());
         else
             throw(Exception(
                 "Cannot call dccl_field on base message (has no *field* option extension"));
@@ -434,6 +568,30 @@ class FieldCodecBase
     /// \return Size of field (in bits)
     virtual unsigned any_size(const boost::any& wire_value) = 0;
 
+    // cursor based encode/decode
+    /// \brief Virtual method used to encode using a BitWriter cursor. The default implementation calls any_encode() and writes the resulting bits; override this to write directly to the cursor.
+    ///
+    /// \param writer BitWriter to write the encoded bits to
+    /// \param wire_value Value to encode (WireType)
+    virtual void any_encode_to(BitWriter* writer, const boost::any& wire_value)
+    {
+        Bitset bits;
+        any_encode(&bits, wire_value);
+        writer->write(bits);
+    }
+
+    /// \brief Virtual method used to decode using a BitReader cursor. The default implementation exposes the unread bits to any_decode() (as the parent Bitset); override this to read directly from the cursor.
+    ///
+    /// \param reader BitReader to read from. Must be advanced past exactly the bits used by this field.
+    /// \param wire_value Place to store decoded value (as FieldType)
+    virtual void any_decode_from(BitReader* reader, boost::any* wire_value)
+    {
+        BitReaderPool pool(reader);
+        Bitset these_bits(pool.bits());
+        these_bits.get_more_bits(min_size());
+        any_decode(&these_bits, wire_value);
+    }
+
     // no boost::any
     /// \brief Validate a field. Use require() inside your overloaded validate() to assert requirements or throw Exceptions directly as needed.
     virtual void validate() {}
@@ -466,7 +624,114 @@ class FieldCodecBase
     virtual unsigned max_size_repeated();
     virtual unsigned min_size_repeated();
 
+    /// \brief Whether max_size() and min_size() (and their repeated versions) depend only on the message schema and field options, so that they can be cached (per field and codec) rather than recalculated on every call. Override to return true only if this holds: sizes that depend on the message (e.g. through dynamic_conditions), a model or any other state must not be cached. The default codecs do so (except for fields with dynamic min or max).
+    virtual bool schema_only_size() { return false; }
+
+    /// \brief schema_only_size() of another codec, such as one wrapped by this codec
+    static bool wrapped_schema_only_size(FieldCodecBase& codec) { return codec.schema_only_size(); }
+
+    /// \brief Encode a repeated field using a BitWriter cursor. The default implementation calls any_encode_repeated() and writes the resulting bits.
+    virtual void any_encode_repeated_to(BitWriter* writer,
+                                        const std::vector<boost::any>& wire_values)
+    {
+        Bitset bits;
+        any_encode_repeated(&bits, wire_values);
+        writer->write(bits);
+    }
+
+    /// \brief Decode a repeated field using a BitReader cursor. The default implementation exposes the unread bits to any_decode_repeated() (as the parent Bitset).
+    virtual void any_decode_repeated_from(BitReader* reader,
+                                          std::vector<boost::any>* wire_values)
+    {
+        BitReaderPool pool(reader);
+        Bitset these_bits(pool.bits());
+        these_bits.get_more_bits(min_size_repeated());
+        any_decode_repeated(&these_bits, wire_values);
+    }
+
+    // statically typed (no boost::any) versions of the field_*_from_message() / field_decode_into_message()
+    // work: pre_encode + encode / size, or decode + post_decode + set the field. Each returns false if the
+    // codec does not implement it (the default), in which case the boost::any versions are used.
+    // Implemented by TypedFieldCodec.
+    virtual bool typed_encode(Bitset* bits, const google::protobuf::Message& msg,
+                              const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_encode_to(BitWriter* writer, const google::protobuf::Message& msg,
+                                 const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_size(unsigned* bit_size, const google::protobuf::Message& msg,
+                            const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_decode(Bitset* bits, google::protobuf::Message* msg,
+                              const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_decode_from(BitReader* reader, google::protobuf::Message* msg,
+                                   const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+
+    // as above, for repeated fields
+    virtual bool typed_encode_repeated_to(BitWriter* writer, const google::protobuf::Message& msg,
+                                          const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_size_repeated(unsigned* bit_size, const google::protobuf::Message& msg,
+                                     const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_decode_repeated(Bitset* bits, google::protobuf::Message* msg,
+                                       const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+    virtual bool typed_decode_repeated_from(BitReader* reader, google::protobuf::Message* msg,
+                                            const google::protobuf::FieldDescriptor* field)
+    {
+        return false;
+    }
+
+    // the steps of encoding / decoding the elements of a repeated field one at a time that do
+    // not depend on the values (shared by the boost::any and typed implementations):
+
+    // checks the number of values against max_repeat (throwing OutOfRangeException in strict mode)
+    // and writes the size prefix (for codec version 3 and newer), returning the number of elements to encode
+    unsigned encode_repeated_size(BitWriter* writer, std::size_t num_values);
+    // reads the size prefix (for codec version 3 and newer), returning the number of elements to decode
+    unsigned decode_repeated_size(BitReader* reader);
+    unsigned decode_repeated_size(Bitset* bits);
+    // adds the size of the prefix to *bit_size, returning the number of elements whose size to add
+    unsigned size_repeated_size(unsigned* bit_size, std::size_t num_values);
+    // updates the element index of the message stack (of this_field()) and returns true if element
+    // i is omitted by a dynamic condition
+    bool omit_repeated_element(internal::MessageStack* msg_handler, unsigned i);
+
+    // boost::any fallbacks for the *_repeated_*_message() methods
+    void repeated_values_from_message(const google::protobuf::Message& msg,
+                                      const google::protobuf::FieldDescriptor* field,
+                                      std::vector<boost::any>* field_values);
+    void add_repeated_values_to_message(const std::vector<boost::any>& field_values,
+                                        google::protobuf::Message* msg,
+                                        const google::protobuf::FieldDescriptor* field);
+
+    /// \brief Encodes the elements (and, for codec version 3 and newer, the size prefix) of a repeated field, each with any_encode_to().
+    void encode_repeated_elements(BitWriter* writer, const std::vector<boost::any>& wire_values);
+
+    /// \brief Decodes the elements (and, for codec version 3 and newer, the size prefix) of a repeated field, each with any_decode_from().
+    void decode_repeated_elements(BitReader* reader, std::vector<boost::any>* wire_values);
+
     friend class FieldCodecManager;
+    friend class FieldCodecManagerLocal;
 
   private:
     // codec information
@@ -482,18 +747,26 @@ class FieldCodecBase
             return max_size() != min_size();
     }
 
+    // max/min size of the current field (or message, if this_field() == 0), from the SizeCache if possible
+    unsigned cached_size(internal::SizeCache::Bound bound);
+    unsigned calculate_size(internal::SizeCache::Bound bound);
+
     int repeated_vector_field_size(int max_repeat) { return dccl::ceil_log2(max_repeat + 1); }
 
-    void disp_size(const google::protobuf::FieldDescriptor* field, const Bitset& new_bits,
+    void disp_size(const google::protobuf::FieldDescriptor* field, unsigned new_bits_size,
                    int depth, int vector_size = -1);
 
   private:
-    // sets global statics relating the current message begin processed
-    // and unsets them on destruction
+    // sets the (thread local) statics relating the current message being processed
+    // and restores the previous values (of an enclosing call, if any) on destruction
     struct BaseRAII
     {
         BaseRAII(MessagePart part, const google::protobuf::Descriptor* root_descriptor,
                  bool strict = false)
+            : part_(FieldCodecBase::part_),
+              strict_(FieldCodecBase::strict_),
+              root_message_(FieldCodecBase::root_message_),
+              root_descriptor_(FieldCodecBase::root_descriptor_)
         {
             FieldCodecBase::part_ = part;
             FieldCodecBase::strict_ = strict;
@@ -503,6 +776,10 @@ class FieldCodecBase
 
         BaseRAII(MessagePart part, const google::protobuf::Message* root_message,
                  bool strict = false)
+            : part_(FieldCodecBase::part_),
+              strict_(FieldCodecBase::strict_),
+              root_message_(FieldCodecBase::root_message_),
+              root_descriptor_(FieldCodecBase::root_descriptor_)
         {
             FieldCodecBase::part_ = part;
             FieldCodecBase::strict_ = strict;
@@ -511,17 +788,26 @@ class FieldCodecBase
         }
         ~BaseRAII()
         {
-            FieldCodecBase::part_ = dccl::UNKNOWN;
-            FieldCodecBase::strict_ = false;
-            FieldCodecBase::root_message_ = 0;
-            FieldCodecBase::root_descriptor_ = 0;
+            FieldCodecBase::part_ = part_;
+            FieldCodecBase::strict_ = strict_;
+            FieldCodecBase::root_message_ = root_message_;
+            FieldCodecBase::root_descriptor_ = root_descriptor_;
         }
+
+      private:
+        MessagePart part_;
+        bool strict_;
+        const google::protobuf::Message* root_message_;
+        const google::protobuf::Descriptor* root_descriptor_;
     };
 
-    static MessagePart part_;
-    static bool strict_;
-    static const google::protobuf::Message* root_message_;
-    static const google::protobuf::Descriptor* root_descriptor_;
+    // state of the encode/decode/size call in progress on this thread, set by BaseRAII
+    static thread_local MessagePart part_;
+    static thread_local bool strict_;
+    static thread_local const google::protobuf::Message* root_message_;
+    static thread_local const google::protobuf::Descriptor* root_descriptor_;
+    // false if a size being calculated used a codec whose size does not only depend on the schema
+    static thread_local bool schema_only_size_;
 
     std::string name_;
     google::protobuf::FieldDescriptor::Type field_type_;
@@ -529,7 +815,7 @@ class FieldCodecBase
 
     bool force_required_;
 
-    static DynamicConditions dynamic_conditions_;
+    static thread_local DynamicConditions dynamic_conditions_;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const FieldCodecBase& field_codec)
@@ -46,6 +46,62 @@ namespace dccl
           
       unsigned min_size()
       { return size(); }          
+
+      /// \brief Decode a field directly from a BitReader cursor by reading exactly size() bits and passing them to decode(Bitset*)
+      WireType decode_from(BitReader* reader)
+      {
+          Bitset bits;
+          reader->read(&bits, size());
+          return this->decode(&bits);
+      }
+
+      protected:
+      /// \brief Encodes each value with encode() and packs the results together with BitWriter::write_packed(), as all of them are size() bits
+      bool encode_repeated_values_to(BitWriter* writer, const std::vector<WireType>& wire_values,
+                                     unsigned wire_vector_size)
+      {
+          const unsigned element_size = size();
+          if(element_size > 64)
+              return false;
+
+          std::vector<uint64> packed(wire_vector_size);
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              const Bitset bits = (i < wire_values.size()) ? this->encode(wire_values[i]) : this->encode();
+              // leave codecs that don't honor their size() to the per-element path
+              if(bits.size() != element_size)
+                  return false;
+              packed[i] = bits.template to<uint64>();
+          }
+          writer->write_packed(packed.data(), packed.size(), element_size);
+          return true;
+      }
+
+      /// \brief Unpacks all the values with BitReader::read_packed() and decodes each with decode()
+      bool decode_repeated_values_from(BitReader* reader, std::vector<WireType>* wire_values,
+                                       std::vector<bool>* decoded)
+      {
+          const unsigned element_size = size();
+          if(element_size > 64)
+              return false;
+
+          std::vector<uint64> packed(wire_values->size());
+          reader->read_packed(packed.data(), packed.size(), element_size);
+
+          Bitset bits;
+          for(std::size_t i = 0, n = packed.size(); i < n; ++i)
+          {
+              bits.from(packed[i], element_size);
+              try
+              {
+                  (*wire_values)[i] = this->decode(&bits);
+                  (*decoded)[i] = true;
+              }
+              catch(NullValueException&)
+              { }
+          }
+          return true;
+      }
     };
 }
 
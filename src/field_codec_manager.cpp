@@ -21,13 +21,42 @@
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include "field_codec_manager.h"
 
-std::map<google::protobuf::FieldDescriptor::Type, dccl::FieldCodecManager::InsideMap> dccl::FieldCodecManager::codecs_;
+thread_local dccl::FieldCodecManagerLocal* dccl::FieldCodecManagerLocal::current_ = 0;
 
+thread_local std::unordered_map<const google::protobuf::FieldDescriptor*, std::vector<dccl::FieldCodecManagerLocal::FieldLookup> > dccl::FieldCodecManagerLocal::field_lookups_;
+thread_local std::unordered_map<const google::protobuf::Descriptor*, std::vector<dccl::FieldCodecManagerLocal::MessageLookup> > dccl::FieldCodecManagerLocal::message_lookups_;
+thread_local unsigned dccl::FieldCodecManagerLocal::lookup_generation_ = 0;
 
-boost::shared_ptr<dccl::FieldCodecBase>
-dccl::FieldCodecManager::__find(google::protobuf::FieldDescriptor::Type type,
-                                                 const std::string& codec_name,
-                                                 const std::string& type_name /* = "" */)
+dccl::FieldCodecManagerLocal& dccl::FieldCodecManager::global()
+{
+    static FieldCodecManagerLocal global_;
+    return global_;
+}
+
+dccl::FieldCodecManagerLocal& dccl::FieldCodecManagerLocal::current()
+{
+    return current_ ? *current_ : FieldCodecManager::global();
+}
+
+const boost::shared_ptr<dccl::FieldCodecBase>&
+dccl::FieldCodecManagerLocal::__find(google::protobuf::FieldDescriptor::Type type,
+                                     const std::string& codec_name,
+                                     const std::string& type_name /* = "" */) const
+{
+    for(const FieldCodecManagerLocal* manager = this; manager; manager = manager->fallback_)
+    {
+        const boost::shared_ptr<FieldCodecBase>* codec = manager->__find_local(type, codec_name, type_name);
+        if(codec)
+            return *codec;
+    }
+    
+    throw(Exception("No codec by the name `" + codec_name + "` found for type: " + internal::TypeHelper::find(type)->as_str()));
+}
+
+const boost::shared_ptr<dccl::FieldCodecBase>*
+dccl::FieldCodecManagerLocal::__find_local(google::protobuf::FieldDescriptor::Type type,
+                                           const std::string& codec_name,
+                                           const std::string& type_name) const
 {
     typedef InsideMap::const_iterator InsideIterator;
     typedef std::map<google::protobuf::FieldDescriptor::Type, InsideMap>::const_iterator Iterator;
@@ -39,15 +68,13 @@ dccl::FieldCodecManager::__find(google::protobuf::FieldDescriptor::Type type,
         // try specific type codec
         inside_it = it->second.find(__mangle_name(codec_name, type_name));
         if(inside_it != it->second.end())
-            return inside_it->second;
+            return &inside_it->second;
         
         // try general 
         inside_it = it->second.find(codec_name);
         if(inside_it != it->second.end())
-            return inside_it->second;
+            return &inside_it->second;
     }
     
-    throw(Exception("No codec by the name `" + codec_name + "` found for type: " + internal::TypeHelper::find(type)->as_str()));
+    return 0;
 }
-
-
@@ -28,7 +28,10 @@
 #include <boost/mpl/not.hpp>
 #include <boost/mpl/logical.hpp>
 
+#include <unordered_map>
+
 #include "internal/type_helper.h"
+#include "internal/cache_generation.h"
 #include "field_codec.h"
 #include "dccl/logger.h"
 
@@ -40,14 +43,25 @@ namespace dccl
         template <int> struct dummy_fcm { dummy_fcm(int) {} };
     }
 
-    /// \brief A class for managing the various field codecs. Here you can add and remove field codecs. The DCCL Codec and DefaultMessageCodec use the find() methods to locate the appropriate field codec.
-    class FieldCodecManager
+    /// \brief A set of field codecs. Here you can add and remove field codecs. The DCCL Codec and DefaultMessageCodec use the find() methods to locate the appropriate field codec.
+    ///
+    /// Each Codec owns a FieldCodecManagerLocal (Codec::manager()) for the codecs that only it uses; codecs that are not found there are looked up in the process-wide set (FieldCodecManager::global()), which holds the default codecs. Once loading is done, lookups do not modify the set, so they need no locking.
+    class FieldCodecManagerLocal
     {
       public:
-        // field type == wire type
-        /* template<typename FieldType, template <typename FieldType> class Codec> */
-        /*     static void add(const std::string& name); */
-            
+        /// \brief Create an empty set of codecs.
+        ///
+        /// \param fallback Set of codecs searched by find() for codecs that are not in this one (typically FieldCodecManager::global()), or null if none.
+        explicit FieldCodecManagerLocal(const FieldCodecManagerLocal* fallback = 0)
+            : fallback_(fallback)
+        { }
+
+        ~FieldCodecManagerLocal()
+        {
+            // the lookup, size and message plan caches refer to this set
+            internal::CacheGeneration::increment();
+        }
+
         /// \brief Add a new field codec (used for codecs operating on statically generated Protobuf messages, that is, children of google::protobuf::Message but not google::protobuf::Message itself).
         ///
         /// \tparam Codec A child of FieldCodecBase
@@ -59,7 +73,7 @@ namespace dccl
             boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_type> >
             >,
             void>::type 
-            static add(const std::string& name, compiler::dummy_fcm<0> dummy_fcm = 0);
+            add(const std::string& name, compiler::dummy_fcm<0> dummy_fcm = 0);
                 
         /// \brief Add a new field codec (used for codecs operating on all types except statically generated Protobuf messages).
         ///
@@ -72,7 +86,7 @@ namespace dccl
             boost::mpl::not_<boost::is_same<google::protobuf::Message,typename Codec::wire_type> >
             >,
             void>::type
-            static add(const std::string& name, compiler::dummy_fcm<1> dummy_fcm = 0);
+            add(const std::string& name, compiler::dummy_fcm<1> dummy_fcm = 0);
                 
         /// \brief Add a new field codec only valid for a specific google::protobuf::FieldDescriptor::Type. This is useful if a given codec is designed to work with only a specific Protobuf type that shares an underlying C++ type (e.g. Protobuf types `bytes` and `string`)
         ///
@@ -80,7 +94,7 @@ namespace dccl
         /// \tparam type The google::protobuf::FieldDescriptor::Type enumeration that this codec works on.
         /// \param name Name to use for this codec. Corresponds to (dccl.field).codec="name" in .proto file.
         template<class Codec, google::protobuf::FieldDescriptor::Type type>
-            static void add(const std::string& name);
+            void add(const std::string& name);
 
         /// \brief Remove a new field codec (used for codecs operating on statically generated Protobuf messages, that is, children of google::protobuf::Message but not google::protobuf::Message itself).
         ///
@@ -93,7 +107,7 @@ namespace dccl
             boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_type> >
             >,
             void>::type 
-            static remove(const std::string& name, compiler::dummy_fcm<0> dummy_fcm = 0);
+            remove(const std::string& name, compiler::dummy_fcm<0> dummy_fcm = 0);
                 
         /// \brief Remove a new field codec (used for codecs operating on all types except statically generated Protobuf messages).
         ///
@@ -106,7 +120,7 @@ namespace dccl
             boost::mpl::not_<boost::is_same<google::protobuf::Message,typename Codec::wire_type> >
             >,
             void>::type
-            static remove(const std::string& name, compiler::dummy_fcm<1> dummy_fcm = 0);
+            remove(const std::string& name, compiler::dummy_fcm<1> dummy_fcm = 0);
                 
         /// \brief Remove a new field codec only valid for a specific google::protobuf::FieldDescriptor::Type. This is useful if a given codec is designed to work with only a specific Protobuf type that shares an underlying C++ type (e.g. Protobuf types `bytes` and `string`)
         ///
@@ -114,71 +128,126 @@ namespace dccl
         /// \tparam type The google::protobuf::FieldDescriptor::Type enumeration that this codec works on.
         /// \param name Name to use for this codec. Corresponds to (dccl.field).codec="name" in .proto file.
         template<class Codec, google::protobuf::FieldDescriptor::Type type>
-            static void remove(const std::string& name);
+            void remove(const std::string& name);
 
         
         /// \brief Find the codec for a given field. For embedded messages, prefers (dccl.field).codec (inside field) over (dccl.msg).codec (inside embedded message).
-        static boost::shared_ptr<FieldCodecBase> find(
+        ///
+        /// The result is cached (per thread) by field, so repeated calls do not need to build and search for the codec name. The returned reference remains valid until the codec is removed (or clear() is called).
+        const boost::shared_ptr<FieldCodecBase>& find(
             const google::protobuf::FieldDescriptor* field,
             bool has_codec_group,
-            const std::string& codec_group)
+            const std::string& codec_group) const
         {
-            std::string name = __find_codec(field, has_codec_group, codec_group);            
+            check_generation();
+            const std::vector<FieldLookup>& lookups = field_lookups_[field];
+            for(std::vector<FieldLookup>::const_iterator it = lookups.begin(), end = lookups.end(); it != end; ++it)
+            {
+                if(it->manager == this && it->has_codec_group == has_codec_group && (!has_codec_group || it->codec_group == codec_group))
+                    return *it->codec;
+            }
             
+            std::string name = __find_codec(field, has_codec_group, codec_group);            
+
+            FieldLookup lookup;
+            lookup.manager = this;
+            lookup.has_codec_group = has_codec_group;
+            if(has_codec_group)
+                lookup.codec_group = codec_group;
             if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
-                return find(field->message_type(), name);
+                lookup.codec = &find(field->message_type(), name);
             else
-                return __find(field->type(), name);
+                lookup.codec = &__find(field->type(), name);
+
+            field_lookups_[field].push_back(lookup);
+            return *lookup.codec;
         }                
 
         /// \brief Find the codec for a given base (or embedded) message.
         ///
         /// \param desc Message descriptor to find codec for
         /// \param name Codec name (used for embedded messages to prefer the codec listed as a field option). Omit for finding the codec of a base message (one that is not embedded).
-        static boost::shared_ptr<FieldCodecBase> find(
+        ///
+        /// The result is cached (per thread) by message and name, as for find(const google::protobuf::FieldDescriptor*, bool, const std::string&).
+        const boost::shared_ptr<FieldCodecBase>& find(
             const google::protobuf::Descriptor* desc,
-            std::string name = "")
+            const std::string& name = "") const
         {
+            check_generation();
+            const std::vector<MessageLookup>& lookups = message_lookups_[desc];
+            for(std::vector<MessageLookup>::const_iterator it = lookups.begin(), end = lookups.end(); it != end; ++it)
+            {
+                if(it->manager == this && it->name == name)
+                    return *it->codec;
+            }
+
+            std::string codec_name = name;
             // this was called on the root message
-            if(name.empty())
+            if(codec_name.empty())
             {
                 // explicitly declared codec takes precedence over group
                 if(desc->options().GetExtension(dccl::msg).has_codec())
-                    name = desc->options().GetExtension(dccl::msg).codec();
+                    codec_name = desc->options().GetExtension(dccl::msg).codec();
                 else
-                    name = FieldCodecBase::codec_group(desc);
+                    codec_name = FieldCodecBase::codec_group(desc);
             }
-            
-            return __find(google::protobuf::FieldDescriptor::TYPE_MESSAGE,
-                          name, desc->full_name());
+
+            MessageLookup lookup;
+            lookup.manager = this;
+            lookup.name = name;
+            lookup.codec = &__find(google::protobuf::FieldDescriptor::TYPE_MESSAGE,
+                                   codec_name, desc->full_name());
+            message_lookups_[desc].push_back(lookup);
+            return *lookup.codec;
         }
 
-        static boost::shared_ptr<FieldCodecBase> find(
+        const boost::shared_ptr<FieldCodecBase>& find(
             google::protobuf::FieldDescriptor::Type type,
-            std::string name)
+            std::string name) const
         {
             return __find(type, name);
         }
 
-        static void clear()
+        /// \brief Remove all the codecs in this set (but not those of the fallback set)
+        void clear()
         {
-            internal::TypeHelper::reset();
             codecs_.clear();
+            internal::CacheGeneration::increment();
         }
-        
+
+        /// \brief The set of codecs used by the message codecs (and FieldCodecManager) in this thread: the one made current by the innermost ScopedCurrent (i.e. that of the Codec whose method is running), or FieldCodecManager::global() if there is none.
+        static FieldCodecManagerLocal& current();
+
+        /// \brief Makes a set of codecs current() in this thread for the lifetime of this object
+        class ScopedCurrent
+        {
+          public:
+            explicit ScopedCurrent(FieldCodecManagerLocal* manager) : previous_(current_)
+            { current_ = manager; }
+            ~ScopedCurrent() { current_ = previous_; }
+
+          private:
+            ScopedCurrent(const ScopedCurrent&);
+            ScopedCurrent& operator=(const ScopedCurrent&);
+
+            FieldCodecManagerLocal* previous_;
+        };
         
       private:
-        FieldCodecManager() { }
-        ~FieldCodecManager() { }
-        FieldCodecManager(const FieldCodecManager&);
-        FieldCodecManager& operator= (const FieldCodecManager&);
+        FieldCodecManagerLocal(const FieldCodecManagerLocal&);
+        FieldCodecManagerLocal& operator= (const FieldCodecManagerLocal&);
 
-                
-            
-        static boost::shared_ptr<FieldCodecBase> __find(
+        // searches this set and then the fallback set(s), throwing if the codec is not found
+        const boost::shared_ptr<FieldCodecBase>& __find(
+            google::protobuf::FieldDescriptor::Type type,
+            const std::string& codec_name,
+            const std::string& type_name = "") const;
+
+        // searches only this set, returning null if the codec is not found
+        const boost::shared_ptr<FieldCodecBase>* __find_local(
             google::protobuf::FieldDescriptor::Type type,
             const std::string& codec_name,
-            const std::string& type_name = "");
+            const std::string& type_name) const;
             
         static std::string __mangle_name(const std::string& codec_name,
                                          const std::string& type_name) 
@@ -186,26 +255,26 @@ namespace dccl
                 
 
         template<typename WireType, typename FieldType, class Codec> 
-            static void add_all_types(const std::string& name); 
+            void add_all_types(const std::string& name); 
 
         template<class Codec>
-            static void add_single_type(const std::string& name,
-                                        google::protobuf::FieldDescriptor::Type field_type,
-                                        google::protobuf::FieldDescriptor::CppType wire_type);
+            void add_single_type(const std::string& name,
+                                 google::protobuf::FieldDescriptor::Type field_type,
+                                 google::protobuf::FieldDescriptor::CppType wire_type);
         
         template<typename WireType, typename FieldType, class Codec> 
-            static void remove_all_types(const std::string& name); 
+            void remove_all_types(const std::string& name); 
 
         template<class Codec>
-            static void remove_single_type(const std::string& name,
-                                        google::protobuf::FieldDescriptor::Type field_type,
-                                        google::protobuf::FieldDescriptor::CppType wire_type);
+            void remove_single_type(const std::string& name,
+                                    google::protobuf::FieldDescriptor::Type field_type,
+                                    google::protobuf::FieldDescriptor::CppType wire_type);
 
         
         static std::string __find_codec(const google::protobuf::FieldDescriptor* field,
                                         bool has_codec_group, const std::string& codec_group)
         {
-            dccl::DCCLFieldOptions dccl_field_options = field->options().GetExtension(dccl::field);
+            const dccl::DCCLFieldOptions& dccl_field_options = internal::FieldOptionsCache::find(field);
                 
             // prefer the codec listed as a field extension
             if(dccl_field_options.has_codec())
@@ -221,9 +290,112 @@ namespace dccl
                 return dccl_field_options.codec();
         }
 
+        // empties the lookup caches if the codecs have changed since they were filled
+        static void check_generation()
+        {
+            if(lookup_generation_ != internal::CacheGeneration::current())
+            {
+                field_lookups_.clear();
+                message_lookups_.clear();
+                lookup_generation_ = internal::CacheGeneration::current();
+            }
+        }
+
       private:
         typedef std::map<std::string, boost::shared_ptr<FieldCodecBase> > InsideMap;
-        static std::map<google::protobuf::FieldDescriptor::Type, InsideMap> codecs_;
+        std::map<google::protobuf::FieldDescriptor::Type, InsideMap> codecs_;
+
+        const FieldCodecManagerLocal* fallback_;
+
+        static thread_local FieldCodecManagerLocal* current_;
+
+        // results of find() for a given field / message; codec points into the codecs_ of
+        // manager (or its fallback), whose entries are not erased without incrementing the CacheGeneration
+        struct FieldLookup
+        {
+            const FieldCodecManagerLocal* manager;
+            bool has_codec_group;
+            std::string codec_group;
+            const boost::shared_ptr<FieldCodecBase>* codec;
+        };
+        struct MessageLookup
+        {
+            const FieldCodecManagerLocal* manager;
+            std::string name;
+            const boost::shared_ptr<FieldCodecBase>* codec;
+        };
+        static thread_local std::unordered_map<const google::protobuf::FieldDescriptor*, std::vector<FieldLookup> > field_lookups_;
+        static thread_local std::unordered_map<const google::protobuf::Descriptor*, std::vector<MessageLookup> > message_lookups_;
+        static thread_local unsigned lookup_generation_;
+    };
+
+    /// \brief Static interface to the field codecs: add() and remove() modify the set of codecs of the Codec that is currently loading a codec library (see Codec::load_library), or otherwise the process-wide set that every Codec falls back to; find() searches the codecs of the Codec whose method is running in this thread (see FieldCodecManagerLocal::current()).
+    class FieldCodecManager
+    {
+      public:
+        /// \brief Add a new field codec. See FieldCodecManagerLocal::add.
+        ///
+        /// \tparam Codec A child of FieldCodecBase
+        /// \param name Name to use for this codec. Corresponds to (dccl.field).codec="name" in .proto file.
+        template<class Codec>
+            static void add(const std::string& name)
+        { FieldCodecManagerLocal::current().add<Codec>(name); }
+
+        /// \brief Add a new field codec only valid for a specific google::protobuf::FieldDescriptor::Type. See FieldCodecManagerLocal::add.
+        ///
+        /// \tparam Codec A child of FieldCodecBase
+        /// \tparam type The google::protobuf::FieldDescriptor::Type enumeration that this codec works on.
+        /// \param name Name to use for this codec. Corresponds to (dccl.field).codec="name" in .proto file.
+        template<class Codec, google::protobuf::FieldDescriptor::Type type>
+            static void add(const std::string& name)
+        { FieldCodecManagerLocal::current().add<Codec, type>(name); }
+
+        /// \brief Remove a field codec. See FieldCodecManagerLocal::remove.
+        template<class Codec>
+            static void remove(const std::string& name)
+        { FieldCodecManagerLocal::current().remove<Codec>(name); }
+
+        /// \brief Remove a field codec only valid for a specific google::protobuf::FieldDescriptor::Type. See FieldCodecManagerLocal::remove.
+        template<class Codec, google::protobuf::FieldDescriptor::Type type>
+            static void remove(const std::string& name)
+        { FieldCodecManagerLocal::current().remove<Codec, type>(name); }
+        
+        /// \brief Find the codec for a given field. For embedded messages, prefers (dccl.field).codec (inside field) over (dccl.msg).codec (inside embedded message).
+        static const boost::shared_ptr<FieldCodecBase>& find(
+            const google::protobuf::FieldDescriptor* field,
+            bool has_codec_group,
+            const std::string& codec_group)
+        { return FieldCodecManagerLocal::current().find(field, has_codec_group, codec_group); }
+
+        /// \brief Find the codec for a given base (or embedded) message.
+        ///
+        /// \param desc Message descriptor to find codec for
+        /// \param name Codec name (used for embedded messages to prefer the codec listed as a field option). Omit for finding the codec of a base message (one that is not embedded).
+        static const boost::shared_ptr<FieldCodecBase>& find(
+            const google::protobuf::Descriptor* desc,
+            const std::string& name = "")
+        { return FieldCodecManagerLocal::current().find(desc, name); }
+
+        static const boost::shared_ptr<FieldCodecBase>& find(
+            google::protobuf::FieldDescriptor::Type type,
+            std::string name)
+        { return FieldCodecManagerLocal::current().find(type, name); }
+
+        /// \brief Remove all codecs from the process-wide set (including the defaults)
+        static void clear()
+        {
+            internal::TypeHelper::reset();
+            global().clear();
+        }
+
+        /// \brief The process-wide set of codecs, which holds the default codecs and is the fallback of the set owned by each Codec
+        static FieldCodecManagerLocal& global();
+        
+      private:
+        FieldCodecManager() { }
+        ~FieldCodecManager() { }
+        FieldCodecManager(const FieldCodecManager&);
+        FieldCodecManager& operator= (const FieldCodecManager&);
     };
 }
 
@@ -234,7 +406,7 @@ boost::is_base_of<google::protobuf::Message, typename Codec::wire_type>,
 boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_type> >
 >,
 void>::type 
-    dccl::FieldCodecManager::add(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
+    dccl::FieldCodecManagerLocal::add(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
 {
     internal::TypeHelper::add<typename Codec::wire_type>();
     add_single_type<Codec>(__mangle_name(name, Codec::wire_type::descriptor()->full_name()),
@@ -249,20 +421,20 @@ boost::is_base_of<google::protobuf::Message, typename Codec::wire_type>,
     boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_type> >
     >,
     void>::type
-    dccl::FieldCodecManager::add(const std::string& name, compiler::dummy_fcm<1> dummy_fcm)
+    dccl::FieldCodecManagerLocal::add(const std::string& name, compiler::dummy_fcm<1> dummy_fcm)
 {
     add_all_types<typename Codec::wire_type, typename Codec::field_type, Codec>(name);
 }
 
 template<class Codec, google::protobuf::FieldDescriptor::Type type> 
-    void dccl::FieldCodecManager::add(const std::string& name) 
+    void dccl::FieldCodecManagerLocal::add(const std::string& name) 
 { 
     add_single_type<Codec>(name, type, google::protobuf::FieldDescriptor::TypeToCppType(type));
 }
 
 
 template<typename WireType, typename FieldType, class Codec>
-    void dccl::FieldCodecManager::add_all_types(const std::string& name)
+    void dccl::FieldCodecManagerLocal::add_all_types(const std::string& name)
 {
     using google::protobuf::FieldDescriptor;
     const FieldDescriptor::CppType cpp_field_type = internal::ToProtoCppType<FieldType>::as_enum();
@@ -279,7 +451,7 @@ template<typename WireType, typename FieldType, class Codec>
 }
 
 template<class Codec>
-void dccl::FieldCodecManager::add_single_type(const std::string& name,
+void dccl::FieldCodecManagerLocal::add_single_type(const std::string& name,
                                               google::protobuf::FieldDescriptor::Type field_type,
                                               google::protobuf::FieldDescriptor::CppType wire_type)
 {
@@ -292,6 +464,7 @@ void dccl::FieldCodecManager::add_single_type(const std::string& name,
         new_field_codec->set_wire_type(wire_type);
         
         codecs_[field_type][name] = new_field_codec;
+        internal::CacheGeneration::increment();
         dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Adding codec " << *new_field_codec << std::endl;
     }            
     else
@@ -317,9 +490,11 @@ boost::is_base_of<google::protobuf::Message, typename Codec::wire_type>,
 boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_type> >
 >,
 void>::type 
-    dccl::FieldCodecManager::remove(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
+    dccl::FieldCodecManagerLocal::remove(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
 {
-    internal::TypeHelper::remove<typename Codec::wire_type>();
+    // the type helpers are shared, so only the process-wide set removes them
+    if(!fallback_)
+        internal::TypeHelper::remove<typename Codec::wire_type>();
     remove_single_type<Codec>(__mangle_name(name, Codec::wire_type::descriptor()->full_name()),
                               google::protobuf::FieldDescriptor::TYPE_MESSAGE,
                               google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
@@ -332,20 +507,20 @@ boost::is_base_of<google::protobuf::Message, typename Codec::wire_type>,
     boost::mpl::not_<boost::is_same<google::protobuf::Message, typename Codec::wire_type> >
     >,
     void>::type
-    dccl::FieldCodecManager::remove(const std::string& name, compiler::dummy_fcm<1> dummy_fcm)
+    dccl::FieldCodecManagerLocal::remove(const std::string& name, compiler::dummy_fcm<1> dummy_fcm)
 {
     remove_all_types<typename Codec::wire_type, typename Codec::field_type, Codec>(name);
 }
 
 template<class Codec, google::protobuf::FieldDescriptor::Type type> 
-    void dccl::FieldCodecManager::remove(const std::string& name) 
+    void dccl::FieldCodecManagerLocal::remove(const std::string& name) 
 { 
     remove_single_type<Codec>(name, type, google::protobuf::FieldDescriptor::TypeToCppType(type));
 }
 
 
 template<typename WireType, typename FieldType, class Codec>
-    void dccl::FieldCodecManager::remove_all_types(const std::string& name)
+    void dccl::FieldCodecManagerLocal::remove_all_types(const std::string& name)
 {
     using google::protobuf::FieldDescriptor;
     const FieldDescriptor::CppType cpp_field_type = internal::ToProtoCppType<FieldType>::as_enum();
@@ -362,7 +537,7 @@ template<typename WireType, typename FieldType, class Codec>
 }
 
 template<class Codec>
-void dccl::FieldCodecManager::remove_single_type(const std::string& name,
+void dccl::FieldCodecManagerLocal::remove_single_type(const std::string& name,
                                               google::protobuf::FieldDescriptor::Type field_type,
                                               google::protobuf::FieldDescriptor::CppType wire_type)
 {
@@ -371,6 +546,7 @@ void dccl::FieldCodecManager::remove_single_type(const std::string& name,
     {       
         dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Removing codec " << *codecs_[field_type][name]  << std::endl;
         codecs_[field_type].erase(name);
+        internal::CacheGeneration::increment();
     }            
     else
     {
@@ -23,6 +23,8 @@
 #define DCCLFIELDCODECTYPED20120312H
 
 
+#include <algorithm>
+
 #include <boost/type_traits.hpp>
 
 #include "field_codec.h"
@@ -114,7 +116,108 @@ typedef WireType wire_type;
       /// \param wire_value Value to use when calculating the size of the field. If calculating the size requires encoding the field completely, cache the encoded value for a likely future call to encode() for the same wire_value.
       /// \return the size (in bits) of the field.
       virtual unsigned size(const WireType& wire_value) = 0;
+
+      /// \brief Encode an empty field directly to a BitWriter cursor. The default implementation writes the result of encode(); override both encode_to() methods to avoid the intermediate Bitset.
+      ///
+      /// \param writer Cursor to write the encoded field to.
+      virtual void encode_to(BitWriter* writer)
+      { writer->write(encode()); }
+
+      /// \brief Encode a non-empty field directly to a BitWriter cursor. The default implementation writes the result of encode(const WireType&).
+      ///
+      /// \param writer Cursor to write the encoded field to.
+      /// \param wire_value Value to encode.
+      virtual void encode_to(BitWriter* writer, const WireType& wire_value)
+      { writer->write(encode(wire_value)); }
+
+      /// \brief Decode a field directly from a BitReader cursor. If the field is empty, throw NullValueException (the reader must still be advanced past the field). The default implementation calls decode(Bitset*) using the unread bits of `reader` as the parent Bitset.
+      ///
+      /// \param reader Cursor to read the bits from.
+      /// \return the decoded value.
+      virtual WireType decode_from(BitReader* reader)
+      {
+          BitReaderPool pool(reader);
+          Bitset bits(pool.bits());
+          bits.get_more_bits(this->min_size());
+          return decode(&bits);
+      }
           
+      protected:
+      /// \brief Encode the values of a repeated field all at once, directly to a BitWriter cursor. This is only called for fields without omit_if, min or max dynamic conditions (i.e. when every element is encoded, with the same bounds). The default implementation returns false so that each element is encoded separately with encode_to(); override this to process whole arrays at a time.
+      ///
+      /// \param writer Cursor to write the encoded values to.
+      /// \param wire_values Values to encode (the pre-encoded field values).
+      /// \param wire_vector_size Number of elements to encode. Elements past the end of `wire_values` are encoded as empty.
+      /// \return true if the values were encoded, false to fall back on encode_to() for each element (in which case nothing may have been written).
+      virtual bool encode_repeated_values_to(BitWriter* writer, const std::vector<WireType>& wire_values,
+                                             unsigned wire_vector_size)
+      { return false; }
+
+      /// \brief Decode the values of a repeated field all at once, directly from a BitReader cursor. This is only called for fields without omit_if, min or max dynamic conditions. The default implementation returns false so that each element is decoded separately with decode_from().
+      ///
+      /// \param reader Cursor to read the encoded values from.
+      /// \param wire_values Decoded values (already sized to the number of elements to decode).
+      /// \param decoded Set to false for each element that is empty (false for all on entry).
+      /// \return true if the values were decoded, false to fall back on decode_from() for each element (in which case nothing may have been read).
+      virtual bool decode_repeated_values_from(BitReader* reader, std::vector<WireType>* wire_values,
+                                               std::vector<bool>* decoded)
+      { return false; }
+
+      // true if the elements of the repeated field can be passed to encode_repeated_values_to() and
+      // decode_repeated_values_from() together, i.e. none are omitted and they all have the same bounds
+      bool bulk_repeated_field()
+      {
+          DynamicConditions& dc = this->dynamic_conditions(this->this_field());
+          return !dc.has_omit_if() && !dc.has_min() && !dc.has_max();
+      }
+
+      // true if field is a repeated field of FieldType
+      template<typename T>
+      static bool is_typed_repeated_field(const google::protobuf::FieldDescriptor* field)
+      { return field->is_repeated() && field->cpp_type() == internal::ToProtoCppType<T>::as_enum(); }
+
+      // fills *wire_values with the pre-encoded values of the repeated field, returning false if
+      // any of them is null (these are left to the boost::any implementation, which encodes them as empty)
+      template<typename T>
+      bool typed_pre_encode_repeated(std::vector<WireType>* wire_values,
+                                     const google::protobuf::Message& msg,
+                                     const google::protobuf::FieldDescriptor* field)
+      {
+          wire_values->reserve(msg.GetReflection()->FieldSize(msg, field));
+          try
+          {
+              internal::CppTypeReflection<T>::for_each_repeated(
+                  msg, field, [this, wire_values](const T& field_value)
+                  { wire_values->push_back(this->pre_encode(field_value)); });
+              return true;
+          }
+          catch(NullValueException&)
+          {
+              return false;
+          }
+      }
+
+      // adds the post-decoded (non-null) wire_values to the repeated field
+      template<typename T>
+      void typed_post_decode_repeated(const std::vector<WireType>& wire_values,
+                                      const std::vector<bool>& decoded,
+                                      google::protobuf::Message* msg,
+                                      const google::protobuf::FieldDescriptor* field)
+      {
+          typedef internal::CppTypeReflection<T> FieldReflection;
+          const typename FieldReflection::mutable_repeated_type field_values =
+              FieldReflection::mutable_repeated(msg, field, std::count(decoded.begin(), decoded.end(), true));
+          for(int i = 0, n = wire_values.size(); i < n; ++i)
+          {
+              if(!decoded[i])
+                  continue;
+              try
+              { FieldReflection::add_repeated(field_values, this->post_decode(wire_values[i])); }
+              catch(NullValueException&)
+              { }
+          }
+      }
+
       private:
       unsigned any_size(const boost::any& wire_value)
       {
@@ -137,6 +240,34 @@ typedef WireType wire_type;
           any_decode_specific<WireType>(bits, wire_value);
       }
 
+      void any_encode_to(BitWriter* writer, const boost::any& wire_value)
+      {
+          try
+          {
+              if(wire_value.empty())
+                  encode_to(writer);
+              else
+                  encode_to(writer, boost::any_cast<WireType>(wire_value));
+          }
+          catch(boost::bad_any_cast&)
+          { throw(type_error("encode", typeid(WireType), wire_value.type())); }
+      }
+
+      void any_decode_from(BitReader* reader, boost::any* wire_value)
+      {
+          any_decode_from_specific<WireType>(reader, wire_value);
+      }
+
+      void any_encode_repeated_to(BitWriter* writer, const std::vector<boost::any>& wire_values)
+      {
+          this->encode_repeated_elements(writer, wire_values);
+      }
+
+      void any_decode_repeated_from(BitReader* reader, std::vector<boost::any>* wire_values)
+      {
+          this->decode_repeated_elements(reader, wire_values);
+      }
+
 
 
       void any_pre_encode(boost::any* wire_value,
@@ -164,6 +295,313 @@ typedef WireType wire_type;
       }
 
 
+      // statically typed versions of the boost::any functions above, for fields whose type has a
+      // CppTypeReflection (i.e. all but message fields)
+      bool typed_encode(Bitset* bits, const google::protobuf::Message& msg,
+                        const google::protobuf::FieldDescriptor* field)
+      { return typed_encode_specific<FieldType>(bits, msg, field); }
+
+      bool typed_encode_to(BitWriter* writer, const google::protobuf::Message& msg,
+                           const google::protobuf::FieldDescriptor* field)
+      { return typed_encode_to_specific<FieldType>(writer, msg, field); }
+
+      bool typed_size(unsigned* bit_size, const google::protobuf::Message& msg,
+                      const google::protobuf::FieldDescriptor* field)
+      { return typed_size_specific<FieldType>(bit_size, msg, field); }
+
+      bool typed_decode(Bitset* bits, google::protobuf::Message* msg,
+                        const google::protobuf::FieldDescriptor* field)
+      { return typed_decode_specific<FieldType>(bits, msg, field); }
+
+      bool typed_decode_from(BitReader* reader, google::protobuf::Message* msg,
+                             const google::protobuf::FieldDescriptor* field)
+      { return typed_decode_from_specific<FieldType>(reader, msg, field); }
+
+      bool typed_encode_repeated_to(BitWriter* writer, const google::protobuf::Message& msg,
+                                    const google::protobuf::FieldDescriptor* field)
+      { return typed_encode_repeated_to_specific<FieldType>(writer, msg, field); }
+
+      bool typed_size_repeated(unsigned* bit_size, const google::protobuf::Message& msg,
+                               const google::protobuf::FieldDescriptor* field)
+      { return typed_size_repeated_specific<FieldType>(bit_size, msg, field); }
+
+      bool typed_decode_repeated(Bitset* bits, google::protobuf::Message* msg,
+                                 const google::protobuf::FieldDescriptor* field)
+      { return typed_decode_repeated_specific<FieldType>(bits, msg, field); }
+
+      bool typed_decode_repeated_from(BitReader* reader, google::protobuf::Message* msg,
+                                      const google::protobuf::FieldDescriptor* field)
+      { return typed_decode_repeated_from_specific<FieldType>(reader, msg, field); }
+
+      // true if field is a singular field of FieldType
+      template<typename T>
+      static bool is_typed_field(const google::protobuf::FieldDescriptor* field)
+      { return !field->is_repeated() && field->cpp_type() == internal::ToProtoCppType<T>::as_enum(); }
+
+      // sets *wire_value to the pre-encoded value of the field, returning false if it is empty
+      template<typename T>
+      bool typed_pre_encode(WireType* wire_value, const google::protobuf::Message& msg,
+                            const google::protobuf::FieldDescriptor* field)
+      {
+          if(!msg.GetReflection()->HasField(msg, field))
+              return false;
+
+          try
+          {
+              *wire_value = this->pre_encode(internal::CppTypeReflection<T>::get(msg, field));
+              return true;
+          }
+          catch(NullValueException&)
+          {
+              return false;
+          }
+      }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_repeated_to_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_repeated_field<T>(field))
+              return false;
+
+          std::vector<WireType> wire_values;
+          if(!typed_pre_encode_repeated<T>(&wire_values, msg, field))
+              return false;
+
+          const unsigned wire_vector_size = this->encode_repeated_size(writer, wire_values.size());
+          if(bulk_repeated_field() && encode_repeated_values_to(writer, wire_values, wire_vector_size))
+              return true;
+
+          internal::MessageStack msg_handler(this->this_field());
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              if(this->omit_repeated_element(&msg_handler, i))
+                  continue;
+
+              if(i < wire_values.size())
+                  encode_to(writer, wire_values[i]);
+              else
+                  encode_to(writer);
+          }
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_repeated_to_specific(BitWriter*, const google::protobuf::Message&,
+                                        const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_size_repeated_specific(unsigned* bit_size, const google::protobuf::Message& msg,
+                                   const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_repeated_field<T>(field))
+              return false;
+
+          std::vector<WireType> wire_values;
+          if(!typed_pre_encode_repeated<T>(&wire_values, msg, field))
+              return false;
+
+          unsigned out = 0;
+          const unsigned wire_vector_size = this->size_repeated_size(&out, wire_values.size());
+          internal::MessageStack msg_handler(this->this_field());
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              if(this->omit_repeated_element(&msg_handler, i))
+                  continue;
+
+              out += (i < wire_values.size()) ? size(wire_values[i]) : size();
+          }
+          *bit_size += out;
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_size_repeated_specific(unsigned*, const google::protobuf::Message&,
+                                   const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_specific(Bitset* bits, google::protobuf::Message* msg,
+                                     const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_repeated_field<T>(field))
+              return false;
+
+          const unsigned wire_vector_size = this->decode_repeated_size(bits);
+          std::vector<WireType> wire_values(wire_vector_size);
+          std::vector<bool> decoded(wire_vector_size, false);
+          internal::MessageStack msg_handler(this->this_field());
+          for(unsigned i = 0; i < wire_vector_size; ++i)
+          {
+              if(this->omit_repeated_element(&msg_handler, i))
+                  continue;
+
+              Bitset these_bits(bits);
+              these_bits.get_more_bits(this->min_size());
+              try
+              {
+                  wire_values[i] = decode(&these_bits);
+                  decoded[i] = true;
+              }
+              catch(NullValueException&)
+              { }
+          }
+          typed_post_decode_repeated<T>(wire_values, decoded, msg, field);
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_specific(Bitset*, google::protobuf::Message*,
+                                     const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_from_specific(BitReader* reader, google::protobuf::Message* msg,
+                                          const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_repeated_field<T>(field))
+              return false;
+
+          const unsigned wire_vector_size = this->decode_repeated_size(reader);
+          std::vector<WireType> wire_values(wire_vector_size);
+          std::vector<bool> decoded(wire_vector_size, false);
+          if(!bulk_repeated_field() || !decode_repeated_values_from(reader, &wire_values, &decoded))
+          {
+              internal::MessageStack msg_handler(this->this_field());
+              for(unsigned i = 0; i < wire_vector_size; ++i)
+              {
+                  if(this->omit_repeated_element(&msg_handler, i))
+                      continue;
+
+                  try
+                  {
+                      wire_values[i] = decode_from(reader);
+                      decoded[i] = true;
+                  }
+                  catch(NullValueException&)
+                  { }
+              }
+          }
+          typed_post_decode_repeated<T>(wire_values, decoded, msg, field);
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_from_specific(BitReader*, google::protobuf::Message*,
+                                          const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_specific(Bitset* bits, const google::protobuf::Message& msg,
+                            const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_field<T>(field))
+              return false;
+
+          WireType wire_value = WireType();
+          *bits = typed_pre_encode<T>(&wire_value, msg, field) ? encode(wire_value) : encode();
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_specific(Bitset*, const google::protobuf::Message&,
+                            const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_to_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                               const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_field<T>(field))
+              return false;
+
+          WireType wire_value = WireType();
+          if(typed_pre_encode<T>(&wire_value, msg, field))
+              encode_to(writer, wire_value);
+          else
+              encode_to(writer);
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_to_specific(BitWriter*, const google::protobuf::Message&,
+                               const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_size_specific(unsigned* bit_size, const google::protobuf::Message& msg,
+                          const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_field<T>(field))
+              return false;
+
+          WireType wire_value = WireType();
+          *bit_size += typed_pre_encode<T>(&wire_value, msg, field) ? size(wire_value) : size();
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_size_specific(unsigned*, const google::protobuf::Message&,
+                          const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_specific(Bitset* bits, google::protobuf::Message* msg,
+                            const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_field<T>(field))
+              return false;
+
+          try
+          { internal::CppTypeReflection<T>::set(msg, field, this->post_decode(decode(bits))); }
+          catch(NullValueException&)
+          { }
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_specific(Bitset*, google::protobuf::Message*,
+                            const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_from_specific(BitReader* reader, google::protobuf::Message* msg,
+                                 const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!is_typed_field<T>(field))
+              return false;
+
+          try
+          { internal::CppTypeReflection<T>::set(msg, field, this->post_decode(decode_from(reader))); }
+          catch(NullValueException&)
+          { }
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_from_specific(BitReader*, google::protobuf::Message*,
+                                 const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
       // we don't currently support type conversion (post_decode / pre_encode) of Message types
       template<typename T>
       typename boost::enable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
@@ -215,6 +653,32 @@ typedef WireType wire_type;
           catch(NullValueException&)
           { *wire_value = boost::any(); }              
       }
+
+      template<typename T>
+      typename boost::enable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
+      any_decode_from_specific(BitReader* reader, boost::any* wire_value, compiler::dummy<0> dummy = 0)
+      {
+          try
+          {
+              google::protobuf::Message* msg = boost::any_cast<google::protobuf::Message* >(*wire_value);  
+              msg->CopyFrom(decode_from(reader));
+          }
+          catch(NullValueException&)
+          {
+              if(FieldCodecBase::this_field())
+                  *wire_value = boost::any();
+          }              
+      }
+          
+      template<typename T>
+      typename boost::disable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
+      any_decode_from_specific(BitReader* reader, boost::any* wire_value, compiler::dummy<1> dummy = 0)
+      {
+          try
+          { *wire_value = decode_from(reader); }
+          catch(NullValueException&)
+          { *wire_value = boost::any(); }              
+      }
     
     };
 
@@ -317,6 +781,115 @@ typedef WireType wire_type;
           any_decode_repeated_specific<WireType>(repeated_bits, field_values);
       }
 
+      // repeated fields are encoded as a whole by encode_repeated() / decode_repeated(),
+      // so use the Bitset based implementations for the cursor API as well
+      void any_encode_repeated_to(BitWriter* writer, const std::vector<boost::any>& wire_values)
+      {
+          FieldCodecBase::any_encode_repeated_to(writer, wire_values);
+      }
+
+      void any_decode_repeated_from(BitReader* reader, std::vector<boost::any>* wire_values)
+      {
+          FieldCodecBase::any_decode_repeated_from(reader, wire_values);
+      }
+
+      // typed versions of the above, which give the whole array to encode_repeated() / decode_repeated()
+      bool typed_encode_repeated_to(BitWriter* writer, const google::protobuf::Message& msg,
+                                    const google::protobuf::FieldDescriptor* field)
+      { return typed_encode_repeated_to_specific<FieldType>(writer, msg, field); }
+
+      bool typed_size_repeated(unsigned* bit_size, const google::protobuf::Message& msg,
+                               const google::protobuf::FieldDescriptor* field)
+      { return typed_size_repeated_specific<FieldType>(bit_size, msg, field); }
+
+      bool typed_decode_repeated(Bitset* bits, google::protobuf::Message* msg,
+                                 const google::protobuf::FieldDescriptor* field)
+      { return typed_decode_repeated_specific<FieldType>(bits, msg, field); }
+
+      bool typed_decode_repeated_from(BitReader* reader, google::protobuf::Message* msg,
+                                      const google::protobuf::FieldDescriptor* field)
+      { return typed_decode_repeated_from_specific<FieldType>(reader, msg, field); }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_repeated_to_specific(BitWriter* writer, const google::protobuf::Message& msg,
+                                        const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          std::vector<WireType> wire_values;
+          if(!this->template is_typed_repeated_field<T>(field) ||
+             !this->template typed_pre_encode_repeated<T>(&wire_values, msg, field))
+              return false;
+
+          writer->write(encode_repeated(wire_values));
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_encode_repeated_to_specific(BitWriter*, const google::protobuf::Message&,
+                                        const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_size_repeated_specific(unsigned* bit_size, const google::protobuf::Message& msg,
+                                   const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          std::vector<WireType> wire_values;
+          if(!this->template is_typed_repeated_field<T>(field) ||
+             !this->template typed_pre_encode_repeated<T>(&wire_values, msg, field))
+              return false;
+
+          *bit_size += size_repeated(wire_values);
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_size_repeated_specific(unsigned*, const google::protobuf::Message&,
+                                   const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_specific(Bitset* bits, google::protobuf::Message* msg,
+                                     const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!this->template is_typed_repeated_field<T>(field))
+              return false;
+
+          std::vector<WireType> wire_values = decode_repeated(bits);
+          this->template typed_post_decode_repeated<T>(
+              wire_values, std::vector<bool>(wire_values.size(), true), msg, field);
+          return true;
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_specific(Bitset*, google::protobuf::Message*,
+                                     const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_from_specific(BitReader* reader, google::protobuf::Message* msg,
+                                          const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      {
+          if(!this->template is_typed_repeated_field<T>(field))
+              return false;
+
+          BitReaderPool pool(reader);
+          Bitset these_bits(pool.bits());
+          these_bits.get_more_bits(min_size_repeated());
+          return typed_decode_repeated_specific<T>(&these_bits, msg, field);
+      }
+
+      template<typename T>
+      typename boost::disable_if_c<internal::CppTypeReflection<T>::value, bool>::type
+      typed_decode_repeated_from_specific(BitReader*, google::protobuf::Message*,
+                                          const google::protobuf::FieldDescriptor*, compiler::dummy<1> dummy = 0)
+      { return false; }
+
       template<typename T>
       typename boost::enable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
       any_decode_repeated_specific(Bitset* repeated_bits, std::vector<boost::any>* wire_values, compiler::dummy<0> dummy = 0)
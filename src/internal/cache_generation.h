@@ -0,0 +1,49 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLCACHEGENERATION20261017H
+#define DCCLCACHEGENERATION20261017H
+
+#include <atomic>
+
+namespace dccl
+{
+namespace internal
+{
+/// \brief Counter that is incremented whenever the set of field codecs changes (FieldCodecManagerLocal::add / remove / clear, or one is destroyed) or a message is unloaded. Caches derived from the message schemas and the codecs compare against it to know when they must be rebuilt.
+class CacheGeneration
+{
+  public:
+    static unsigned current() { return generation().load(std::memory_order_acquire); }
+    static void increment() { generation().fetch_add(1, std::memory_order_acq_rel); }
+
+  private:
+    // shared by all threads (each of which keeps its own caches)
+    static std::atomic<unsigned>& generation()
+    {
+        static std::atomic<unsigned> generation_(0);
+        return generation_;
+    }
+};
+} // namespace internal
+} // namespace dccl
+
+#endif
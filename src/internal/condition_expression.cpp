@@ -0,0 +1,677 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+#include "condition_expression.h"
+
+using dccl::internal::ConditionExpression;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+
+namespace
+{
+// integers up to this magnitude are represented exactly by a double (and so behave as the Lua integers do)
+const double max_exact_integer = 9007199254740992.0; // 2^53
+
+bool is_integer(double x) { return std::floor(x) == x && std::abs(x) <= max_exact_integer; }
+
+void set_nil(ConditionExpression::Value* v) { v->type = ConditionExpression::Value::NIL; }
+
+void set_boolean(ConditionExpression::Value* v, bool b)
+{
+    v->type = ConditionExpression::Value::BOOLEAN;
+    v->boolean = b;
+}
+
+void set_number(ConditionExpression::Value* v, double x)
+{
+    v->type = ConditionExpression::Value::NUMBER;
+    v->number = x;
+}
+
+void set_message(ConditionExpression::Value* v, const Message* msg,
+                 const FieldDescriptor* repeated_field = nullptr)
+{
+    v->type = repeated_field ? ConditionExpression::Value::REPEATED
+                             : ConditionExpression::Value::MESSAGE;
+    v->msg = msg;
+    v->repeated_field = repeated_field;
+}
+
+// 64-bit values that a double cannot represent exactly are left to Lua
+template <typename Int> bool set_integer(ConditionExpression::Value* v, Int x)
+{
+    const double d = static_cast<double>(x);
+    if (std::abs(d) > max_exact_integer)
+        return false;
+    set_number(v, d);
+    return true;
+}
+
+// value of field (or its index-th value, if repeated) in msg, as seen by Lua
+bool field_value(const Message& msg, const FieldDescriptor* field, int index,
+                 ConditionExpression::Value* v)
+{
+    const google::protobuf::Reflection* refl = msg.GetReflection();
+    const bool repeated = field->is_repeated();
+    switch (field->cpp_type())
+    {
+        case FieldDescriptor::CPPTYPE_INT32:
+            set_number(v, repeated ? refl->GetRepeatedInt32(msg, field, index)
+                                   : refl->GetInt32(msg, field));
+            return true;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            set_number(v, repeated ? refl->GetRepeatedUInt32(msg, field, index)
+                                   : refl->GetUInt32(msg, field));
+            return true;
+        case FieldDescriptor::CPPTYPE_INT64:
+            return set_integer(v, repeated ? refl->GetRepeatedInt64(msg, field, index)
+                                           : refl->GetInt64(msg, field));
+        case FieldDescriptor::CPPTYPE_UINT64:
+            return set_integer(v, repeated ? refl->GetRepeatedUInt64(msg, field, index)
+                                           : refl->GetUInt64(msg, field));
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            set_number(v, repeated ? refl->GetRepeatedDouble(msg, field, index)
+                                   : refl->GetDouble(msg, field));
+            return true;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            set_number(v, repeated ? refl->GetRepeatedFloat(msg, field, index)
+                                   : refl->GetFloat(msg, field));
+            return true;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            set_boolean(v, repeated ? refl->GetRepeatedBool(msg, field, index)
+                                    : refl->GetBool(msg, field));
+            return true;
+        case FieldDescriptor::CPPTYPE_STRING:
+            v->type = ConditionExpression::Value::STRING;
+            v->str = repeated ? refl->GetRepeatedString(msg, field, index)
+                              : refl->GetString(msg, field);
+            return true;
+        case FieldDescriptor::CPPTYPE_ENUM:
+            v->type = ConditionExpression::Value::STRING;
+            v->str = (repeated ? refl->GetRepeatedEnum(msg, field, index)
+                               : refl->GetEnum(msg, field))
+                         ->name();
+            return true;
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            if (repeated)
+                set_message(v, &refl->GetRepeatedMessage(msg, field, index));
+            else if (refl->HasField(msg, field))
+                set_message(v, &refl->GetMessage(msg, field));
+            else
+                set_nil(v);
+            return true;
+    }
+    return false;
+}
+
+// msg.field (nil if there is no such field)
+bool member_value(const Message& msg, const FieldDescriptor* field,
+                  ConditionExpression::Value* v)
+{
+    if (!field)
+        set_nil(v);
+    else if (field->is_repeated())
+        set_message(v, &msg, field);
+    else
+        return field_value(msg, field, -1, v);
+    return true;
+}
+
+bool is_userdata(const ConditionExpression::Value& v)
+{
+    return v.type == ConditionExpression::Value::MESSAGE ||
+           v.type == ConditionExpression::Value::REPEATED;
+}
+
+// a == b, if this does not depend on the identity of the Lua objects
+bool equal(const ConditionExpression::Value& a, const ConditionExpression::Value& b, bool* eq)
+{
+    if (a.type != b.type)
+    {
+        *eq = false;
+        return !(is_userdata(a) && is_userdata(b));
+    }
+
+    switch (a.type)
+    {
+        case ConditionExpression::Value::NIL: *eq = true; return true;
+        case ConditionExpression::Value::BOOLEAN: *eq = a.boolean == b.boolean; return true;
+        case ConditionExpression::Value::NUMBER: *eq = a.number == b.number; return true;
+        case ConditionExpression::Value::STRING: *eq = a.str == b.str; return true;
+        default: return false;
+    }
+}
+
+// a < b (or a <= b), for two numbers or two strings
+bool less(const ConditionExpression::Value& a, const ConditionExpression::Value& b, bool or_equal,
+          bool* lt)
+{
+    if (a.type == ConditionExpression::Value::NUMBER && b.type == ConditionExpression::Value::NUMBER)
+        *lt = or_equal ? a.number <= b.number : a.number < b.number;
+    else if (a.type == ConditionExpression::Value::STRING &&
+             b.type == ConditionExpression::Value::STRING)
+        *lt = or_equal ? a.str <= b.str : a.str < b.str;
+    else
+        return false;
+    return true;
+}
+} // namespace
+
+// recursive descent parser following the Lua operator precedence (lowest first): or; and;
+// comparison; + -; * / // %; unary not # -; ^
+class dccl::internal::ConditionExpression::Parser
+{
+  public:
+    Parser(const std::string& script, std::vector<Node>* nodes) : s_(script), nodes_(nodes) {}
+
+    // returns the index of the top node, or -1 if the script is not supported
+    int parse()
+    {
+        accept_keyword("return");
+        int top = parse_or();
+        accept(";");
+        skip_space();
+        return (ok_ && pos_ == s_.size()) ? top : -1;
+    }
+
+  private:
+    int parse_or()
+    {
+        int lhs = parse_and();
+        while (ok_ && accept_keyword("or")) lhs = add(OR, lhs, parse_and());
+        return lhs;
+    }
+
+    int parse_and()
+    {
+        int lhs = parse_comparison();
+        while (ok_ && accept_keyword("and")) lhs = add(AND, lhs, parse_comparison());
+        return lhs;
+    }
+
+    int parse_comparison()
+    {
+        int lhs = parse_additive();
+        while (ok_)
+        {
+            Op op;
+            if (accept("=="))
+                op = EQ;
+            else if (accept("~="))
+                op = NE;
+            else if (accept("<="))
+                op = LE;
+            else if (accept(">="))
+                op = GE;
+            else if (accept("<"))
+                op = LT;
+            else if (accept(">"))
+                op = GT;
+            else
+                break;
+            lhs = add(op, lhs, parse_additive());
+        }
+        return lhs;
+    }
+
+    int parse_additive()
+    {
+        int lhs = parse_multiplicative();
+        while (ok_)
+        {
+            Op op;
+            if (accept("+"))
+                op = ADD;
+            else if (accept("-"))
+                op = SUB;
+            else
+                break;
+            lhs = add(op, lhs, parse_multiplicative());
+        }
+        return lhs;
+    }
+
+    int parse_multiplicative()
+    {
+        int lhs = parse_unary();
+        while (ok_)
+        {
+            Op op;
+            if (accept("*"))
+                op = MUL;
+            else if (accept("//"))
+                op = FLOOR_DIV;
+            else if (accept("/"))
+                op = DIV;
+            else if (accept("%"))
+                op = MOD;
+            else
+                break;
+            lhs = add(op, lhs, parse_unary());
+        }
+        return lhs;
+    }
+
+    int parse_unary()
+    {
+        if (accept_keyword("not"))
+            return add(NOT, parse_unary());
+        else if (accept("-"))
+            return add(NEGATE, parse_unary());
+        else if (accept("#"))
+            return add(LENGTH, parse_unary());
+        else
+            return parse_power();
+    }
+
+    int parse_power()
+    {
+        int base = parse_postfix();
+        // right associative, and binds more tightly than a unary operator on its left
+        if (ok_ && accept("^"))
+            return add(POW, base, parse_unary());
+        return base;
+    }
+
+    int parse_postfix()
+    {
+        int lhs = parse_primary();
+        while (ok_)
+        {
+            skip_space();
+            if (s_.compare(pos_, 1, ".") == 0 && s_.compare(pos_, 2, "..") != 0)
+            {
+                ++pos_;
+                skip_space();
+                std::string name = read_name();
+                if (name.empty())
+                    return fail();
+                lhs = add(FIELD, lhs);
+                (*nodes_)[lhs].name = name;
+            }
+            else if (accept("["))
+            {
+                int key = parse_or();
+                if (!accept("]"))
+                    return fail();
+                lhs = add(INDEX, lhs, key);
+            }
+            else
+            {
+                break;
+            }
+        }
+        return lhs;
+    }
+
+    int parse_primary()
+    {
+        skip_space();
+        if (!ok_ || pos_ == s_.size())
+            return fail();
+
+        const char c = s_[pos_];
+        if (std::isdigit(static_cast<unsigned char>(c)) ||
+            (c == '.' && pos_ + 1 < s_.size() &&
+             std::isdigit(static_cast<unsigned char>(s_[pos_ + 1]))))
+            return parse_number();
+        else if (c == '\'' || c == '"')
+            return parse_string();
+        else if (accept("("))
+        {
+            int inner = parse_or();
+            return accept(")") ? inner : fail();
+        }
+
+        const std::string name = read_name();
+        if (name == "this")
+            return add(THIS);
+        else if (name == "root")
+            return add(ROOT);
+        else if (name == "this_index")
+            return add(THIS_INDEX);
+
+        int literal = add(LITERAL);
+        Value& v = (*nodes_)[literal].literal;
+        if (name == "true" || name == "false")
+            set_boolean(&v, name == "true");
+        else if (name != "nil")
+            return fail();
+        return literal;
+    }
+
+    int parse_number()
+    {
+        const std::size_t begin = pos_;
+        // hexadecimal numbers are left to Lua
+        if (s_.compare(pos_, 2, "0x") == 0 || s_.compare(pos_, 2, "0X") == 0)
+            return fail();
+        bool integer = true;
+        while (pos_ < s_.size())
+        {
+            const char c = s_[pos_];
+            if (std::isdigit(static_cast<unsigned char>(c)))
+                ++pos_;
+            else if (c == '.')
+            {
+                integer = false;
+                ++pos_;
+            }
+            else if (c == 'e' || c == 'E')
+            {
+                integer = false;
+                ++pos_;
+                if (pos_ < s_.size() && (s_[pos_] == '+' || s_[pos_] == '-'))
+                    ++pos_;
+            }
+            else
+                break;
+        }
+        if (pos_ < s_.size() && is_name_char(s_[pos_]))
+            return fail();
+
+        const std::string text = s_.substr(begin, pos_ - begin);
+        char* end = nullptr;
+        const double x = std::strtod(text.c_str(), &end);
+        if (end != text.c_str() + text.size() || !std::isfinite(x) ||
+            (integer && x > max_exact_integer))
+            return fail();
+
+        int literal = add(LITERAL);
+        set_number(&(*nodes_)[literal].literal, x);
+        return literal;
+    }
+
+    int parse_string()
+    {
+        const char quote = s_[pos_++];
+        const std::size_t end = s_.find(quote, pos_);
+        if (end == std::string::npos)
+            return fail();
+        const std::string str = s_.substr(pos_, end - pos_);
+        // escape sequences are left to Lua
+        if (str.find_first_of("\\\n") != std::string::npos)
+            return fail();
+        pos_ = end + 1;
+
+        int literal = add(LITERAL);
+        Value& v = (*nodes_)[literal].literal;
+        v.type = Value::STRING;
+        v.str = str;
+        return literal;
+    }
+
+    static bool is_name_char(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    std::string read_name()
+    {
+        skip_space();
+        const std::size_t begin = pos_;
+        if (pos_ < s_.size() && !std::isdigit(static_cast<unsigned char>(s_[pos_])))
+            while (pos_ < s_.size() && is_name_char(s_[pos_])) ++pos_;
+        return s_.substr(begin, pos_ - begin);
+    }
+
+    void skip_space()
+    {
+        while (pos_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[pos_]))) ++pos_;
+        // comments are left to Lua
+        if (s_.compare(pos_, 2, "--") == 0)
+            fail();
+    }
+
+    // consumes the operator (or punctuation) token if it is next
+    bool accept(const char* token)
+    {
+        skip_space();
+        const std::size_t len = std::char_traits<char>::length(token);
+        if (!ok_ || s_.compare(pos_, len, token) != 0)
+            return false;
+        pos_ += len;
+        return true;
+    }
+
+    // consumes the keyword if it is the next name
+    bool accept_keyword(const char* keyword)
+    {
+        skip_space();
+        const std::size_t len = std::char_traits<char>::length(keyword);
+        if (!ok_ || s_.compare(pos_, len, keyword) != 0 ||
+            (pos_ + len < s_.size() && is_name_char(s_[pos_ + len])))
+            return false;
+        pos_ += len;
+        return true;
+    }
+
+    int add(Op op, int lhs = -1, int rhs = -1)
+    {
+        nodes_->push_back(Node());
+        Node& node = nodes_->back();
+        node.op = op;
+        node.lhs = lhs;
+        node.rhs = rhs;
+        return static_cast<int>(nodes_->size()) - 1;
+    }
+
+    int fail()
+    {
+        ok_ = false;
+        return -1;
+    }
+
+    const std::string& s_;
+    std::vector<Node>* nodes_;
+    std::size_t pos_{0};
+    bool ok_{true};
+};
+
+dccl::internal::ConditionExpression::ConditionExpression(const std::string& script)
+{
+    root_ = Parser(script, &nodes_).parse();
+    if (root_ < 0)
+        nodes_.clear();
+}
+
+bool dccl::internal::ConditionExpression::evaluate(const google::protobuf::Message* this_msg,
+                                                   const google::protobuf::Message* root_msg,
+                                                   int repeated_index, Value* result) const
+{
+    if (!valid())
+        return false;
+    Context context = {this_msg, root_msg, repeated_index};
+    return eval(root_, context, result);
+}
+
+bool dccl::internal::ConditionExpression::eval(int n, const Context& context, Value* result) const
+{
+    const Node& node = nodes_[n];
+    switch (node.op)
+    {
+        case LITERAL: *result = node.literal; return true;
+        case THIS: set_message(result, context.this_msg); return true;
+        case ROOT: set_message(result, context.root_msg); return true;
+        case THIS_INDEX: set_number(result, context.repeated_index + 1); return true;
+
+        case FIELD:
+        {
+            if (!eval(node.lhs, context, result))
+                return false;
+            // a repeated field is indexed by number only
+            if (result->type == Value::REPEATED)
+            {
+                set_nil(result);
+                return true;
+            }
+            if (result->type != Value::MESSAGE)
+                return false;
+
+            const google::protobuf::Descriptor* desc = result->msg->GetDescriptor();
+            if (node.cached_desc != desc)
+            {
+                node.cached_field = desc->FindFieldByName(node.name);
+                node.cached_desc = desc;
+            }
+            return member_value(*result->msg, node.cached_field, result);
+        }
+
+        case INDEX:
+        {
+            Value key;
+            if (!eval(node.lhs, context, result) || !eval(node.rhs, context, &key))
+                return false;
+
+            if (result->type == Value::MESSAGE)
+            {
+                const FieldDescriptor* field =
+                    key.type == Value::STRING ? result->msg->GetDescriptor()->FindFieldByName(key.str)
+                                              : nullptr;
+                return member_value(*result->msg, field, result);
+            }
+            else if (result->type == Value::REPEATED)
+            {
+                // Lua would convert a numeric string to a number
+                if (key.type == Value::STRING)
+                    return false;
+                const Message& msg = *result->msg;
+                const FieldDescriptor* field = result->repeated_field;
+                if (key.type == Value::NUMBER && is_integer(key.number) && key.number >= 1 &&
+                    key.number <= msg.GetReflection()->FieldSize(msg, field))
+                    return field_value(msg, field, static_cast<int>(key.number) - 1, result);
+                set_nil(result);
+                return true;
+            }
+            return false;
+        }
+
+        case NOT:
+            if (!eval(node.lhs, context, result))
+                return false;
+            set_boolean(result, !result->truthy());
+            return true;
+
+        case NEGATE:
+            if (!eval(node.lhs, context, result) || result->type != Value::NUMBER)
+                return false;
+            result->number = -result->number;
+            return true;
+
+        case LENGTH:
+            if (!eval(node.lhs, context, result))
+                return false;
+            if (result->type == Value::STRING)
+                set_number(result, result->str.size());
+            else if (result->type == Value::REPEATED)
+                set_number(result,
+                           result->msg->GetReflection()->FieldSize(*result->msg,
+                                                                   result->repeated_field));
+            else if (result->type == Value::MESSAGE)
+                set_number(result, 0);
+            else
+                return false;
+            return true;
+
+        // `and` and `or` short-circuit, and give the value of the last operand evaluated
+        case AND:
+            if (!eval(node.lhs, context, result))
+                return false;
+            return !result->truthy() || eval(node.rhs, context, result);
+
+        case OR:
+            if (!eval(node.lhs, context, result))
+                return false;
+            return result->truthy() || eval(node.rhs, context, result);
+
+        default: break;
+    }
+
+    // binary operators
+    Value a, b;
+    if (!eval(node.lhs, context, &a) || !eval(node.rhs, context, &b))
+        return false;
+
+    bool truth = false;
+    switch (node.op)
+    {
+        case EQ:
+        case NE:
+            if (!equal(a, b, &truth))
+                return false;
+            set_boolean(result, node.op == EQ ? truth : !truth);
+            return true;
+        case LT:
+        case LE:
+            if (!less(a, b, node.op == LE, &truth))
+                return false;
+            set_boolean(result, truth);
+            return true;
+        case GT:
+        case GE:
+            if (!less(b, a, node.op == GE, &truth))
+                return false;
+            set_boolean(result, truth);
+            return true;
+        default: break;
+    }
+
+    // arithmetic: Lua would convert numeric strings to numbers
+    if (a.type != Value::NUMBER || b.type != Value::NUMBER)
+        return false;
+    const double x = a.number, y = b.number;
+    double r = 0;
+    switch (node.op)
+    {
+        case ADD: r = x + y; break;
+        case SUB: r = x - y; break;
+        case MUL: r = x * y; break;
+        case DIV: r = x / y; break;
+        case POW: r = std::pow(x, y); break;
+        case FLOOR_DIV:
+            // Lua raises an error for integer division by zero
+            if (y == 0)
+                return false;
+            r = std::floor(x / y);
+            break;
+        case MOD:
+            if (y == 0)
+                return false;
+            // as luai_nummod: the result has the sign of y
+            r = std::fmod(x, y);
+            if ((r > 0) ? y < 0 : (r < 0 && y != r))
+                r += y;
+            break;
+        default: return false;
+    }
+
+    // integer results that overflow a double's exact range (where Lua integers would wrap)
+    if ((node.op == ADD || node.op == SUB || node.op == MUL) && is_integer(x) && is_integer(y) &&
+        !is_integer(r))
+        return false;
+
+    set_number(result, r);
+    return true;
+}
@@ -0,0 +1,139 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLCONDITIONEXPRESSION20261017H
+#define DCCLCONDITIONEXPRESSION20261017H
+
+#include <string>
+#include <vector>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+namespace dccl
+{
+namespace internal
+{
+/// \brief A dynamic_conditions script compiled to be evaluated directly against the messages (using reflection) rather than by Lua.
+///
+/// Handles the subset of Lua that most conditions are written in: a single expression (optionally preceded by `return`) made of number, string, `true`, `false` and `nil` literals; `this`, `root` and `this_index`; field access (`this.a.b`, `root.c[this_index]`); comparisons (`==`, `~=`, `<`, `<=`, `>`, `>=`); `and`, `or` and `not`; arithmetic (`+`, `-`, `*`, `/`, `//`, `%`, `^`) and length (`#`). The messages appear as they do to the Lua scripts (enumerations by value name, repeated fields as arrays indexed from 1, unset submessages as `nil`), and the operators have the Lua semantics.
+///
+/// Scripts outside this subset are not valid(), and evaluate() fails in the (rare) cases where Lua would do something this class does not model (e.g. comparing a number with a string), so these scripts must be run by Lua instead. The field lookups are cached in the object, so each thread must use its own copy.
+class ConditionExpression
+{
+  public:
+    /// \brief Value of an expression
+    struct Value
+    {
+        enum Type
+        {
+            NIL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            MESSAGE,
+            REPEATED
+        };
+        Type type{NIL};
+        bool boolean{false};
+        double number{0};
+        std::string str;
+        // the MESSAGE, or the message containing the REPEATED field
+        const google::protobuf::Message* msg{nullptr};
+        const google::protobuf::FieldDescriptor* repeated_field{nullptr};
+
+        /// \brief Lua truth value: everything except `nil` and `false` is true
+        bool truthy() const { return type != NIL && (type != BOOLEAN || boolean); }
+    };
+
+    /// \brief Compiles script (see valid())
+    explicit ConditionExpression(const std::string& script);
+
+    /// \brief Whether the script is within the supported subset of Lua
+    bool valid() const { return root_ >= 0; }
+
+    /// \brief Evaluates the script with `this` = this_msg, `root` = root_msg and `this_index` = repeated_index + 1
+    ///
+    /// \return false if the script must be evaluated by Lua for these messages (*result is undefined)
+    bool evaluate(const google::protobuf::Message* this_msg,
+                  const google::protobuf::Message* root_msg, int repeated_index,
+                  Value* result) const;
+
+  private:
+    enum Op
+    {
+        LITERAL,
+        THIS,
+        ROOT,
+        THIS_INDEX,
+        FIELD, // lhs.name
+        INDEX, // lhs[rhs]
+        NOT,
+        NEGATE,
+        LENGTH,
+        AND,
+        OR,
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        FLOOR_DIV,
+        MOD,
+        POW
+    };
+
+    struct Node
+    {
+        Op op{LITERAL};
+        int lhs{-1};
+        int rhs{-1};
+        Value literal;
+        // FIELD: the field name, and the field it refers to in the last message type seen
+        std::string name;
+        mutable const google::protobuf::Descriptor* cached_desc{nullptr};
+        mutable const google::protobuf::FieldDescriptor* cached_field{nullptr};
+    };
+
+    struct Context
+    {
+        const google::protobuf::Message* this_msg;
+        const google::protobuf::Message* root_msg;
+        int repeated_index;
+    };
+
+    class Parser;
+
+    bool eval(int node, const Context& context, Value* result) const;
+
+    std::vector<Node> nodes_;
+    // index of the top node in nodes_, or -1 if the script is not supported
+    int root_{-1};
+};
+} // namespace internal
+} // namespace dccl
+
+#endif
@@ -22,11 +22,13 @@
 #include "field_codec_message_stack.h"
 #include "dccl/field_codec.h"
 
-std::vector<const google::protobuf::FieldDescriptor*> dccl::internal::MessageStack::field_;
-std::vector<const google::protobuf::Descriptor*> dccl::internal::MessageStack::desc_;
-std::vector<dccl::MessagePart> dccl::internal::MessageStack::parts_;
+thread_local std::vector<const google::protobuf::FieldDescriptor*>
+    dccl::internal::MessageStack::field_;
+thread_local std::vector<const google::protobuf::Descriptor*> dccl::internal::MessageStack::desc_;
+thread_local std::vector<dccl::MessagePart> dccl::internal::MessageStack::parts_;
 
-std::vector<dccl::internal::MessageStack::MessageAndField> dccl::internal::MessageStack::messages_;
+thread_local std::vector<dccl::internal::MessageStack::MessageAndField>
+    dccl::internal::MessageStack::messages_;
 
 // MessageStack
 //
@@ -86,10 +88,11 @@ dccl::internal::MessageStack::MessageStack(const google::protobuf::FieldDescript
         if (field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
         {
             MessagePart part = UNKNOWN;
-            if (field->options().GetExtension(dccl::field).has_in_head())
+            const dccl::DCCLFieldOptions& options = FieldOptionsCache::find(field);
+            if (options.has_in_head())
             {
                 // if explicitly set, set part (HEAD or BODY) of message for all children of this message
-                part = field->options().GetExtension(dccl::field).in_head() ? HEAD : BODY;
+                part = options.in_head() ? HEAD : BODY;
             }
             else
             {
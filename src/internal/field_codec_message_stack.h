@@ -66,9 +66,10 @@ class MessageStack
     void __pop_parts();
     void __pop_messages();
 
-    static std::vector<const google::protobuf::Descriptor*> desc_;
-    static std::vector<const google::protobuf::FieldDescriptor*> field_;
-    static std::vector<MessagePart> parts_;
+    // one stack per thread, so that messages can be encoded / decoded concurrently
+    static thread_local std::vector<const google::protobuf::Descriptor*> desc_;
+    static thread_local std::vector<const google::protobuf::FieldDescriptor*> field_;
+    static thread_local std::vector<MessagePart> parts_;
 
 
     struct MessageAndField
@@ -79,7 +80,7 @@ class MessageStack
         const google::protobuf::FieldDescriptor* field{nullptr};
     };
         
-    static std::vector<MessageAndField> messages_;
+    static thread_local std::vector<MessageAndField> messages_;
     
 
     int descriptors_pushed_;
@@ -0,0 +1,59 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include "field_options_cache.h"
+
+thread_local std::unordered_map<const google::protobuf::FieldDescriptor*,
+                                const dccl::DCCLFieldOptions*>
+    dccl::internal::FieldOptionsCache::options_;
+thread_local unsigned dccl::internal::FieldOptionsCache::generation_ =
+    dccl::internal::CacheGeneration::current();
+
+void dccl::internal::FieldOptionsCache::add(const google::protobuf::Descriptor* desc)
+{
+    check_generation();
+    for (int i = 0, n = desc->field_count(); i < n; ++i)
+    {
+        const google::protobuf::FieldDescriptor* field = desc->field(i);
+
+        // already cached (also stops recursive message definitions)
+        if (!options_.insert(std::make_pair(field, &field->options().GetExtension(dccl::field)))
+                 .second)
+            continue;
+
+        if (field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+            add(field->message_type());
+    }
+}
+
+void dccl::internal::FieldOptionsCache::remove(const google::protobuf::Descriptor* desc)
+{
+    for (int i = 0, n = desc->field_count(); i < n; ++i)
+    {
+        const google::protobuf::FieldDescriptor* field = desc->field(i);
+
+        if (!options_.erase(field))
+            continue;
+
+        if (field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+            remove(field->message_type());
+    }
+}
@@ -0,0 +1,79 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDOPTIONSCACHE20261017H
+#define DCCLFIELDOPTIONSCACHE20261017H
+
+#include <unordered_map>
+
+#include <google/protobuf/descriptor.h>
+
+#include "cache_generation.h"
+#include "dccl/option_extensions.pb.h"
+
+namespace dccl
+{
+namespace internal
+{
+/// \brief Cache of the (dccl.field) option extension of every field in the loaded messages (filled by Codec::load() and on first use), so that the encode/decode hot paths can use the options by reference rather than searching (or copying) the FieldOptions extensions on each access. Each thread keeps its own cache, which is emptied when the CacheGeneration changes.
+class FieldOptionsCache
+{
+  public:
+    /// \brief Returns the (dccl.field) options for `field`, looking them up (and caching them) if required.
+    static const dccl::DCCLFieldOptions& find(const google::protobuf::FieldDescriptor* field)
+    {
+        check_generation();
+        auto it = options_.find(field);
+        if (it == options_.end())
+            it = options_.insert(std::make_pair(field, &field->options().GetExtension(dccl::field)))
+                     .first;
+        return *it->second;
+    }
+
+    /// \brief Cache the options of all fields of `desc`, including fields of embedded messages
+    static void add(const google::protobuf::Descriptor* desc);
+
+    /// \brief Remove the cached options of all fields of `desc`, including fields of embedded messages
+    static void remove(const google::protobuf::Descriptor* desc);
+
+    /// \brief Remove all cached options
+    static void clear() { options_.clear(); }
+
+  private:
+    static void check_generation()
+    {
+        if (generation_ != CacheGeneration::current())
+        {
+            options_.clear();
+            generation_ = CacheGeneration::current();
+        }
+    }
+
+    // points into the (immutable) FieldOptions owned by each FieldDescriptor
+    static thread_local std::unordered_map<const google::protobuf::FieldDescriptor*,
+                                           const dccl::DCCLFieldOptions*>
+        options_;
+    static thread_local unsigned generation_;
+};
+} // namespace internal
+} // namespace dccl
+
+#endif
@@ -0,0 +1,113 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLMESSAGEPLAN20261017H
+#define DCCLMESSAGEPLAN20261017H
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include "cache_generation.h"
+#include "field_codec_message_stack.h"
+#include "protobuf_cpp_type_helpers.h"
+
+namespace dccl
+{
+class FieldCodecBase;
+class FieldCodecManagerLocal;
+
+namespace internal
+{
+/// \brief A field of a message with its codec and type helper already resolved
+struct FieldPlan
+{
+    const google::protobuf::FieldDescriptor* field;
+    boost::shared_ptr<FieldCodecBase> codec;
+    boost::shared_ptr<FromProtoCppTypeBase> helper;
+    // index of the containing oneof within the message, or -1 if not part of a oneof
+    int oneof_index;
+};
+
+/// \brief The fields (in encoding order) and oneofs of a message that are encoded in a given part (head or body), so that the message codecs do not need to resolve them on every call.
+struct MessagePlan
+{
+    std::vector<FieldPlan> fields;
+    std::vector<const google::protobuf::OneofDescriptor*> oneofs;
+};
+
+/// \brief Cache of MessagePlan objects, one for each combination of message codec, set of codecs (FieldCodecManagerLocal) the fields' codecs are found in, Descriptor, root Descriptor (which determines the codec group), part being encoded and the explicitly set part (if any) of the enclosing message. Each thread keeps its own plans, so no locking is required.
+class MessagePlanCache
+{
+  public:
+    /// \brief Return the plan for this key, building it with `build(MessagePlan*)` if required. The plan is shared so that it remains valid for the caller if the cache is emptied while it is in use (such as when the CacheGeneration is changed by another thread).
+    template <typename Builder>
+    static boost::shared_ptr<const MessagePlan> find(const FieldCodecBase* codec,
+                                   const FieldCodecManagerLocal* manager,
+                                   const google::protobuf::Descriptor* desc,
+                                   const google::protobuf::Descriptor* root_desc, MessagePart part,
+                                   MessagePart current_part, Builder build)
+    {
+        Plans& plans = thread_plans();
+        if (plans.generation != CacheGeneration::current())
+        {
+            plans.plans.clear();
+            plans.generation = CacheGeneration::current();
+        }
+
+        Key key(codec, manager, desc, root_desc, part, current_part);
+        typename PlanMap::iterator it = plans.plans.find(key);
+        if (it == plans.plans.end())
+        {
+            boost::shared_ptr<MessagePlan> plan(new MessagePlan);
+            build(plan.get());
+            it = plans.plans.insert(std::make_pair(key, plan)).first;
+        }
+        return it->second;
+    }
+
+  private:
+    typedef std::tuple<const FieldCodecBase*, const FieldCodecManagerLocal*,
+                       const google::protobuf::Descriptor*,
+                       const google::protobuf::Descriptor*, MessagePart, MessagePart>
+        Key;
+    typedef std::map<Key, boost::shared_ptr<const MessagePlan>> PlanMap;
+
+    struct Plans
+    {
+        PlanMap plans;
+        unsigned generation{CacheGeneration::current()};
+    };
+
+    static Plans& thread_plans()
+    {
+        static thread_local Plans plans;
+        return plans;
+    }
+};
+} // namespace internal
+} // namespace dccl
+
+#endif
@@ -22,10 +22,13 @@
 #ifndef DCCLPROTOBUFCPPTYPEHELPERS20110323H
 #define DCCLPROTOBUFCPPTYPEHELPERS20110323H
 
+#include <vector>
+
 #include <boost/any.hpp>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/message.h>
+#include <google/protobuf/reflection.h>
 
 
 namespace dccl
@@ -583,9 +586,108 @@ namespace dccl
             static google::protobuf::FieldDescriptor::CppType as_enum()
             { return google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE; }
         };
+
+// Reflection::MutableRepeatedField() is deprecated in favor of GetMutableRepeatedFieldRef(), but is
+// the only way to reserve space in a repeated field through reflection
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+        /// \brief Statically typed access to a (non-message) field of type T through google::protobuf::Reflection, without going through boost::any. Repeated fields are read in place through RepeatedFieldRef (for_each_repeated()) and written through their underlying RepeatedField (mutable_repeated(), which reserves space for the values to be added with add_repeated()). `value` is true for the C++ types that have a google::protobuf::FieldDescriptor::CppType.
+        template<typename T>
+            class CppTypeReflection
+        {
+          public:
+            enum { value = false };
+        };
+
+        /// \brief The repeated field access of CppTypeReflection for the types stored in a RepeatedField (or, for strings, a RepeatedPtrField)
+        template<typename T, typename RepeatedStorage = google::protobuf::RepeatedField<T> >
+            class RepeatedCppTypeReflection
+        {
+          public:
+            enum { value = true };
+            typedef T type;
+            template<typename Function>
+                static void for_each_repeated(const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field, Function f)
+            {
+                google::protobuf::RepeatedFieldRef<type> ref = msg.GetReflection()->GetRepeatedFieldRef<type>(msg, field);
+                for(typename google::protobuf::RepeatedFieldRef<type>::iterator it = ref.begin(), end = ref.end(); it != end; ++it)
+                    f(*it);
+            }
+            typedef RepeatedStorage* mutable_repeated_type;
+            static mutable_repeated_type mutable_repeated(google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field, int reserve)
+            {
+                mutable_repeated_type values = mutable_storage(msg, field, static_cast<mutable_repeated_type>(0));
+                values->Reserve(values->size() + reserve);
+                return values;
+            }
+            static void add_repeated(google::protobuf::RepeatedField<type>* values, const type& value)
+            { values->Add(value); }
+            static void add_repeated(google::protobuf::RepeatedPtrField<type>* values, const type& value)
+            { *values->Add() = value; }
+
+          private:
+            static google::protobuf::RepeatedField<type>* mutable_storage(google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field, google::protobuf::RepeatedField<type>*)
+            { return msg->GetReflection()->MutableRepeatedField<type>(msg, field); }
+            static google::protobuf::RepeatedPtrField<type>* mutable_storage(google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field, google::protobuf::RepeatedPtrField<type>*)
+            { return msg->GetReflection()->MutableRepeatedPtrField<type>(msg, field); }
+        };
+
+        typedef RepeatedCppTypeReflection<std::string, google::protobuf::RepeatedPtrField<std::string> > StringCppTypeReflection;
+
+        /// \brief The repeated field access of CppTypeReflection for enumerations, which are only available as their numeric values through RepeatedFieldRef
+        class EnumCppTypeReflection
+        {
+          public:
+            enum { value = true };
+            typedef const google::protobuf::EnumValueDescriptor* type;
+            // read with GetRepeatedEnum (which handles unknown values of open enumerations)
+            template<typename Function>
+                static void for_each_repeated(const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field, Function f)
+            {
+                const google::protobuf::Reflection* refl = msg.GetReflection();
+                for(int i = 0, n = refl->FieldSize(msg, field); i < n; ++i)
+                    f(refl->GetRepeatedEnum(msg, field, i));
+            }
+            // (Reflection has no direct access to the storage of enumerations, so this cannot reserve space)
+            typedef google::protobuf::MutableRepeatedFieldRef<google::protobuf::int32> mutable_repeated_type;
+            static mutable_repeated_type mutable_repeated(google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field, int reserve)
+            { return msg->GetReflection()->GetMutableRepeatedFieldRef<google::protobuf::int32>(msg, field); }
+            static void add_repeated(const mutable_repeated_type& values, const type& value)
+            { values.Add(value->number()); }
+        };
+
+        // CppTypeReflection<CppType>, with get() and set() through Reflection::Get<Name>() and Reflection::Set<Name>()
+#define DCCL_CPP_TYPE_REFLECTION(CppType, Name, RepeatedReflection)     \
+        template<>                                                      \
+            class CppTypeReflection<CppType> : public RepeatedReflection \
+        {                                                               \
+          public:                                                       \
+            static type get(const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field) \
+            { return msg.GetReflection()->Get##Name(msg, field); }      \
+            static void set(google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field, const type& value) \
+            { msg->GetReflection()->Set##Name(msg, field, value); }     \
+        };
+
+        DCCL_CPP_TYPE_REFLECTION(double, Double, RepeatedCppTypeReflection<double>)
+        DCCL_CPP_TYPE_REFLECTION(float, Float, RepeatedCppTypeReflection<float>)
+        DCCL_CPP_TYPE_REFLECTION(google::protobuf::int32, Int32, RepeatedCppTypeReflection<google::protobuf::int32>)
+        DCCL_CPP_TYPE_REFLECTION(google::protobuf::int64, Int64, RepeatedCppTypeReflection<google::protobuf::int64>)
+        DCCL_CPP_TYPE_REFLECTION(google::protobuf::uint32, UInt32, RepeatedCppTypeReflection<google::protobuf::uint32>)
+        DCCL_CPP_TYPE_REFLECTION(google::protobuf::uint64, UInt64, RepeatedCppTypeReflection<google::protobuf::uint64>)
+        DCCL_CPP_TYPE_REFLECTION(bool, Bool, RepeatedCppTypeReflection<bool>)
+        DCCL_CPP_TYPE_REFLECTION(std::string, String, StringCppTypeReflection)
+        DCCL_CPP_TYPE_REFLECTION(const google::protobuf::EnumValueDescriptor*, Enum, EnumCppTypeReflection)
+
+#undef DCCL_CPP_TYPE_REFLECTION
     }
 }
 
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
 
 
 
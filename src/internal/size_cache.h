@@ -0,0 +1,119 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSIZECACHE20261017H
+#define DCCLSIZECACHE20261017H
+
+#include <cstddef>
+#include <unordered_map>
+
+#include <google/protobuf/descriptor.h>
+
+#include "cache_generation.h"
+#include "field_codec_message_stack.h"
+
+namespace dccl
+{
+class FieldCodecBase;
+class FieldCodecManagerLocal;
+
+namespace internal
+{
+/// \brief Cache of the minimum and maximum sizes (in bits) computed by FieldCodecBase::field_min_size() and FieldCodecBase::field_max_size(). These only depend on the message schema and the codecs in use, so they are kept until the set of codecs changes or a message is loaded or unloaded (see CacheGeneration).
+class SizeCache
+{
+  public:
+    enum Bound
+    {
+        MIN_SIZE,
+        MAX_SIZE
+    };
+
+    /// \brief Everything a schema-derived size may depend on. Since FieldCodecManager returns a distinct codec instance for each codec version and group, `codec` also identifies those. `manager` is the set of codecs (FieldCodecManagerLocal::current()) that the codecs of embedded fields are taken from.
+    struct Key
+    {
+        const FieldCodecBase* codec;
+        const FieldCodecManagerLocal* manager;
+        const google::protobuf::FieldDescriptor* field;
+        const google::protobuf::Descriptor* desc;
+        const google::protobuf::Descriptor* root_desc;
+        MessagePart part;
+        MessagePart current_part;
+        Bound bound;
+
+        bool operator==(const Key& other) const
+        {
+            return codec == other.codec && manager == other.manager && field == other.field && desc == other.desc &&
+                   root_desc == other.root_desc && part == other.part &&
+                   current_part == other.current_part && bound == other.bound;
+        }
+    };
+
+    /// \brief Look up a size, returning false if it is not cached
+    static bool find(const Key& key, unsigned* bit_size)
+    {
+        check_generation();
+        auto it = sizes_.find(key);
+        if (it == sizes_.end())
+            return false;
+        *bit_size = it->second;
+        return true;
+    }
+
+    static void insert(const Key& key, unsigned bit_size)
+    {
+        check_generation();
+        sizes_[key] = bit_size;
+    }
+
+    static void clear() { sizes_.clear(); }
+
+  private:
+    static void check_generation()
+    {
+        if (generation_ != CacheGeneration::current())
+        {
+            sizes_.clear();
+            generation_ = CacheGeneration::current();
+        }
+    }
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const
+        {
+            std::size_t h = std::hash<const void*>()(key.codec);
+            h = h * 31 + std::hash<const void*>()(key.manager);
+            h = h * 31 + std::hash<const void*>()(key.field);
+            h = h * 31 + std::hash<const void*>()(key.desc);
+            h = h * 31 + std::hash<const void*>()(key.root_desc);
+            return ((h * 31 + key.part) * 31 + key.current_part) * 2 + key.bound;
+        }
+    };
+
+    // per thread, so that no locking is required
+    static thread_local std::unordered_map<Key, unsigned, KeyHash> sizes_;
+    static thread_local unsigned generation_;
+};
+} // namespace internal
+} // namespace dccl
+
+#endif
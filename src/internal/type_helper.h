@@ -32,6 +32,7 @@
 namespace dccl
 {
     class FieldCodecManager;
+    class FieldCodecManagerLocal;
     
     namespace internal
     {
@@ -59,6 +60,7 @@ namespace dccl
             
           private:
             friend class ::dccl::FieldCodecManager;
+            friend class ::dccl::FieldCodecManagerLocal;
             template<typename ProtobufMessage>
                 static void add()
             {
@@ -26,6 +26,7 @@
 dccl::Logger dccl::dlog;
 
 int dccl::internal::LogBuffer::sync() {
+    lock();
     // all but last one
     while(buffer_.size() > 1) {
         display(buffer_.front());
@@ -33,13 +34,16 @@ int dccl::internal::LogBuffer::sync() {
     }
     verbosity_ = logger::INFO;
     group_ = logger::GENERAL;
+    unlock();
     
     return 0;
 }
 
 int dccl::internal::LogBuffer::overflow(int c) {
     if (c == EOF) { return c; }
-    else if(c == '\n') { buffer_.push_back(std::string()); }
+    // already held after is(); otherwise writing starts the message
+    lock();
+    if(c == '\n') { buffer_.push_back(std::string()); }
     else { buffer_.back().push_back(c); }
     return c;
 }
@@ -28,6 +28,9 @@
 #include <iomanip>
 #include <boost/signals2.hpp>
 #include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 namespace dccl {
     namespace logger {
@@ -60,7 +63,7 @@ namespace dccl {
         class LogBuffer : public std::streambuf
         {
           public:
-          LogBuffer() : verbosity_(logger::INFO), group_(logger::GENERAL), buffer_(1) { }
+          LogBuffer() : verbosity_(logger::INFO), group_(logger::GENERAL), buffer_(1), enabled_verbosities_(0) { }
             ~LogBuffer() { }
 
             /// connect a signal to a slot (function pointer or similar)
@@ -93,6 +96,26 @@ namespace dccl {
   
             bool contains(logger::Verbosity verbosity)
             { return verbosity & enabled_verbosities_; }
+
+            /// takes the buffer for the calling thread until the message is flushed (does nothing if this thread already has it)
+            void lock()
+            {
+                if(owner_ != std::this_thread::get_id())
+                {
+                    mutex_.lock();
+                    owner_ = std::this_thread::get_id();
+                }
+            }
+
+            /// gives up the buffer if the calling thread has it
+            void unlock()
+            {
+                if(owner_ == std::this_thread::get_id())
+                {
+                    owner_ = std::thread::id();
+                    mutex_.unlock();
+                }
+            }
  
      
           private:
@@ -117,7 +140,11 @@ namespace dccl {
             logger::Verbosity verbosity_;
             logger::Group group_;
             std::deque<std::string> buffer_;
-            int enabled_verbosities_; // mask of verbosity settings enabled
+            std::atomic<int> enabled_verbosities_; // mask of verbosity settings enabled
+
+            // held by one thread from Logger::is() (or the first character written) until the message is flushed
+            std::mutex mutex_;
+            std::atomic<std::thread::id> owner_;
 
             typedef boost::signals2::signal<void (const std::string& msg, logger::Verbosity vrb, logger::Group grp)>
                 LogSignal;
@@ -142,15 +169,22 @@ namespace dccl {
         /// \endcode
         /// \param verbosity The verbosity level to tag the following message with. These levels are used to direct the output of dlog to different logs or omit them completely.
         /// \param group The group that this message belongs to.
+        ///
+        /// dlog may be written to from several threads: when this returns true, the calling thread has the Logger until the message is ended by std::endl or std::flush, and other threads wait in is() until then. So every message must be ended.
         bool is(logger::Verbosity verbosity, logger::Group group = logger::GENERAL) {
             if (!buf_.contains(verbosity)) {
                 return false;
             } else {
+                buf_.lock();
                 buf_.set_verbosity(verbosity);
                 buf_.set_group(group);
                 return true;
             }
         }     
+
+        /// \brief Indicates whether messages of this verbosity are sent to any slot. Unlike is(), this does not start a message, so it can be used to choose what to do without logging anything.
+        bool enabled(logger::Verbosity verbosity)
+        { return buf_.contains(verbosity); }
      
         /// \brief Connect the output of one or more given verbosities to a slot (function pointer or similar)
         ///
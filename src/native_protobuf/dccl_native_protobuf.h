@@ -241,6 +241,11 @@ private:
         {
             return min_size();
         }
+
+    bool schema_only_size()
+        {
+            return true;
+        }
     
     unsigned size(const WireType& wire_value)
         {
@@ -0,0 +1,155 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "dccl/binary.h"
+#include "dccl/bit_cursor.h"
+
+using dccl::Bitset;
+using dccl::BitReader;
+using dccl::BitWriter;
+
+int main()
+{
+    // write a mix of field widths, including ones spanning 64-bit words
+    Bitset bits;
+    BitWriter writer(&bits);
+    writer.write(0x5, 3);
+    writer.write(0x1234567890abcdefULL, 64);
+    writer.write_zeros(7);
+    writer.write(Bitset(10, 0x2a5));
+    writer.write(0x1, 1);
+    assert(writer.size() == 85);
+    assert(bits.size() == 85);
+
+    std::string bytes = bits.to_byte_string();
+    std::cout << bits << std::endl;
+    std::cout << dccl::hex_encode(bytes) << std::endl;
+
+    // read them back from the byte buffer
+    BitReader reader(bytes.data(), bytes.data() + bytes.size());
+    assert(reader.size() == bytes.size() * 8);
+    assert(reader.peek(3) == 0x5);
+    assert(reader.read(3) == 0x5);
+    assert(reader.read(64) == 0x1234567890abcdefULL);
+    assert(reader.read(7) == 0);
+    Bitset ten;
+    reader.read(&ten, 10);
+    assert(ten == Bitset(10, 0x2a5));
+    assert(reader.read(1) == 0x1);
+    assert(reader.position() == 85);
+    assert(reader.remaining() == bytes.size() * 8 - 85);
+
+    // reading past the end throws and leaves the cursor unchanged
+    bool caught = false;
+    try
+    {
+        reader.read(64);
+    }
+    catch (dccl::Exception& e)
+    {
+        caught = true;
+    }
+    assert(caught);
+    assert(reader.position() == 85);
+
+    // reader limited to a number of bits
+    BitReader limited(bytes.data(), bytes.data() + bytes.size(), 67);
+    assert(limited.size() == 67);
+    limited.seek(3);
+    assert(limited.read(64) == 0x1234567890abcdefULL);
+    assert(limited.remaining() == 0);
+
+    // Bitset based decoders pulling from a reader only consume what they take
+    {
+        BitReader pooled(bytes.data(), bytes.data() + bytes.size());
+        {
+            dccl::BitReaderPool pool(&pooled);
+            Bitset child(pool.bits());
+            child.get_more_bits(3);
+            assert(child.to_ulong() == 0x5);
+            // the bits are read from the reader as they are asked for, not up front
+            assert(pooled.position() == 3);
+
+            // through a grandchild (as for a field within an embedded message)
+            Bitset message(pool.bits());
+            Bitset grandchild(&message);
+            grandchild.get_more_bits(64);
+            assert(grandchild.to<dccl::uint64>() == 0x1234567890abcdefULL);
+            assert(pooled.position() == 67);
+
+            // asking for more bits than are left throws
+            Bitset too_many(pool.bits());
+            bool caught = false;
+            try
+            {
+                too_many.get_more_bits(bytes.size() * 8);
+            }
+            catch (dccl::Exception& e)
+            {
+                caught = true;
+            }
+            assert(caught);
+        }
+        // bits that were read but not taken from the pool are returned to the reader
+        assert(pooled.position() == 67);
+        assert(pooled.read(7) == 0);
+    }
+
+    // packed values of every width, starting at various offsets, match those written and read one
+    // at a time
+    std::mt19937_64 rng(1);
+    for (unsigned num_bits = 0; num_bits <= 64; ++num_bits)
+    {
+        for (unsigned offset = 0; offset < 70; offset += 13)
+        {
+            std::vector<dccl::uint64> values(1 + rng() % 40);
+            for (std::size_t i = 0; i < values.size(); ++i) values[i] = rng();
+
+            Bitset packed, expected;
+            BitWriter packed_writer(&packed), expected_writer(&expected);
+            packed_writer.write(rng(), offset % 64);
+            packed_writer.write_zeros(offset - offset % 64);
+            expected.append(packed);
+            packed_writer.write_packed(values.data(), values.size(), num_bits);
+            for (std::size_t i = 0; i < values.size(); ++i) expected_writer.write(values[i], num_bits);
+            assert(packed == expected);
+
+            const std::string packed_bytes = packed.to_byte_string();
+            BitReader packed_reader(packed_bytes.data(), packed_bytes.data() + packed_bytes.size(),
+                                    packed.size());
+            packed_reader.skip(offset);
+            std::vector<dccl::uint64> unpacked(values.size());
+            packed_reader.read_packed(unpacked.data(), unpacked.size(), num_bits);
+            assert(packed_reader.remaining() == 0);
+            for (std::size_t i = 0; i < values.size(); ++i)
+                assert(unpacked[i] == (num_bits < 64 ? values[i] & ((1ull << num_bits) - 1) : values[i]));
+        }
+    }
+
+    std::cout << "all tests passed" << std::endl;
+
+    return 0;
+}
@@ -158,6 +158,53 @@ int main()
         assert(grandparent.to_ulong() == 0xD);
     }
 
+
+    // spanning multiple storage words
+    {
+        std::cout << std::endl;
+        const std::string bytes = dccl::hex_decode("0123456789abcdeffedcba98765432100f1e2d3c");
+        Bitset big;
+        big.from_byte_string(bytes);
+        assert(big.size() == 160);
+        assert(big.to_byte_string() == bytes);
+
+        // shifts across word boundaries keep the size fixed
+        Bitset shifted = (big << 67) >> 67;
+        assert(shifted.size() == 160);
+        big.resize(160 - 67);
+        big.resize(160);
+        assert(shifted == big);
+
+        // prepend / append across word boundaries
+        Bitset a(70, 0x5), b(61, 0x3);
+        Bitset ab(a);
+        ab.append(b);
+        assert(ab.size() == 131);
+        assert(ab.test(0) && !ab.test(1) && ab.test(2));
+        assert(ab.test(70) && ab.test(71) && !ab.test(72));
+        Bitset ba(a);
+        ba.prepend(b);
+        assert(ba.size() == 131);
+        assert(ba.test(0) && ba.test(1) && !ba.test(2));
+        assert(ba.test(61) && !ba.test(62) && ba.test(63));
+
+        for(int i = 0; i < 10; ++i) ab.pop_front();
+        assert(ab.size() == 121);
+        assert(ab.test(60) && ab.test(61) && !ab.test(62));
+
+        assert(Bitset(70, 1) < Bitset(65, 2));
+        assert(!(Bitset(65, 2) < Bitset(70, 1)));
+
+        // get_more_bits pulling more than one word from the parent
+        Bitset parent;
+        parent.from_byte_string(bytes);
+        Bitset child(3, 0, &parent);
+        child.get_more_bits(130);
+        assert(child.size() == 133);
+        assert(parent.size() == 30);
+        assert((child >> 3).to_byte_string().substr(0, 16) == bytes.substr(0, 16));
+        assert(parent.to_ulong() == (0x3c2d1e0fUL >> 2));
+    }
     
     std::cout << "all tests passed" << std::endl;
     
@@ -36,7 +36,8 @@ using dccl::operator<<;
 
 void run_test(dccl::arith::protobuf::ArithmeticModel& model,
               const google::protobuf::Message& msg_in,
-              bool set_model = true)
+              bool set_model = true,
+              const std::string& expected_hex = "")
 {
     static int i = 0;
     
@@ -70,6 +71,8 @@ void run_test(dccl::arith::protobuf::ArithmeticModel& model,
     std::string bytes;
     codec.encode(&bytes, msg_in);
     std::cout << "... got bytes (hex): " << dccl::hex_encode(bytes) << std::endl;
+    if(!expected_hex.empty())
+        assert(dccl::hex_encode(bytes) == expected_hex);
 
     std::cout << "Try decode..." << std::endl;
 
@@ -314,6 +317,77 @@ int main(int argc, char* argv[])
         run_test(model, msg_in);
     }
 
+    // adaptive model with many symbols (and no out of range symbol), checked against known encoding
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+
+        model.set_eof_frequency(1);
+        model.set_out_of_range_frequency(0);
+        for(int j = 0; j < 300; ++j)
+        {
+            model.add_value_bound(j);
+            model.add_frequency((j*7) % 13 + 1);
+        }
+        model.add_value_bound(300);
+        model.set_is_adaptive(true);
+
+        ArithmeticDouble2TestMsg msg_in;
+        for(int j = 0; j < 100; ++j)
+            msg_in.add_value((j*37) % 300 / ((j % 3) + 1));
+
+        run_test(model, msg_in, true,
+                 "0a00846041bbb317bfdc1949c9fea4ab1366dd454ef6c8f68a253cab780adcc6870bee6dd9ce0886d735ff4321e86e5dc743cf77c9ad744ee2d29c1d78a39642965c6ebc02ba1f21d66cef9527479d8ffc987da69ce2518f6cfeb5fd93722ade21bebdad044d3cd0b911");
+    }
+
+    // range coder variant, with the Bodden model above (no EOF / out of range frequency)
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+
+        model.set_eof_frequency(0);
+        model.set_out_of_range_frequency(0);
+        for(int j = 1; j <= 5; ++j)
+        {
+            model.add_value_bound(j);
+            model.add_frequency(j == 3 ? 3 : (j == 1 ? 2 : 1));
+        }
+        model.add_value_bound(6);
+
+        ArithmeticRangeEnumTestMsg msg_in;
+        msg_in.add_value(ENUM2_A);
+        msg_in.add_value(ENUM2_B);
+        msg_in.add_value(ENUM2_C);
+        msg_in.add_value(ENUM2_C);
+        msg_in.add_value(ENUM2_E);
+        msg_in.add_value(ENUM2_D);
+        msg_in.add_value(ENUM2_A);
+        msg_in.add_value(ENUM2_C);
+        
+        run_test(model, msg_in);
+    }
+
+    // range coder variant, adaptive model updated over several messages
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+
+        model.set_eof_frequency(1);
+        model.set_out_of_range_frequency(0);
+        for(int j = 0; j < 300; ++j)
+        {
+            model.add_value_bound(j);
+            model.add_frequency((j*7) % 13 + 1);
+        }
+        model.add_value_bound(300);
+        model.set_is_adaptive(true);
+
+        ArithmeticRangeTestMsg msg_in;
+        run_test(model, msg_in);
+        
+        for(int j = 0; j < 100; ++j)
+            msg_in.add_value((j*37) % 300 / ((j % 3) + 1));
+        run_test(model, msg_in, false);
+        run_test(model, msg_in, false);
+    }
+
     // randomly generate a model and a message
     // loop over all message lengths from 0 to 100
     srand ( time(NULL) );
@@ -361,6 +435,10 @@ int main(int argc, char* argv[])
 
         
         run_test(model, msg_in);
+
+        ArithmeticRangeTestMsg range_msg_in;
+        range_msg_in.mutable_value()->CopyFrom(msg_in.value());
+        run_test(model, range_msg_in, false);
         
         std::cout << "end random test #" << i << std::endl;
         
@@ -0,0 +1,373 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests Codec::encode_batch, Codec::decode_batch, Codec::decode_front, Codec::encrypt_frames,
+// Codec::scan_frames, Codec::decode_parallel and Codec::try_encode
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// n Pings and n Reports, alternating in msgs (starting with a Report, so the last message has a
+// fixed size), with a mix of their optional and repeated fields set
+struct Fixture
+{
+    explicit Fixture(int n) : pings(n), reports(n)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            reports[i].set_source((i + 10) % 32);
+            for (int j = 0; j < i % 10; ++j) reports[i].add_temperature(j * 1.25 - 2);
+            if (i % 2 == 0)
+                reports[i].set_comment(std::string(i * 3 % 17, 'x'));
+            msgs.push_back(&reports[i]);
+
+            pings[i].set_source(i % 32);
+            if (i % 2)
+                pings[i].set_sequence(i * 10 % 1000);
+            msgs.push_back(&pings[i]);
+        }
+    }
+
+    std::vector<Ping> pings;
+    std::vector<Report> reports;
+    std::vector<const google::protobuf::Message*> msgs;
+};
+
+void test_batch(dccl::Codec& codec)
+{
+    Fixture fixture(5);
+    const std::vector<Ping>& pings = fixture.pings;
+    const std::vector<Report>& reports = fixture.reports;
+    const std::vector<const google::protobuf::Message*>& msgs = fixture.msgs;
+
+    // one message at a time
+    std::string expected;
+    std::vector<std::size_t> expected_offsets;
+    for (const google::protobuf::Message* msg : msgs)
+    {
+        expected_offsets.push_back(expected.size());
+        std::string bytes;
+        codec.encode(&bytes, *msg);
+        expected += bytes;
+    }
+    expected_offsets.push_back(expected.size());
+
+    // mixed types
+    {
+        std::string bytes("prefix");
+        std::vector<std::size_t> offsets;
+        codec.encode_batch(&bytes, msgs, &offsets);
+        assert(bytes == "prefix" + expected);
+        assert(offsets.size() == msgs.size() + 1);
+        for (std::size_t i = 0; i < offsets.size(); ++i)
+            assert(offsets[i] == expected_offsets[i] + 6);
+
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        std::vector<std::size_t> decode_offsets;
+        codec.decode_batch(expected, &msgs_out, &decode_offsets);
+        assert(msgs_out.size() == msgs.size());
+        assert(decode_offsets == expected_offsets);
+        for (std::size_t i = 0; i < msgs.size(); ++i)
+        {
+            std::cout << msgs_out[i]->ShortDebugString() << std::endl;
+            assert(msgs_out[i]->GetDescriptor() == msgs[i]->GetDescriptor());
+            assert(msgs_out[i]->SerializeAsString() == msgs[i]->SerializeAsString());
+        }
+    }
+
+    // single type known at compile time
+    {
+        std::string bytes;
+        codec.encode_batch(&bytes, reports);
+
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        codec.decode_batch(bytes, &msgs_out);
+        assert(msgs_out.size() == reports.size());
+        for (std::size_t i = 0; i < reports.size(); ++i)
+            assert(msgs_out[i]->SerializeAsString() == reports[i].SerializeAsString());
+    }
+
+    // one message at a time from the front of the buffer
+    {
+        std::string bytes(expected);
+        for (std::size_t i = 0; i < msgs.size(); ++i)
+        {
+            std::size_t bytes_used = 0;
+            boost::shared_ptr<google::protobuf::Message> msg_out =
+                codec.decode_front<boost::shared_ptr<google::protobuf::Message>>(bytes, &bytes_used);
+            assert(bytes_used == expected_offsets[i + 1] - expected_offsets[i]);
+            assert(msg_out->SerializeAsString() == msgs[i]->SerializeAsString());
+
+            boost::shared_ptr<google::protobuf::Message> msg_copy(msg_out->New());
+            assert(codec.decode_front(bytes, msg_copy.get()) == bytes_used);
+
+            std::string remaining(bytes);
+            codec.decode(&remaining, msg_copy.get());
+            bytes.erase(0, bytes_used);
+            assert(remaining == bytes);
+        }
+        assert(bytes.empty());
+    }
+
+    // empty batch
+    {
+        std::string bytes;
+        std::vector<std::size_t> offsets;
+        codec.encode_batch(&bytes, std::vector<Ping>(), &offsets);
+        assert(bytes.empty() && offsets == std::vector<std::size_t>(1, 0));
+    }
+
+    // truncated final message
+    {
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        try
+        {
+            codec.decode_batch(expected.substr(0, expected_offsets[3] + 1), &msgs_out);
+            assert(false);
+        }
+        catch (dccl::Exception& e)
+        {
+            assert(msgs_out.size() == 3);
+        }
+    }
+
+    // encrypted, in bulk (with enough messages to use several threads) and one message at a time
+    {
+        // Reports are left unencrypted
+        dccl::Codec crypto_codec;
+        crypto_codec.set_crypto_passphrase("my_passphrase!",
+                                           std::set<unsigned>{codec.id(Report::descriptor())});
+        crypto_codec.load<Ping>();
+        crypto_codec.load<Report>();
+
+        std::vector<const google::protobuf::Message*> many_msgs;
+        for (int i = 0; i < 60; ++i) many_msgs.insert(many_msgs.end(), msgs.begin(), msgs.end());
+
+        std::string expected_encrypted;
+        for (const google::protobuf::Message* msg : many_msgs)
+            crypto_codec.encode(&expected_encrypted, *msg);
+
+        std::string bytes;
+        std::vector<std::size_t> offsets;
+        crypto_codec.encode_batch(&bytes, many_msgs, &offsets, 4);
+        assert(bytes == expected_encrypted);
+
+        std::string plain;
+        std::vector<std::size_t> plain_offsets;
+        codec.encode_batch(&plain, many_msgs, &plain_offsets);
+        assert(plain_offsets == offsets);
+
+        std::string reencrypted(plain);
+        crypto_codec.encrypt_frames(&reencrypted, plain_offsets, 4);
+        assert(reencrypted == expected_encrypted);
+
+        crypto_codec.decrypt_frames(&reencrypted, plain_offsets);
+        assert(reencrypted == plain);
+
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        crypto_codec.decode_batch(bytes, &msgs_out);
+        assert(msgs_out.size() == many_msgs.size());
+        for (std::size_t i = 0; i < many_msgs.size(); ++i)
+            assert(msgs_out[i]->SerializeAsString() == many_msgs[i]->SerializeAsString());
+
+        // a new passphrase replaces the ciphers expanded from the old one
+        crypto_codec.set_crypto_passphrase("another passphrase!",
+                                           std::set<unsigned>{codec.id(Report::descriptor())});
+        dccl::Codec another_codec;
+        another_codec.set_crypto_passphrase("another passphrase!",
+                                            std::set<unsigned>{codec.id(Report::descriptor())});
+        another_codec.load<Ping>();
+        another_codec.load<Report>();
+
+        std::string another_bytes, expected_another_bytes;
+        crypto_codec.encode_batch(&another_bytes, many_msgs, nullptr, 4);
+        another_codec.encode_batch(&expected_another_bytes, many_msgs, nullptr, 4);
+        assert(another_bytes == expected_another_bytes);
+    }
+
+    // many Codecs with different passphrases, used in turn (each has its own ciphers)
+    {
+        const int num_codecs = 20;
+        std::vector<std::unique_ptr<dccl::Codec>> codecs;
+        std::vector<std::string> first_bytes(num_codecs);
+        for (int round = 0; round < 2; ++round)
+        {
+            for (int c = 0; c < num_codecs; ++c)
+            {
+                if (round == 0)
+                {
+                    codecs.emplace_back(new dccl::Codec);
+                    codecs[c]->set_crypto_passphrase("passphrase " + std::to_string(c));
+                    codecs[c]->load<Ping>();
+                }
+
+                std::string bytes;
+                codecs[c]->encode(&bytes, pings[1]);
+                if (round == 0)
+                    first_bytes[c] = bytes;
+                else
+                    assert(bytes == first_bytes[c]);
+
+                Ping ping_out;
+                codecs[c]->decode(bytes, &ping_out);
+                assert(ping_out.SerializeAsString() == pings[1].SerializeAsString());
+            }
+        }
+    }
+}
+
+void test_parallel_decode(dccl::Codec& codec)
+{
+    Fixture fixture(25);
+    const std::vector<const google::protobuf::Message*>& msgs = fixture.msgs;
+
+    std::string bytes;
+    std::vector<std::size_t> expected_offsets;
+    codec.encode_batch(&bytes, msgs, &expected_offsets);
+
+    // boundaries only
+    {
+        std::vector<std::size_t> offsets;
+        codec.scan_frames(bytes, &offsets);
+        assert(offsets == expected_offsets);
+    }
+
+    for (unsigned num_threads = 1; num_threads <= 4; ++num_threads)
+    {
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        std::vector<std::size_t> offsets;
+        codec.decode_parallel(bytes, &msgs_out, num_threads, &offsets);
+        assert(offsets == expected_offsets);
+        assert(msgs_out.size() == msgs.size());
+        for (std::size_t i = 0; i < msgs.size(); ++i)
+        {
+            assert(msgs_out[i]->GetDescriptor() == msgs[i]->GetDescriptor());
+            assert(msgs_out[i]->SerializeAsString() == msgs[i]->SerializeAsString());
+        }
+    }
+
+    // empty buffer
+    {
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        std::vector<std::size_t> offsets;
+        codec.decode_parallel(std::string(), &msgs_out, 2, &offsets);
+        assert(msgs_out.empty() && offsets == std::vector<std::size_t>(1, 0));
+    }
+
+    // truncated final (fixed size) message
+    {
+        std::vector<boost::shared_ptr<google::protobuf::Message>> msgs_out;
+        try
+        {
+            codec.decode_parallel(bytes.substr(0, bytes.size() - 1), &msgs_out, 2);
+            assert(false);
+        }
+        catch (dccl::Exception& e)
+        {
+            assert(msgs_out.empty());
+        }
+    }
+
+    // unloaded type (after a loaded one)
+    {
+        dccl::Codec report_codec;
+        report_codec.load<Report>();
+        std::vector<std::size_t> offsets;
+        try
+        {
+            report_codec.scan_frames(bytes, &offsets);
+            assert(false);
+        }
+        catch (dccl::Exception& e)
+        {
+        }
+    }
+}
+
+void check(dccl::Codec& codec, const google::protobuf::Message& msg)
+{
+    std::string expected;
+    codec.encode(&expected, msg);
+    std::cout << msg.ShortDebugString() << ": " << expected.size() << " bytes" << std::endl;
+
+    char buf[128];
+
+    // exactly enough space (and more)
+    for (std::size_t max_len = expected.size(); max_len <= expected.size() + 1; ++max_len)
+    {
+        dccl::EncodedSize size;
+        assert(codec.try_encode(buf, max_len, msg, &size));
+        assert(std::string(buf, size.bytes()) == expected);
+        assert(size.head_bytes == (size.head_bits + 7) / 8);
+        assert(size.body_bytes == (size.body_bits + 7) / 8);
+    }
+
+    // too little space
+    for (std::size_t max_len = 0; max_len < expected.size(); ++max_len)
+        assert(!codec.try_encode(buf, max_len, msg));
+}
+
+void test_try_encode(dccl::Codec& codec)
+{
+    Ping ping;
+    ping.set_source(3);
+    ping.set_sequence(500);
+    check(codec, ping);
+
+    // head only
+    Report report;
+    report.set_source(7);
+    check(codec, report);
+
+    report.add_temperature(20.5);
+    check(codec, report);
+
+    for (int i = 0; i < 9; ++i) report.add_temperature(i * 2.25 - 3);
+    report.set_comment("hello world");
+    check(codec, report);
+
+    // exact sizes
+    {
+        dccl::EncodedSize size;
+        char buf[128];
+        assert(codec.try_encode(buf, sizeof(buf), ping, &size));
+        // 8 bit id + 5 bit source in the head, 10 bit sequence in the body
+        assert(size.head_bits == 13 && size.head_bytes == 2);
+        assert(size.body_bits == 10 && size.body_bytes == 2);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    dccl::Codec codec;
+    codec.load<Ping>();
+    codec.load<Report>();
+
+    test_batch(codec);
+    test_parallel_decode(codec);
+    test_try_encode(codec);
+
+    std::cout << "all tests passed" << std::endl;
+}
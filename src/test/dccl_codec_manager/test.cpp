@@ -0,0 +1,113 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests field codecs added to a single Codec (Codec::manager())
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_fixed.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// encodes the value in `width` bits
+template <unsigned width> class WidthCodec : public dccl::TypedFixedFieldCodec<dccl::uint32>
+{
+  private:
+    unsigned size() { return width; }
+    dccl::Bitset encode() { return dccl::Bitset(size()); }
+    dccl::Bitset encode(const dccl::uint32& wire_value)
+    {
+        return dccl::Bitset(size(), static_cast<unsigned long>(wire_value));
+    }
+    dccl::uint32 decode(dccl::Bitset* bits) { return bits->to_ulong(); }
+    void validate() {}
+};
+
+void check(dccl::Codec& codec, unsigned expected_size)
+{
+    CustomMsg msg_in;
+    msg_in.set_x(5);
+    msg_in.mutable_inner()->set_y(7);
+
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    std::cout << msg_in.ShortDebugString() << " -> " << dccl::hex_encode(bytes) << std::endl;
+    assert(bytes.size() == expected_size);
+    assert(codec.size(msg_in) == expected_size);
+    // the identifier may use up to two bytes
+    assert(codec.max_size(CustomMsg::descriptor()) == expected_size + 1);
+
+    CustomMsg msg_out;
+    codec.decode(bytes, &msg_out);
+    assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    dccl::Codec codec8, codec16, codec_none;
+    codec8.manager().add<WidthCodec<8>>("test.width");
+    codec16.manager().add<WidthCodec<16>>("test.width");
+
+    codec8.load<CustomMsg>();
+    codec16.load<CustomMsg>();
+
+    // id (1 byte) + x + inner.y
+    check(codec8, 1 + 1 + 1);
+    check(codec16, 1 + 2 + 2);
+    // using one Codec does not affect the other
+    check(codec8, 1 + 1 + 1);
+
+    // the process-wide set of codecs does not contain either
+    try
+    {
+        dccl::FieldCodecManager::find(google::protobuf::FieldDescriptor::TYPE_UINT32, "test.width");
+        assert(false);
+    }
+    catch (dccl::Exception& e)
+    {
+        std::cout << "Expected exception: " << e.what() << std::endl;
+    }
+
+    try
+    {
+        codec_none.load<CustomMsg>();
+        assert(false);
+    }
+    catch (dccl::Exception& e)
+    {
+        std::cout << "Expected exception: " << e.what() << std::endl;
+    }
+
+    // codecs in the process-wide set are used by every Codec unless overridden
+    dccl::FieldCodecManager::add<WidthCodec<4>>("test.width");
+    codec_none.load<CustomMsg>();
+    check(codec_none, 1 + 1);
+    check(codec8, 1 + 1 + 1);
+
+    // removing a Codec's own codec exposes the process-wide one
+    codec16.manager().remove<WidthCodec<16>>("test.width");
+    check(codec16, 1 + 1);
+    dccl::FieldCodecManager::remove<WidthCodec<4>>("test.width");
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,133 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that encrypted messages are byte-for-byte what earlier releases of DCCL produced
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// each is AES-256 in CTR mode over the body, keyed by the SHA-256 of the passphrase, with an IV of
+// the first 16 bytes of the SHA-256 of the head (the head itself is left in the clear)
+struct Vector
+{
+    const google::protobuf::Message* msg;
+    const char* hex;
+};
+
+void check(dccl::Codec& codec, const Vector& vector)
+{
+    std::string bytes;
+    codec.encode(&bytes, *vector.msg);
+    std::cout << vector.msg->ShortDebugString() << ": " << dccl::hex_encode(bytes) << std::endl;
+    assert(dccl::hex_encode(bytes) == vector.hex);
+
+    boost::shared_ptr<google::protobuf::Message> msg_out =
+        codec.decode<boost::shared_ptr<google::protobuf::Message> >(bytes);
+    assert(msg_out->SerializeAsString() == vector.msg->SerializeAsString());
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    CryptoFixed fixed1;
+    fixed1.set_source(5);
+    fixed1.set_depth(123.4);
+    fixed1.set_heading(270);
+    fixed1.set_surfaced(true);
+
+    // same body as fixed1, but a different head (so IV)
+    CryptoFixed fixed2;
+    fixed2.set_source(6);
+    fixed2.set_depth(123.4);
+    fixed2.set_heading(270);
+
+    CryptoVariable variable1;
+    variable1.set_source(7);
+    variable1.set_comment("the quick brown fox");
+    variable1.add_value(-100);
+    variable1.add_value(0);
+    variable1.add_value(42);
+    variable1.add_value(100);
+
+    CryptoVariable variable2;
+    variable2.set_source(7);
+
+    CryptoSkipped skipped;
+    skipped.set_source(1);
+    skipped.set_value(999);
+
+    const Vector vectors[] = {{&fixed1, "02056cbef1c8"},
+                              {&fixed2, "020686430f0c"},
+                              {&variable1, "040788db4cc08dc541453894525e04d9cd6af2364bb8c729b1dc5c"},
+                              {&variable2, "04079bc6"},
+                              // not encrypted
+                              {&skipped, "0601e703"}};
+    const Vector another_vector = {&fixed1, "0205c6ea4528"};
+
+    std::set<unsigned> skip_crypto_ids;
+    skip_crypto_ids.insert(CryptoSkipped::descriptor()->options().GetExtension(dccl::msg).id());
+
+    dccl::Codec codec;
+    codec.set_crypto_passphrase("my_passphrase!", skip_crypto_ids);
+    codec.load<CryptoFixed>();
+    codec.load<CryptoVariable>();
+    codec.load<CryptoSkipped>();
+
+    for (const Vector& vector : vectors) check(codec, vector);
+
+    // after changing the passphrase and back again
+    codec.set_crypto_passphrase("another passphrase!");
+    check(codec, another_vector);
+    codec.set_crypto_passphrase("my_passphrase!", skip_crypto_ids);
+    for (const Vector& vector : vectors) check(codec, vector);
+
+    // in bulk, encoded encrypted or encrypted afterwards
+    std::vector<const google::protobuf::Message*> msgs;
+    std::string expected;
+    for (int i = 0; i < 20; ++i)
+    {
+        for (const Vector& vector : vectors)
+        {
+            msgs.push_back(vector.msg);
+            expected += dccl::hex_decode(vector.hex);
+        }
+    }
+
+    std::string bytes;
+    codec.encode_batch(&bytes, msgs, nullptr, 4);
+    assert(bytes == expected);
+
+    dccl::Codec plain_codec;
+    plain_codec.load<CryptoFixed>();
+    plain_codec.load<CryptoVariable>();
+    plain_codec.load<CryptoSkipped>();
+    std::vector<std::size_t> offsets;
+    bytes.clear();
+    plain_codec.encode_batch(&bytes, msgs, &offsets, 4);
+    assert(bytes != expected);
+    codec.encrypt_frames(&bytes, offsets, 4);
+    assert(bytes == expected);
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -22,6 +22,7 @@
 // tests all protobuf types with _default codecs, repeat and non repeat
 
 #include <fstream>
+#include <thread>
 
 #include <google/protobuf/descriptor.pb.h>
 
@@ -46,6 +47,8 @@ void test2();
 #if CODEC_VERSION == 4
 void test3();
 #endif
+void test_threads();
+void test_views();
 
 int main(int argc, char* argv[])
 {
@@ -57,6 +60,8 @@ int main(int argc, char* argv[])
     // oneof
     test3();
 #endif
+    test_threads();
+    test_views();
     std::cout << "all tests passed" << std::endl;
 }
 
@@ -288,3 +293,74 @@ void decode_check(const std::string& encoded)
 
     msg_in.Clear();
 }
+
+// encodes and decodes in several threads (twice, so that the second set of threads reuses the
+// Lua states of the first)
+void test_threads()
+{
+    msg_in.set_state(TestMsg::STATE_1);
+    msg_in.set_a(40);
+    msg_in.set_c_center(50);
+    msg_in.set_c(60);
+    for (int d : {50, 100, 150, 200, 250}) msg_in.add_d(d);
+    msg_in.mutable_child2()->set_include_i(TestMsg::Child2::NO);
+    {
+        // i2 uses a condition that must be run by Lua
+        auto c = msg_in.add_child();
+        c->set_include_i(TestMsg::Child::YES);
+        c->set_i(5);
+        c->set_i2(6);
+    }
+
+    std::string expected_bytes;
+    codec.encode(&expected_bytes, msg_in);
+    TestMsg expected_msg;
+    codec.decode(expected_bytes, &expected_msg);
+
+    for (int round = 0; round < 2; ++round)
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back(
+                [&]()
+                {
+                    for (int i = 0; i < 20; ++i)
+                    {
+                        std::string bytes;
+                        codec.encode(&bytes, msg_in);
+                        assert(bytes == expected_bytes);
+
+                        TestMsg msg_out;
+                        codec.decode(bytes, &msg_out);
+                        assert(msg_out.SerializeAsString() == expected_msg.SerializeAsString());
+                    }
+                });
+        }
+        for (std::thread& thread : threads) thread.join();
+    }
+    std::cout << "Encoded and decoded in threads: " << expected_msg.ShortDebugString()
+              << std::endl;
+
+    msg_in.Clear();
+}
+
+// scripts that iterate over the message with pairs(), and that use a view kept from an earlier
+// script
+void test_views()
+{
+    ViewMsg views_in;
+    for (int v : {10, 20, 30}) views_in.add_v(v);
+    views_in.set_sum(60);
+    views_in.set_names(1);
+    views_in.set_stale(2);
+
+    codec.load<ViewMsg>();
+    std::string bytes;
+    codec.encode(&bytes, views_in);
+
+    ViewMsg views_out;
+    codec.decode(bytes, &views_out);
+    std::cout << "Views out: " << views_out.ShortDebugString() << std::endl;
+    assert(views_in.SerializeAsString() == views_out.SerializeAsString());
+}
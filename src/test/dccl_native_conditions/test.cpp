@@ -0,0 +1,227 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests dynamic conditions evaluated without Lua
+
+#include "dccl/codec.h"
+#include "dccl/internal/condition_expression.h"
+
+#if CODEC_VERSION == 3
+#include "test3.pb.h"
+#elif CODEC_VERSION == 4
+#include "test4.pb.h"
+#endif
+
+using namespace dccl::test;
+using dccl::internal::ConditionExpression;
+
+ConditionExpression::Value evaluate(const std::string& script, const NativeConditions& msg,
+                                    int repeated_index = -1)
+{
+    ConditionExpression expression(script);
+    assert(expression.valid());
+    ConditionExpression::Value value;
+    bool ok = expression.evaluate(&msg, &msg, repeated_index, &value);
+    assert(ok);
+    return value;
+}
+
+double number(const std::string& script, const NativeConditions& msg, int repeated_index = -1)
+{
+    ConditionExpression::Value value = evaluate(script, msg, repeated_index);
+    assert(value.type == ConditionExpression::Value::NUMBER);
+    return value.number;
+}
+
+bool truth(const std::string& script, const NativeConditions& msg)
+{
+    return evaluate(script, msg).truthy();
+}
+
+void test_expressions()
+{
+    NativeConditions msg;
+    msg.set_state(NativeConditions::STATE_1);
+    msg.set_mode(2);
+    msg.add_d(10);
+    msg.add_d(20);
+    msg.add_child()->set_flag(true);
+    msg.add_child()->set_flag(false);
+
+    // arithmetic, with the Lua precedence and semantics
+    assert(number("1 + 2 * 3", msg) == 7);
+    assert(number("(1 + 2) * 3", msg) == 9);
+    assert(number("2^3^2", msg) == 512);
+    assert(number("-2^2", msg) == -4);
+    assert(number("7 / 2", msg) == 3.5);
+    assert(number("7 // 2", msg) == 3);
+    assert(number("-7 // 2", msg) == -4);
+    assert(number("7 % -3", msg) == -2);
+    assert(number("-7 % 3", msg) == 2);
+    assert(number("return 1.5e1;", msg) == 15);
+
+    // `and` and `or` give one of their operands
+    assert(number("nil or 5", msg) == 5);
+    assert(number("false or 0 and 6", msg) == 6);
+    assert(evaluate("false and this.nothing.at.all", msg).type ==
+           ConditionExpression::Value::BOOLEAN);
+    // 0 is true in Lua
+    assert(truth("0", msg));
+    assert(!truth("not 0", msg));
+
+    // comparisons
+    assert(truth("'abc' < 'abd'", msg));
+    assert(truth("this.mode >= 2 and this.mode <= 2 and this.mode ~= 3", msg));
+    assert(!truth("this.mode == '2'", msg));
+
+    // fields: enumerations by name, repeated fields indexed from 1, and nil for unset messages
+    ConditionExpression::Value state = evaluate("this.state", msg);
+    assert(state.type == ConditionExpression::Value::STRING && state.str == "STATE_1");
+    assert(truth("root.state == 'STATE_1'", msg));
+    assert(number("#this.d", msg) == 2);
+    assert(number("this.d[2]", msg) == 20);
+    assert(number("this['d'][1]", msg) == 10);
+    assert(evaluate("this.d[3]", msg).type == ConditionExpression::Value::NIL);
+    assert(evaluate("this.no_such_field", msg).type == ConditionExpression::Value::NIL);
+    assert(truth("this.extra == nil", msg));
+    assert(truth("root.child[1].flag", msg));
+    assert(!evaluate("root.child[this_index].flag", msg, 1).truthy());
+    assert(number("this_index * 10", msg, 4) == 50);
+
+    // not supported natively (must be run by Lua)
+    assert(!ConditionExpression("print(this_index); return this_index").valid());
+    assert(!ConditionExpression("this.mode -- comment").valid());
+    assert(!ConditionExpression("0x10").valid());
+    assert(!ConditionExpression("'a' .. 'b'").valid());
+    assert(!ConditionExpression("x = 1").valid());
+    assert(!ConditionExpression("math.abs(this.mode)").valid());
+    {
+        ConditionExpression expression("this.mode < 'abc'");
+        assert(expression.valid());
+        ConditionExpression::Value value;
+        assert(!expression.evaluate(&msg, &msg, -1, &value));
+    }
+}
+
+void check(dccl::Codec& codec, const NativeConditions& msg_in, const NativeConditions& expected)
+{
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+
+    NativeConditions msg_out;
+    codec.decode(bytes, &msg_out);
+    std::cout << msg_in.ShortDebugString() << " -> " << msg_out.ShortDebugString() << std::endl;
+    assert(msg_out.SerializeAsString() == expected.SerializeAsString());
+}
+
+void test_codec()
+{
+    dccl::Codec codec;
+    codec.load<NativeConditions>();
+
+    NativeConditions msg;
+    msg.set_state(NativeConditions::STATE_1);
+    msg.set_mode(1);
+    msg.set_a(10);
+    msg.set_b(20);
+    msg.set_c(150);
+    msg.set_e(250);
+    for (int i = 0; i < 5; ++i) msg.add_d(100 + 50 * i);
+    msg.add_child()->set_flag(true);
+    msg.mutable_child(0)->set_i(5);
+    msg.add_child()->set_flag(false);
+    msg.mutable_child(1)->set_i(6);
+
+    // b is omitted; only d[0], d[2] and d[4] (this_index 1, 3, 5) are included; child[1].i is omitted
+    NativeConditions expected = msg;
+    expected.clear_b();
+    expected.clear_d();
+    expected.add_d(100);
+    expected.add_d(200);
+    expected.add_d(300);
+    expected.mutable_child(1)->clear_i();
+    check(codec, msg, expected);
+
+    // a is omitted, b is required; c is now within [200, 300] and e takes another bit
+    msg.set_state(NativeConditions::STATE_2);
+    msg.set_mode(2);
+    msg.set_c(250);
+    msg.set_e(550);
+    expected = msg;
+    expected.clear_a();
+    expected.clear_d();
+    expected.add_d(100);
+    expected.add_d(200);
+    expected.add_d(300);
+    expected.mutable_child(1)->clear_i();
+    check(codec, msg, expected);
+
+    // e can now only be 0, so takes only its presence bit: the fields after it must not move
+    msg.set_mode(0);
+    msg.set_c(50);
+    msg.set_e(0);
+    expected = msg;
+    expected.clear_a();
+    expected.clear_d();
+    expected.add_d(100);
+    expected.add_d(200);
+    expected.add_d(300);
+    expected.mutable_child(1)->clear_i();
+    check(codec, msg, expected);
+}
+
+void test_memoize()
+{
+    NativeConditions msg;
+    msg.set_state(NativeConditions::STATE_1);
+    msg.set_mode(2);
+
+    dccl::DynamicConditions dc;
+    dc.set_field(NativeConditions::descriptor()->FindFieldByName("b"));
+    dc.regenerate(&msg, &msg);
+    assert(dc.required());
+
+    {
+        dccl::DynamicConditions::MemoizeScope memoize;
+        assert(dc.required());
+        // within the scope, the result for this message is remembered
+        msg.set_mode(1);
+        assert(dc.required());
+
+        // but not for another message
+        NativeConditions other = msg;
+        dc.regenerate(&other, &other);
+        assert(!dc.required());
+        dc.regenerate(&msg, &msg);
+    }
+    assert(!dc.required());
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    test_expressions();
+    test_codec();
+    test_memoize();
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,179 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that repeated numeric fields quantized in bulk are encoded and decoded exactly as they are one value at a time
+
+#include <cmath>
+#include <random>
+
+#include "dccl/codec.h"
+#include "dccl/codecs3/field_codec_default.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// opts out of the bulk path, so it encodes and decodes one value at a time using encode() and decode()
+template <typename WireType>
+class ScalarNumericCodec : public dccl::v3::DefaultNumericFieldCodec<WireType>
+{
+    bool bulk_quantize() { return false; }
+};
+
+std::mt19937 rng(1);
+
+double uniform(double min, double max)
+{
+    return std::uniform_real_distribution<double>(min, max)(rng);
+}
+
+// returns false if the (strict mode) encode threw OutOfRangeException
+bool encode_and_decode(dccl::Codec& codec, const google::protobuf::Message& msg_in,
+                       std::string* bytes, google::protobuf::Message* msg_out)
+{
+    try
+    {
+        codec.encode(bytes, msg_in);
+    }
+    catch (dccl::OutOfRangeException&)
+    {
+        return false;
+    }
+    assert(bytes->size() == codec.size(msg_in));
+    codec.decode(*bytes, msg_out);
+    return true;
+}
+
+void check(dccl::Codec& codec, const BulkMsg& bulk_in)
+{
+    ScalarMsg scalar_in;
+    scalar_in.ParseFromString(bulk_in.SerializeAsString());
+
+    std::string bulk_bytes, scalar_bytes;
+    BulkMsg bulk_out;
+    ScalarMsg scalar_out;
+    const bool bulk_encoded = encode_and_decode(codec, bulk_in, &bulk_bytes, &bulk_out);
+    const bool scalar_encoded = encode_and_decode(codec, scalar_in, &scalar_bytes, &scalar_out);
+    assert(bulk_encoded == scalar_encoded);
+    if (!bulk_encoded)
+        return;
+
+    // everything but the (one byte) id is the same
+    assert(bulk_bytes.substr(1) == scalar_bytes.substr(1));
+    assert(bulk_out.SerializeAsString() == scalar_out.SerializeAsString());
+}
+
+// fills msg with random values, about 1 in 16 of which are out of range
+void fill(BulkMsg* msg)
+{
+    msg->Clear();
+    for (int j = rng() % 129; j > 0; --j) msg->add_d(uniform(-101.2, 101));
+    for (int j = rng() % 65; j > 0; --j) msg->add_coarse(uniform(-7500, 107000));
+    for (int j = rng() % 65; j > 0; --j) msg->add_f(uniform(-11.25, 11.25));
+    for (int j = rng() % 17; j > 0; --j) msg->add_i(uniform(-113000, 113000));
+    for (int j = rng() % 17; j > 0; --j) msg->add_u(uniform(0, 4250));
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::WARN_PLUS, &std::cerr);
+
+    dccl::FieldCodecManager::add<ScalarNumericCodec<double> >("test.scalar");
+    dccl::FieldCodecManager::add<ScalarNumericCodec<float> >("test.scalar");
+    dccl::FieldCodecManager::add<ScalarNumericCodec<dccl::int32> >("test.scalar");
+    dccl::FieldCodecManager::add<ScalarNumericCodec<dccl::uint64> >("test.scalar");
+
+    dccl::Codec codec;
+    codec.load<BulkMsg>();
+    codec.load<ScalarMsg>();
+    codec.load<BulkV2Msg>();
+
+    BulkMsg msg;
+    check(codec, msg);
+
+    // values on and just outside the bounds, and values that round onto the bounds
+    msg.add_d(-100.5);
+    msg.add_d(100.25);
+    msg.add_d(-100.5004);
+    msg.add_d(100.2504);
+    msg.add_d(-100.5006);
+    msg.add_d(100.2506);
+    msg.add_d(0);
+    msg.add_d(NAN);
+    msg.add_coarse(-1000);
+    msg.add_coarse(-1005);
+    msg.add_coarse(100004);
+    msg.add_coarse(100005);
+    msg.add_f(9.995);
+    msg.add_f(-10.01);
+    msg.add_i(-100049);
+    msg.add_i(-100050);
+    msg.add_i(99999);
+    msg.add_u(2);
+    msg.add_u(3);
+    msg.add_u(4000);
+    msg.add_u(4001);
+    for (int strict = 0; strict < 2; ++strict)
+    {
+        codec.set_strict(strict);
+        check(codec, msg);
+        for (int j = 0; j < 500; ++j)
+        {
+            fill(&msg);
+            check(codec, msg);
+        }
+    }
+    codec.set_strict(false);
+
+    // repeated values are required in DCCL v4, so out of range values are encoded as zero (the minimum)
+    msg.Clear();
+    msg.add_d(1.0001);
+    msg.add_d(150);
+    msg.add_d(-2.0004);
+    std::string bytes;
+    codec.encode(&bytes, msg);
+    BulkMsg msg_out;
+    codec.decode(bytes, &msg_out);
+    assert(msg_out.d_size() == 3);
+    assert(msg_out.d(0) == 1.0);
+    assert(msg_out.d(1) == -100.5);
+    assert(msg_out.d(2) == -2.0);
+
+    // DCCL v2 encodes max_repeat optional values: the out of range ones and those past the end of
+    // the field are empty
+    BulkV2Msg v2_msg;
+    v2_msg.add_d(1.2345);
+    v2_msg.add_d(150);
+    v2_msg.add_d(-100.5);
+    std::string v2_bytes;
+    codec.encode(&v2_bytes, v2_msg);
+    BulkV2Msg v2_msg_out;
+    codec.decode(v2_bytes, &v2_msg_out);
+    assert(v2_msg_out.d_size() == 2);
+    assert(v2_msg_out.d(0) == 1.235);
+    assert(v2_msg_out.d(1) == -100.5);
+
+    dccl::FieldCodecManager::remove<ScalarNumericCodec<double> >("test.scalar");
+    dccl::FieldCodecManager::remove<ScalarNumericCodec<float> >("test.scalar");
+    dccl::FieldCodecManager::remove<ScalarNumericCodec<dccl::int32> >("test.scalar");
+    dccl::FieldCodecManager::remove<ScalarNumericCodec<dccl::uint64> >("test.scalar");
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,177 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests encoding and decoding of repeated primitive fields directly from / into the containing message
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_fixed.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// encodes values >= 0 as value + 1 and negative values (via pre_encode) as empty (0)
+class NonNegativeCodec : public dccl::TypedFixedFieldCodec<dccl::uint32, dccl::int32>
+{
+  private:
+    unsigned size() { return 8; }
+    dccl::Bitset encode() { return dccl::Bitset(size()); }
+    dccl::Bitset encode(const dccl::uint32& wire_value)
+    {
+        return dccl::Bitset(size(), static_cast<unsigned long>(wire_value + 1));
+    }
+    dccl::uint32 decode(dccl::Bitset* bits)
+    {
+        if (bits->to_ulong() == 0)
+            throw dccl::NullValueException();
+        return bits->to_ulong() - 1;
+    }
+
+    dccl::uint32 pre_encode(const dccl::int32& field_value)
+    {
+        if (field_value < 0)
+            throw dccl::NullValueException();
+        return field_value;
+    }
+    dccl::int32 post_decode(const dccl::uint32& wire_value) { return wire_value; }
+
+    void validate() {}
+};
+
+template <typename Msg> void fill(Msg* msg)
+{
+    msg->add_d(1.25);
+    msg->add_d(-9.99);
+    msg->add_d(0);
+    msg->add_i(-100);
+    msg->add_i(42);
+    msg->add_color(BLUE);
+    msg->add_color(RED);
+    msg->add_color(GREEN);
+    msg->add_b(true);
+    msg->add_b(false);
+    msg->add_positive(1);
+    msg->add_positive(3);
+}
+
+template <typename Msg> Msg round_trip(dccl::Codec& codec, const Msg& msg_in)
+{
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    assert(bytes.size() == codec.size(msg_in));
+
+    Msg msg_out;
+    codec.decode(bytes, &msg_out);
+    std::cout << msg_in.ShortDebugString() << " -> " << msg_out.ShortDebugString() << std::endl;
+    return msg_out;
+}
+
+template <typename Msg> void check(dccl::Codec& codec, const Msg& msg_in)
+{
+    Msg msg_out = round_trip(codec, msg_in);
+    assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+}
+
+template <typename Msg> void check_common(dccl::Codec& codec)
+{
+    codec.load<Msg>();
+
+    // empty
+    check(codec, Msg());
+
+    Msg msg;
+    fill(&msg);
+    check(codec, msg);
+
+    // values that pre_encode() rejects are encoded as empty and not decoded
+    msg.clear_positive();
+    msg.add_positive(1);
+    msg.add_positive(-2);
+    msg.add_positive(3);
+    Msg msg_out = round_trip(codec, msg);
+    assert(msg_out.positive_size() == 2);
+    assert(msg_out.positive(0) == 1);
+    assert(msg_out.positive(1) == 3);
+
+    // too many values
+    Msg too_many;
+    for (int j = 0; j < 5; ++j) too_many.add_i(j);
+
+    codec.set_strict(true);
+    try
+    {
+        std::string bytes;
+        codec.encode(&bytes, too_many);
+        assert(false);
+    }
+    catch (dccl::OutOfRangeException& e)
+    {
+        std::cout << "Expected exception: " << e.what() << std::endl;
+    }
+    codec.set_strict(false);
+
+    msg_out = round_trip(codec, too_many);
+    assert(msg_out.i_size() == 4);
+    for (int j = 0; j < 4; ++j) assert(msg_out.i(j) == j);
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    dccl::FieldCodecManager::add<NonNegativeCodec>("test.non_negative");
+
+    dccl::Codec codec;
+
+    // DCCL v2 always encodes max_repeat values
+    check_common<RepeatedV2>(codec);
+    {
+        RepeatedV2 empty, one;
+        one.add_d(5);
+        std::string empty_bytes, one_bytes;
+        codec.encode(&empty_bytes, empty);
+        codec.encode(&one_bytes, one);
+        assert(empty_bytes.size() == one_bytes.size());
+    }
+
+    check_common<RepeatedV3>(codec);
+    {
+        RepeatedV3 msg;
+        fill(&msg);
+        msg.add_s("abc");
+        msg.add_s("d");
+        msg.add_s("abcdefgh");
+        check(codec, msg);
+    }
+
+    check_common<RepeatedV4>(codec);
+    {
+        RepeatedV4 msg;
+        fill(&msg);
+        msg.add_s("xyz");
+        msg.add_u(1000);
+        msg.add_u(0);
+        check(codec, msg);
+    }
+
+    dccl::FieldCodecManager::remove<NonNegativeCodec>("test.non_negative");
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -19,6 +19,10 @@
 //
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <sstream>
+#include <thread>
+#include <vector>
+
 #include "dccl/logger.h"
 
 /// asserts false if called - used for testing proper short-circuiting of logger calls
@@ -37,6 +41,61 @@ void info(const std::string& log_message,
    printf("%s\n", log_message.c_str());
 }
 
+std::vector<std::string> collected;
+void collect(const std::string& log_message,
+             dccl::logger::Verbosity verbosity,
+             dccl::logger::Group group)
+{
+    // called with the Logger held, so no other lock is needed
+    collected.push_back(log_message);
+}
+
+void test_threads()
+{
+    using dccl::dlog;
+    using namespace dccl::logger;
+
+    const int num_threads = 4, num_messages = 500;
+    dlog.connect(DEBUG1_PLUS, &collect);
+
+    // only queries, so does not keep the other threads waiting
+    assert(dlog.enabled(DEBUG1) && !dlog.enabled(DEBUG2));
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [=]()
+            {
+                for(int i = 0; i < num_messages; ++i)
+                {
+                    dlog.is(DEBUG1) && dlog << "thread " << t << " message "
+                                            << std::setfill('0') << std::setw(4) << i
+                                            << std::endl;
+                    // disabled, so never takes the Logger
+                    dlog.is(DEBUG3) && dlog << stream_assert << std::endl;
+                }
+            });
+    }
+    for(std::thread& thread : threads) thread.join();
+    dlog.disconnect(ALL);
+
+    // every message arrived whole, and in order for each thread
+    assert(collected.size() == num_threads * num_messages);
+    std::vector<int> next(num_threads, 0);
+    for(const std::string& log_message : collected)
+    {
+        std::istringstream is(log_message);
+        std::string thread_word, message_word;
+        int t, i;
+        is >> thread_word >> t >> message_word >> i;
+        assert(thread_word == "thread" && message_word == "message");
+        assert(t >= 0 && t < num_threads && i == next[t]);
+        ++next[t];
+    }
+    std::cout << "logged " << collected.size() << " messages from " << num_threads << " threads" << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
     using dccl::dlog;
@@ -94,6 +153,7 @@ int main(int argc, char* argv[])
     dlog.is(WARN) && dlog << "warn ok" << std::endl;
     dlog.disconnect(ALL);    
 
+    test_threads();
     
     std::cout << "All tests passed." << std::endl;
 
@@ -0,0 +1,109 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that cached message sizes are recalculated when the field codecs change
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_fixed.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+template <unsigned Bits> class FixedInt32Codec : public dccl::TypedFixedFieldCodec<dccl::int32>
+{
+  private:
+    unsigned size() { return Bits; }
+    dccl::Bitset encode() { return dccl::Bitset(size()); }
+    dccl::Bitset encode(const dccl::int32& wire_value)
+    {
+        return dccl::Bitset(size(), static_cast<unsigned long>(wire_value));
+    }
+    dccl::int32 decode(dccl::Bitset* bits) { return bits->to_ulong(); }
+    void validate() {}
+    bool schema_only_size() { return true; }
+};
+
+void check(dccl::Codec& codec, unsigned expected_bytes)
+{
+    codec.load<TestMsg>();
+    codec.info<TestMsg>(&dccl::dlog);
+    // the default identifier codec uses one or two bytes
+    assert(codec.min_size<TestMsg>() == expected_bytes);
+    assert(codec.max_size<TestMsg>() == expected_bytes + 1);
+
+    TestMsg msg_in, msg_out;
+    msg_in.mutable_embedded()->set_value(3);
+    msg_in.set_head_value(5);
+
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    assert(bytes.size() == expected_bytes);
+    codec.decode(bytes, &msg_out);
+    assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+}
+
+// sizes that depend on the message must not be reused for another message (or for the same
+// message before its earlier fields are decoded)
+void check_dynamic_bounds()
+{
+    dccl::Codec codec;
+    codec.load<DynamicBoundsMsg>();
+
+    for (int w : {200, 3, 0, 1, 255, 3})
+    {
+        DynamicBoundsMsg msg_in, msg_out;
+        msg_in.set_w(w);
+        msg_in.set_v(std::min(2, w));
+        msg_in.set_tail(77);
+
+        std::string bytes;
+        codec.encode(&bytes, msg_in);
+        codec.decode(bytes, &msg_out);
+        std::cout << dccl::hex_encode(bytes) << ": " << msg_out.ShortDebugString() << std::endl;
+        assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    dccl::FieldCodecManager::add<FixedInt32Codec<8> >("size_test_codec");
+
+    dccl::Codec codec;
+    // 1 byte id + 1 byte head + 1 byte body
+    check(codec, 3);
+
+    // same name, larger codec: cached sizes must not be reused
+    dccl::FieldCodecManager::remove<FixedInt32Codec<8> >("size_test_codec");
+    dccl::FieldCodecManager::add<FixedInt32Codec<16> >("size_test_codec");
+    // 1 byte id + 2 bytes head + 2 bytes body
+    check(codec, 5);
+
+    codec.unload<TestMsg>();
+    dccl::FieldCodecManager::remove<FixedInt32Codec<16> >("size_test_codec");
+    dccl::FieldCodecManager::add<FixedInt32Codec<8> >("size_test_codec");
+    check(codec, 3);
+
+    check_dynamic_bounds();
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,125 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests encoding and decoding from several threads at once
+
+#include <atomic>
+#include <thread>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+Status make_status(int i)
+{
+    Status status;
+    status.set_source(i % 32);
+    status.mutable_position()->set_x(i % 2000 - 1000);
+    status.mutable_position()->set_y(-(i % 1000));
+    if (i % 3)
+        status.set_depth(i % 5000);
+    for (int j = 0, n = i % 9; j < n; ++j) status.add_readings((i + j) % 200 - 100);
+    if (i % 2)
+        status.set_ack(i % 4 == 1);
+    else
+        status.set_note(std::string(i % 9, 'a' + i % 26));
+    return status;
+}
+
+Command make_command(int i)
+{
+    Command command;
+    command.set_destination(i % 32);
+    for (int j = 0, n = i % 4; j < n; ++j)
+    {
+        Position* waypoint = command.add_waypoints();
+        waypoint->set_x(j * 10 + i % 100);
+        waypoint->set_y(-j * 10);
+    }
+    if (i % 5 == 0)
+        command.set_abort(true);
+    return command;
+}
+
+template <typename ProtobufMessage>
+bool round_trip(dccl::Codec& codec, const ProtobufMessage& msg_in, const std::string& expected)
+{
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    if (bytes != expected)
+        return false;
+
+    ProtobufMessage msg_out;
+    codec.decode(bytes, &msg_out);
+    return msg_out.SerializeAsString() == msg_in.SerializeAsString();
+}
+
+int main(int argc, char* argv[])
+{
+    const int num_threads = 8;
+    const int num_messages = 500;
+
+    dccl::Codec shared_codec;
+    shared_codec.load<Status>();
+    shared_codec.load<Command>();
+
+    // expected encodings, calculated in this thread
+    std::vector<std::string> status_bytes(num_messages), command_bytes(num_messages);
+    for (int i = 0; i < num_messages; ++i)
+    {
+        shared_codec.encode(&status_bytes[i], make_status(i));
+        shared_codec.encode(&command_bytes[i], make_command(i));
+    }
+
+    std::vector<std::unique_ptr<dccl::Codec>> thread_codecs;
+    for (int t = 0; t < num_threads; ++t) thread_codecs.emplace_back(new dccl::Codec);
+
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                // even threads share a Codec, odd threads load messages into their own
+                dccl::Codec& codec = (t % 2) ? *thread_codecs[t] : shared_codec;
+                if (t % 2)
+                {
+                    codec.load<Status>();
+                    codec.load<Command>();
+                }
+
+                for (int i = t; i < num_messages + t; ++i)
+                {
+                    int n = i % num_messages;
+                    if (!round_trip(codec, make_status(n), status_bytes[n]) ||
+                        !round_trip(codec, make_command(n), command_bytes[n]))
+                        ++failures;
+                }
+            });
+    }
+
+    for (std::thread& thread : threads) thread.join();
+
+    assert(failures == 0);
+    std::cout << "all tests passed" << std::endl;
+}